@@ -90,7 +90,9 @@ void CDrawScrollView::OnDraw(CDC* pDC)
             rc_text.top = theApp.DPI(8) + index * (double_line ? theApp.DPI(64) : theApp.DPI(56));
             rc_text.bottom = rc_text.top + theApp.DPI(24);
             rc_text.right = draw_rect.right;
-            drawer.DrawWindowText(rc_text, item->GetItemName(), RGB(0, 0, 0));
+            CString item_name = item->GetItemName();
+            item_name += GetPaintTimeText(item->GetItemId());
+            drawer.DrawWindowText(rc_text, item_name, RGB(0, 0, 0));
 
             //绘制显示项目
             CRect rc_item = rc_text;
@@ -118,7 +120,11 @@ void CDrawScrollView::OnDraw(CDC* pDC)
             if (item->IsCustomDraw())
             {
                 drawer.GetDC()->SetTextColor(text_color);
+                LARGE_INTEGER start, end;
+                QueryPerformanceCounter(&start);
                 item->DrawItem(drawer.GetDC()->GetSafeHdc(), rc_item.left, rc_item.top, rc_item.Width(), rc_item.Height(), dark_mode);
+                QueryPerformanceCounter(&end);
+                RecordPaintTime(item->GetItemId(), end.QuadPart - start.QuadPart);
             }
             else
             {
@@ -327,11 +333,94 @@ BOOL CDrawScrollView::PreTranslateMessage(MSG* pMsg)
 void CDrawScrollView::OnKeyUp(UINT nChar, UINT nRepCnt, UINT nFlags)
 {
     // TODO: 在此添加消息处理程序代码和/或调用默认值
+    if (nChar == VK_F9)
+    {
+        RunPaintBenchmark();
+        return;
+    }
 
     CScrollView::OnKeyUp(nChar, nRepCnt, nFlags);
 }
 
 
+void CDrawScrollView::RecordPaintTime(const std::wstring& item_id, LONGLONG ticks)
+{
+    LARGE_INTEGER freq;
+    QueryPerformanceFrequency(&freq);
+    PaintStat& stat = m_paint_stat[item_id];
+    stat.last_us = ticks * 1000000.0 / freq.QuadPart;
+    stat.total_us += stat.last_us;
+    stat.count++;
+}
+
+
+CString CDrawScrollView::GetPaintTimeText(const std::wstring& item_id) const
+{
+    CString str;
+    auto iter = m_paint_stat.find(item_id);
+    if (iter != m_paint_stat.end() && iter->second.count > 0)
+        str.Format(_T("    绘制: %.1f μs (平均 %.1f μs, %u 次)"), iter->second.last_us, iter->second.total_us / iter->second.count, iter->second.count);
+    return str;
+}
+
+
+void CDrawScrollView::RunPaintBenchmark()
+{
+    CPluginTesterDlg* dlg = dynamic_cast<CPluginTesterDlg*>(theApp.m_pMainWnd);
+    if (dlg == nullptr)
+        return;
+
+    const int repeat = 1000;
+    LARGE_INTEGER freq;
+    QueryPerformanceFrequency(&freq);
+
+    CClientDC client_dc(this);
+    CDC mem_dc;
+    mem_dc.CreateCompatibleDC(&client_dc);
+    CFont* old_font = mem_dc.SelectObject(theApp.m_pMainWnd->GetFont());
+
+    CString result;
+    PluginInfo cur_plugin = dlg->GetCurrentPlugin();
+    for (const auto& item : cur_plugin.plugin_items)
+    {
+        if (item == nullptr || !item->IsCustomDraw())
+            continue;
+        CRect rc_item = m_plugin_item_rect[item->GetItemId()];
+        if (rc_item.IsRectEmpty())
+            continue;
+
+        CBitmap bitmap;
+        bitmap.CreateCompatibleBitmap(&client_dc, rc_item.Width(), rc_item.Height());
+        CBitmap* old_bitmap = mem_dc.SelectObject(&bitmap);
+        bool dark_mode = dlg->IsDarkmodeChecked();
+
+        //第一次绘制（可能需要排版），之后的绘制内容和区域都不变
+        LARGE_INTEGER start, end;
+        QueryPerformanceCounter(&start);
+        item->DrawItem(mem_dc.GetSafeHdc(), 0, 0, rc_item.Width(), rc_item.Height(), dark_mode);
+        QueryPerformanceCounter(&end);
+        double first_us = (end.QuadPart - start.QuadPart) * 1000000.0 / freq.QuadPart;
+
+        QueryPerformanceCounter(&start);
+        for (int i = 0; i < repeat; i++)
+            item->DrawItem(mem_dc.GetSafeHdc(), 0, 0, rc_item.Width(), rc_item.Height(), dark_mode);
+        QueryPerformanceCounter(&end);
+        double repeat_us = (end.QuadPart - start.QuadPart) * 1000000.0 / freq.QuadPart / repeat;
+
+        mem_dc.SelectObject(old_bitmap);
+
+        CString line;
+        line.Format(_T("%s\r\n    首次: %.2f μs\r\n    重复 %d 次平均: %.2f μs\r\n"), item->GetItemName(), first_us, repeat, repeat_us);
+        result += line;
+    }
+    mem_dc.SelectObject(old_font);
+
+    if (result.IsEmpty())
+        result = _T("没有可测试的自定义绘制显示项目");
+    MessageBox(result, _T("绘制耗时测试"), MB_ICONINFORMATION | MB_OK);
+}
+
+
 BOOL CDrawScrollView::OnMouseWheel(UINT nFlags, short zDelta, CPoint pt)
 {
     CPoint point = pt;
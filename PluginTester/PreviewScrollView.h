@@ -27,6 +27,9 @@ public:
 
 private:
     IPluginItem* GetPluginItemByPoint(CPoint point);
+    void RecordPaintTime(const std::wstring& item_id, LONGLONG ticks);     //记录一次DrawItem的耗时
+    CString GetPaintTimeText(const std::wstring& item_id) const;           //获取显示项目的绘制耗时文本
+    void RunPaintBenchmark();                                              //连续调用DrawItem测量绘制耗时（F9）
 
 //成员变量
 protected:
@@ -35,6 +38,14 @@ protected:
     IPluginItem* m_plugin_item_clicked{};
     CToolTipCtrl m_tool_tips;
 
+    struct PaintStat
+    {
+        double last_us{};       //最近一次绘制耗时（微秒）
+        double total_us{};      //累计绘制耗时（微秒）
+        unsigned int count{};   //绘制次数
+    };
+    std::map<std::wstring, PaintStat> m_paint_stat;     //每个插件项目的绘制耗时统计
+
 protected:
     virtual void OnDraw(CDC* pDC);      // 重写以绘制该视图
     virtual void OnInitialUpdate();     // 构造后的第一次
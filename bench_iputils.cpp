@@ -0,0 +1,320 @@
+// 热路径微基准：JSON字段提取、供应商名称、地址优先级和分类、大地址集合的IPv6排序、地址格式化、显示文本和工具提示组合、
+// 适配器快照发布、完整Update（假外网后端，不访问网络）。结果按Google Benchmark的JSON格式输出，便于跨提交对比
+// 编译：cl /EHsc /std:c++14 /utf-8 /O2 /DUNICODE /D_UNICODE /DNOMINMAX /DWIN32_LEAN_AND_MEAN bench_iputils.cpp src\*.cpp /link User32.lib Gdi32.lib
+// 用法：bench_iputils [--filter 子串] [--min-time 秒] [--out 文件]
+#include <windows.h>
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cwchar>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+#include "src/plugin.h"
+
+namespace {
+
+/// 防止被测表达式被优化掉
+volatile size_t g_sink = 0;
+
+void Keep(size_t v) { g_sink = g_sink + v; }
+
+/**
+ * @brief 单项基准结果
+ */
+struct BenchResult {
+    std::string name;
+    unsigned long long iterations = 0;
+    double ns_per_op = 0.0;
+};
+
+/**
+ * @brief 基准运行器
+ * @details 先按倍增次数校准，使单轮耗时达到min_time后记录每次操作的平均耗时
+ */
+class BenchRunner {
+public:
+    BenchRunner(std::string filter, double min_time) : filter_(std::move(filter)), min_time_(min_time) {}
+
+    void Run(const char* name, const std::function<void()>& op) {
+        if (!filter_.empty() && std::strstr(name, filter_.c_str()) == nullptr) return;
+        unsigned long long iterations = 1;
+        double elapsed = 0.0;
+        for (;;) {
+            const auto start = std::chrono::steady_clock::now();
+            for (unsigned long long i = 0; i < iterations; ++i) op();
+            elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            if (elapsed >= min_time_ || iterations >= (1ULL << 40)) break;
+            // 按已测得的速度估算下一轮次数，至少翻倍、最多放大10倍
+            double scale = elapsed > 0.0 ? min_time_ * 1.4 / elapsed : 10.0;
+            if (scale < 2.0) scale = 2.0;
+            if (scale > 10.0) scale = 10.0;
+            iterations = static_cast<unsigned long long>(iterations * scale);
+        }
+        BenchResult r;
+        r.name = name;
+        r.iterations = iterations;
+        r.ns_per_op = elapsed * 1e9 / iterations;
+        std::fprintf(stderr, "%-40s %14.1f ns %12llu\n", name, r.ns_per_op, iterations);
+        results_.push_back(r);
+    }
+
+    /**
+     * @brief 按Google Benchmark的JSON格式写出结果
+     */
+    void WriteJson(FILE* out) const {
+        SYSTEM_INFO si{};
+        GetSystemInfo(&si);
+        std::fprintf(out, "{\n  \"context\": {\n");
+        std::fprintf(out, "    \"executable\": \"bench_iputils\",\n");
+        std::fprintf(out, "    \"num_cpus\": %lu,\n", si.dwNumberOfProcessors);
+#ifdef NDEBUG
+        std::fprintf(out, "    \"library_build_type\": \"release\"\n");
+#else
+        std::fprintf(out, "    \"library_build_type\": \"debug\"\n");
+#endif
+        std::fprintf(out, "  },\n  \"benchmarks\": [\n");
+        for (size_t i = 0; i < results_.size(); ++i) {
+            const BenchResult& r = results_[i];
+            std::fprintf(out, "    {\n");
+            std::fprintf(out, "      \"name\": \"%s\",\n", r.name.c_str());
+            std::fprintf(out, "      \"run_type\": \"iteration\",\n");
+            std::fprintf(out, "      \"iterations\": %llu,\n", r.iterations);
+            std::fprintf(out, "      \"real_time\": %.3f,\n", r.ns_per_op);
+            std::fprintf(out, "      \"time_unit\": \"ns\"\n");
+            std::fprintf(out, "    }%s\n", i + 1 < results_.size() ? "," : "");
+        }
+        std::fprintf(out, "  ]\n}\n");
+    }
+
+private:
+    std::string filter_;
+    double min_time_;
+    std::vector<BenchResult> results_;
+};
+
+const char kIpinfoJson[] =
+    "{\n  \"ip\": \"203.0.113.7\",\n  \"hostname\": \"host-7.example.net\",\n  \"city\": \"Tokyo\",\n"
+    "  \"region\": \"Tokyo\",\n  \"country\": \"JP\",\n  \"loc\": \"35.6895,139.6917\",\n"
+    "  \"org\": \"AS64500 Example Networks Inc.\",\n  \"postal\": \"100-0001\",\n  \"timezone\": \"Asia/Tokyo\"\n}";
+
+const wchar_t* const kOrgs[] = {
+    L"AS906 DMIT Cloud Services",
+    L"AS4134 CHINANET-BACKBONE",
+    L"AS15169 Google LLC",
+    L"AS13335 Cloudflare, Inc.",
+    L"AS64500 Example Networks Inc.",
+    L"",
+};
+
+iputils::AdapterAddress MakeV4(unsigned char a, unsigned char b, unsigned char c, unsigned char d) {
+    iputils::AdapterAddress addr;
+    addr.family = AF_INET;
+    addr.bytes[0] = a; addr.bytes[1] = b; addr.bytes[2] = c; addr.bytes[3] = d;
+    wchar_t buf[INET_ADDRSTRLEN] = {};
+    InetNtopW(AF_INET, addr.bytes, buf, INET_ADDRSTRLEN);
+    addr.text = buf;
+    return addr;
+}
+
+iputils::Ipv6Candidate MakeV6(const wchar_t* text, bool deprecated, bool temporary) {
+    iputils::Ipv6Candidate c;
+    InetPtonW(AF_INET6, text, c.addr.bytes);
+    c.deprecated = deprecated;
+    c.temporary = temporary;
+    return c;
+}
+
+/**
+ * @brief 生成count个混合类型的IPv6候选地址
+ * @details 依次循环：全局稳定、全局临时、全局已弃用、ULA、链路本地、全局临时且已弃用，
+ *          接口标识由固定种子的线性同余序列生成，每次运行相同
+ */
+std::vector<iputils::Ipv6Candidate> MakeV6Set(size_t count) {
+    std::vector<iputils::Ipv6Candidate> set(count);
+    unsigned long long seed = 0x9E3779B97F4A7C15ULL;
+    for (size_t i = 0; i < count; ++i) {
+        iputils::Ipv6Candidate& c = set[i];
+        const int kind = static_cast<int>(i % 6);
+        unsigned char* b = c.addr.bytes;
+        if (kind == 3) {
+            b[0] = 0xfd; b[1] = 0x12; b[2] = 0x34; b[3] = 0x56;                 // fd12:3456::/32
+        } else if (kind == 4) {
+            b[0] = 0xfe; b[1] = 0x80;                                           // fe80::/64
+        } else {
+            b[0] = 0x20; b[1] = 0x01; b[2] = 0x0d; b[3] = 0xb8;                 // 2001:db8::/32
+        }
+        b[7] = static_cast<unsigned char>(i >> 8);
+        b[6] = static_cast<unsigned char>(i);
+        for (int k = 8; k < 16; ++k) {
+            seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+            b[k] = static_cast<unsigned char>(seed >> 56);
+        }
+        c.temporary = kind == 1 || kind == 5;
+        c.deprecated = kind == 2 || kind == 5;
+    }
+    return set;
+}
+
+/**
+ * @brief 假外网查询后端：立即返回固定结果
+ */
+bool FakeLookup(iputils::LookupContext& ctx) {
+    ctx.result.ip = L"203.0.113.7";
+    if (!ctx.ip_only) {
+        ctx.result.country = L"JP";
+        ctx.result.as_name = L"AS64500 Example Networks Inc.";
+    }
+    ctx.stage = iputils::LookupStage::DONE;
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    std::string filter;
+    double min_time = 0.2;
+    const char* out_path = nullptr;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (std::strcmp(argv[i], "--filter") == 0) filter = argv[i + 1];
+        else if (std::strcmp(argv[i], "--min-time") == 0) min_time = std::atof(argv[i + 1]);
+        else if (std::strcmp(argv[i], "--out") == 0) out_path = argv[i + 1];
+    }
+
+    // 隔离的IP服务，外网查询使用假后端
+    iputils::IpService service;
+    iputils::ScopedIpService scope(service);
+    service.SetLookupBackend(FakeLookup);
+
+    BenchRunner bench(filter, min_time);
+
+    // === JSON字段提取 ===
+    const std::string json = kIpinfoJson;
+    bench.Run("ExtractJsonField/ip", [&] { Keep(iputils::ExtractJsonField(json, "ip").size()); });
+    bench.Run("ExtractJsonField/org", [&] { Keep(iputils::ExtractJsonField(json, "org").size()); });
+    bench.Run("ExtractJsonField/missing", [&] { Keep(iputils::ExtractJsonField(json, "asn").size()); });
+
+    // === 供应商名称 ===
+    std::vector<iputils::IpWithCountry> orgs;
+    for (const wchar_t* org : kOrgs) {
+        iputils::IpWithCountry r;
+        r.ip = L"203.0.113.7";
+        r.as_name = org;
+        orgs.push_back(r);
+    }
+    size_t org_index = 0;
+    bench.Run("GetCompanyName", [&] {
+        Keep(orgs[org_index].GetCompanyName().size());
+        org_index = (org_index + 1) % orgs.size();
+    });
+
+    // === 地址优先级和分类 ===
+    iputils::AdapterEntry adapter;
+    adapter.addresses.push_back(MakeV4(169, 254, 10, 20));
+    adapter.addresses.push_back(MakeV4(172, 20, 1, 5));
+    adapter.addresses.push_back(MakeV4(10, 0, 0, 15));
+    adapter.addresses.push_back(MakeV4(100, 64, 3, 9));
+    adapter.addresses.push_back(MakeV4(192, 168, 1, 100));
+    adapter.addresses.push_back(MakeV4(127, 0, 0, 1));
+    size_t addr_index = 0;
+    bench.Run("GetIPPriority", [&] {
+        Keep(static_cast<size_t>(iputils::GetIPPriority(adapter.addresses[addr_index])));
+        addr_index = (addr_index + 1) % adapter.addresses.size();
+    });
+    bench.Run("PickIPv4/6_addresses", [&] { Keep(iputils::PickIPv4(adapter).size()); });
+
+    const iputils::Ipv6Candidate v6[] = {
+        MakeV6(L"fe80::1c2d:3e4f:5a6b:7c8d", false, false),
+        MakeV6(L"fd12:3456:789a::10", false, false),
+        MakeV6(L"2001:db8:1:2::1234", true, false),
+        MakeV6(L"2001:db8:1:2:a1b2:c3d4:e5f6:789", false, true),
+        MakeV6(L"2001:db8:1:2::abcd", false, false),
+    };
+    iputils::Ipv6SelectOptions v6opt;
+    size_t v6_index = 0;
+    bench.Run("ClassifyIPv6", [&] {
+        Keep(static_cast<size_t>(iputils::ClassifyIPv6(v6[v6_index].addr)));
+        v6_index = (v6_index + 1) % _countof(v6);
+    });
+    bench.Run("SelectBestIPv6/5_candidates", [&] { Keep(iputils::SelectBestIPv6(v6, _countof(v6), v6opt)); });
+
+    // 大地址集合（大量临时地址或多前缀网络）：整组排序和选择
+    const std::vector<iputils::Ipv6Candidate> v6_64 = MakeV6Set(64);
+    const std::vector<iputils::Ipv6Candidate> v6_1024 = MakeV6Set(1024);
+    iputils::Ipv6SelectOptions v6all;
+    v6all.skip_deprecated = false;
+    v6all.skip_temporary = false;
+    bench.Run("SelectBestIPv6/64_candidates", [&] { Keep(iputils::SelectBestIPv6(v6_64.data(), v6_64.size(), v6opt)); });
+    bench.Run("SelectBestIPv6/1024_candidates", [&] { Keep(iputils::SelectBestIPv6(v6_1024.data(), v6_1024.size(), v6opt)); });
+    bench.Run("SelectBestIPv6/1024_candidates_no_skip", [&] {
+        Keep(iputils::SelectBestIPv6(v6_1024.data(), v6_1024.size(), v6all));
+    });
+    bench.Run("RankIPv6/64_candidates", [&] {
+        size_t sum = 0;
+        for (const auto& c : v6_64) sum += static_cast<size_t>(iputils::RankIPv6(c, v6opt));
+        Keep(sum);
+    });
+    bench.Run("RankIPv6/1024_candidates", [&] {
+        size_t sum = 0;
+        for (const auto& c : v6_1024) sum += static_cast<size_t>(iputils::RankIPv6(c, v6opt));
+        Keep(sum);
+    });
+
+    // === 地址格式化 ===
+    bench.Run("FormatIPv4/InetNtopW", [&] {
+        wchar_t buf[INET_ADDRSTRLEN] = {};
+        InetNtopW(AF_INET, adapter.addresses[4].bytes, buf, INET_ADDRSTRLEN);
+        Keep(buf[0]);
+    });
+    bench.Run("FormatIPv6", [&] {
+        wchar_t buf[iputils::kIpv6TextSize];
+        Keep(iputils::FormatIPv6(v6[4].addr, buf));
+    });
+
+    // === 显示文本和工具提示 ===
+    PluginOptions options;
+    options.show_ipv6 = true;
+    IpTextProvider provider(options);
+    IpPluginItem item(&provider);
+    // 等待假后端的结果写回缓存
+    for (int i = 0; i < 200 && !iputils::GetCachedExternalIPv4().IsValid(); ++i) {
+        item.Update(i == 0);
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    item.Update(false);
+
+    const iputils::IpWithCountry external = iputils::GetCachedExternalIPv4();
+    const std::wstring external_text = external.GetDisplayString();
+    bench.Run("FormatText", [&] { Keep(provider.FormatText(L"192.168.1.100", external_text, external).size()); });
+    bench.Run("Tooltip", [&] { Keep(std::wcslen(item.Tooltip())); });
+
+    // === 适配器快照发布 ===
+    iputils::AdapterInventory inventory;
+    inventory.Get();
+    bench.Run("AdapterSnapshot/Get", [&] { Keep(inventory.Get()->adapters.size()); });
+    bool flip = false;
+    bench.Run("AdapterSnapshot/SetPreferred", [&] {
+        flip = !flip;
+        inventory.SetPreferred(flip ? L"以太网" : L"Wi-Fi");
+    });
+
+    // === 完整Update ===
+    bench.Run("Update/unchanged", [&] { Keep(item.Update(false)); });
+    bench.Run("Update/rebuild", [&] {
+        provider.SetOptions(options);  // 选项版本号加一，强制重建显示文本
+        Keep(item.Update(false));
+    });
+
+    FILE* out = stdout;
+    if (out_path && fopen_s(&out, out_path, "w") != 0) {
+        std::fprintf(stderr, "cannot open %s\n", out_path);
+        return 1;
+    }
+    bench.WriteJson(out);
+    if (out != stdout) std::fclose(out);
+    return 0;
+}
@@ -0,0 +1,76 @@
+// 配置文件加载基准：对比逐键GetPrivateProfile*W与单遍解析的启动耗时
+// 编译：cl /EHsc /std:c++14 /utf-8 bench_options_load.cpp src\options_store.cpp src\options_schema.cpp src\module_state.cpp
+#include <windows.h>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include "src/options_store.h"
+
+namespace {
+
+const int kIterations = 1000;
+
+/**
+ * @brief 旧的加载方式：PathFileExistsW之后每个键单独调用GetPrivateProfile*W
+ */
+void LegacyLoad(const std::wstring& ini, PluginOptions& o) {
+    if (GetFileAttributesW(ini.c_str()) == INVALID_FILE_ATTRIBUTES) return;
+    wchar_t buf[256]{};
+    for (size_t i = 0; i < kOptionSchemaSize; ++i) {
+        const OptionField& f = kOptionSchema[i];
+        if (f.kind == OptionKind::STRING) {
+            GetPrivateProfileStringW(kOptionSection, f.key, L"", buf, (DWORD)_countof(buf), ini.c_str());
+            o.*f.text = buf;
+        } else {
+            int v = GetPrivateProfileIntW(kOptionSection, f.key, 0, ini.c_str());
+            if (f.kind == OptionKind::BOOL) o.*f.flag = v != 0;
+            else if (f.kind == OptionKind::MINUTES) o.*f.minutes = std::chrono::minutes(v);
+            else if (f.kind == OptionKind::SECONDS) o.*f.seconds = std::chrono::seconds(v);
+            else o.*f.number = v;
+        }
+    }
+}
+
+template <typename F>
+double MeasureUs(F&& f) {
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kIterations; ++i) f();
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration<double, std::micro>(elapsed).count() / kIterations;
+}
+
+} // namespace
+
+int main() {
+    wchar_t dir[MAX_PATH]{};
+    GetTempPathW(MAX_PATH, dir);
+    const std::wstring ini = std::wstring(dir) + L"tm_ip_plugin_bench.ini";
+
+    // 用插件自己的写入路径生成配置文件
+    {
+        OptionsStore store;
+        store.SetPath(ini);
+        PluginOptions o;
+        o.preferred_adapter = L"以太网";
+        store.Save(o);
+        store.Flush();
+    }
+
+    OptionsStore store;
+    store.SetPath(ini);
+
+    PluginOptions a, b;
+    const double legacy_us = MeasureUs([&] { LegacyLoad(ini, a); });
+    OptionsParseStats stats;
+    const double single_us = MeasureUs([&] { store.Load(b, &stats); });
+
+    std::wcout << L"Iterations:            " << kIterations << std::endl;
+    std::wcout << L"GetPrivateProfile*W:   " << legacy_us << L" us/load" << std::endl;
+    std::wcout << L"Single-pass:           " << single_us << L" us/load" << std::endl;
+    std::wcout << L"Keys applied/rejected: " << stats.applied << L"/" << stats.rejected << std::endl;
+    std::wcout << L"Results match:         " << (a.preferred_adapter == b.preferred_adapter
+        && a.external_refresh == b.external_refresh && a.show_ipv6 == b.show_ipv6 ? L"yes" : L"no") << std::endl;
+
+    DeleteFileW(ini.c_str());
+    return 0;
+}
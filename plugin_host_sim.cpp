@@ -0,0 +1,377 @@
+// 无界面插件宿主：按可配置的频率调用DataRequired/GetTooltipInfo/GetItemValueText，
+// 外网查询使用假后端（不访问网络），统计每类调用的延迟分布、每次刷新的内存分配和I/O操作次数，
+// 以及运行前后的进程线程数和每次刷新的线程上下文切换次数
+// 编译：cl /EHsc /std:c++14 /utf-8 /DUNICODE /D_UNICODE /DNOMINMAX /DWIN32_LEAN_AND_MEAN plugin_host_sim.cpp src\*.cpp /link User32.lib Gdi32.lib
+// 用法：plugin_host_sim [--ticks N] [--rate HZ] [--tooltip-every K] [--value-every K]
+//                       [--lookup-ms MS] [--ip-change-every N] [--ipv6]
+#include <windows.h>
+#include <winternl.h>
+#include <tlhelp32.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cwchar>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+#include "src/plugin.h"
+
+extern "C" __declspec(dllexport) ITMPlugin* TMPluginGetInstance();
+
+// === 内存分配计数 ===
+
+namespace {
+
+std::atomic<unsigned long long> g_allocs{ 0 };  ///< 所有线程的分配次数
+thread_local unsigned long long t_allocs = 0;   ///< 当前线程的分配次数
+
+} // namespace
+
+void* operator new(size_t size) {
+    ++g_allocs;
+    ++t_allocs;
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+void* operator new[](size_t size) { return operator new(size); }
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+void operator delete[](void* p, size_t) noexcept { std::free(p); }
+
+namespace {
+
+/**
+ * @brief 宿主参数
+ */
+struct HostConfig {
+    int ticks = 600;             ///< DataRequired调用次数
+    double rate = 10.0;          ///< 每秒调用次数（0表示不等待）
+    int tooltip_every = 5;       ///< 每隔几次刷新请求一次工具提示（0表示不请求）
+    int value_every = 1;         ///< 每隔几次刷新读取一次显示文本（0表示不读取）
+    int lookup_ms = 80;          ///< 假后端每次查询的耗时
+    int ip_change_every = 0;     ///< 假后端每隔几次查询换一个IP（0表示不变）
+    bool ipv6 = false;           ///< 是否启用IPv6显示
+};
+
+/**
+ * @brief 模拟TrafficMonitor主程序
+ */
+class FakeTrafficMonitor : public ITrafficMonitor {
+public:
+    explicit FakeTrafficMonitor(std::wstring dir) : dir_(std::move(dir)) {}
+
+    int GetAPIVersion() override { return 7; }
+    const wchar_t* GetVersion() override { return L"host-sim"; }
+    double GetMonitorValue(MonitorItem) override { return 0.0; }
+    const wchar_t* GetMonitorValueString(MonitorItem, int) override { return L""; }
+    void ShowNotifyMessage(const wchar_t* msg) override { ++notifications_; last_notify_ = msg ? msg : L""; }
+    unsigned short GetLanguageId() const override { return 0x0804; }
+    const wchar_t* GetPluginConfigDir() const override { return dir_.c_str(); }
+    int GetDPI(DPIType) const override { return 96; }
+    unsigned int GetThemeColor() const override { return 0x00D77800; }
+
+    int Notifications() const { return notifications_; }
+
+private:
+    std::wstring dir_;
+    int notifications_ = 0;
+    std::wstring last_notify_;
+};
+
+/**
+ * @brief 假外网查询后端
+ * @details 在工作线程上等待lookup_ms后返回文档保留地址段中的IP，不产生网络流量
+ */
+class FakeLookupBackend {
+public:
+    explicit FakeLookupBackend(const HostConfig& cfg) : cfg_(cfg) {}
+
+    bool operator()(iputils::LookupContext& ctx) {
+        const auto start = std::chrono::steady_clock::now();
+        if (cfg_.lookup_ms > 0) std::this_thread::sleep_for(std::chrono::milliseconds(cfg_.lookup_ms));
+        const unsigned long n = ++calls_;
+        const unsigned long index = cfg_.ip_change_every > 0 ? (n - 1) / cfg_.ip_change_every : 0;
+
+        if (ctx.opt.host_v6 && ctx.opt.host == ctx.opt.host_v6) {
+            ctx.result.ip = L"2001:db8::" + std::to_wstring(index % 0xFFFF + 1);
+        } else {
+            ctx.result.ip = L"203.0.113." + std::to_wstring(index % 254 + 1);
+            if (!ctx.ip_only) {
+                ctx.result.country = L"JP";
+                ctx.result.as_name = L"AS64500 Example Networks Inc.";
+            }
+        }
+        ctx.status_code = 200;
+        ctx.stage = iputils::LookupStage::DONE;
+        ctx.elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+        return true;
+    }
+
+    unsigned long Calls() const { return calls_; }
+
+private:
+    const HostConfig& cfg_;
+    std::atomic<unsigned long> calls_{ 0 };
+};
+
+/**
+ * @brief 单类调用的统计
+ */
+struct CallStats {
+    std::vector<double> latency_us;             ///< 每次调用的耗时（微秒）
+    std::vector<unsigned long long> allocs;     ///< 每次调用中调用线程的分配次数
+    std::vector<unsigned long long> io_ops;     ///< 每次调用中进程的I/O操作次数
+
+    void Reserve(size_t n) {
+        latency_us.reserve(n);
+        allocs.reserve(n);
+        io_ops.reserve(n);
+    }
+};
+
+unsigned long long ProcessIoOperations() {
+    IO_COUNTERS io{};
+    if (!GetProcessIoCounters(GetCurrentProcess(), &io)) return 0;
+    return io.ReadOperationCount + io.WriteOperationCount + io.OtherOperationCount;
+}
+
+/**
+ * @brief 进程内线程数（Toolhelp32快照）
+ */
+unsigned long ProcessThreadCount() {
+    HANDLE snap = CreateToolhelp32Snapshot(TH32CS_SNAPTHREAD, 0);
+    if (snap == INVALID_HANDLE_VALUE) return 0;
+    const DWORD pid = GetCurrentProcessId();
+    unsigned long count = 0;
+    THREADENTRY32 te{};
+    te.dwSize = sizeof(te);
+    for (BOOL ok = Thread32First(snap, &te); ok; ok = Thread32Next(snap, &te)) {
+        if (te.th32OwnerProcessID == pid) ++count;
+    }
+    CloseHandle(snap);
+    return count;
+}
+
+/**
+ * @brief SYSTEM_THREAD_INFORMATION（winternl.h未定义），紧跟在SYSTEM_PROCESS_INFORMATION之后
+ */
+struct SystemThreadInfo {
+    LARGE_INTEGER kernel_time;
+    LARGE_INTEGER user_time;
+    LARGE_INTEGER create_time;
+    ULONG wait_time;
+    PVOID start_address;
+    HANDLE unique_process;
+    HANDLE unique_thread;
+    LONG priority;
+    LONG base_priority;
+    ULONG context_switches;
+    ULONG thread_state;
+    ULONG wait_reason;
+};
+
+/**
+ * @brief 进程内线程的上下文切换次数
+ */
+struct ContextSwitches {
+    unsigned long long caller = 0;      ///< 调用线程（宿主主线程）
+    unsigned long long others = 0;      ///< 其他线程（插件的工作线程等）
+};
+
+/**
+ * @brief 用NtQuerySystemInformation(SystemProcessInformation)读取本进程各线程的上下文切换次数
+ */
+ContextSwitches ProcessContextSwitches() {
+    using QueryFn = NTSTATUS(NTAPI*)(SYSTEM_INFORMATION_CLASS, PVOID, ULONG, PULONG);
+    static const auto query = reinterpret_cast<QueryFn>(
+        GetProcAddress(GetModuleHandleW(L"ntdll.dll"), "NtQuerySystemInformation"));
+    ContextSwitches result;
+    if (!query) return result;
+
+    // 缓冲区不够时按返回的长度加余量重试（两次调用之间可能有新进程和线程）
+    std::vector<unsigned char> buf(256 * 1024);
+    for (;;) {
+        ULONG needed = 0;
+        const NTSTATUS status = query(SystemProcessInformation, buf.data(), static_cast<ULONG>(buf.size()), &needed);
+        if (status >= 0) break;
+        if (needed == 0 || needed + 64 * 1024 <= buf.size()) return result;
+        buf.resize(needed + 64 * 1024);
+    }
+
+    const HANDLE pid = reinterpret_cast<HANDLE>(static_cast<ULONG_PTR>(GetCurrentProcessId()));
+    const HANDLE tid = reinterpret_cast<HANDLE>(static_cast<ULONG_PTR>(GetCurrentThreadId()));
+    for (size_t offset = 0;;) {
+        const auto* proc = reinterpret_cast<const SYSTEM_PROCESS_INFORMATION*>(buf.data() + offset);
+        if (proc->UniqueProcessId == pid) {
+            const auto* threads = reinterpret_cast<const SystemThreadInfo*>(proc + 1);
+            for (ULONG i = 0; i < proc->NumberOfThreads; ++i) {
+                if (threads[i].unique_thread == tid) result.caller += threads[i].context_switches;
+                else result.others += threads[i].context_switches;
+            }
+            break;
+        }
+        if (proc->NextEntryOffset == 0) break;
+        offset += proc->NextEntryOffset;
+    }
+    return result;
+}
+
+/**
+ * @brief 计时并记录一次调用
+ */
+template <typename F>
+void Measure(CallStats& stats, F&& f) {
+    const unsigned long long io_before = ProcessIoOperations();
+    const unsigned long long allocs_before = t_allocs;
+    const auto start = std::chrono::steady_clock::now();
+    f();
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    const unsigned long long allocs = t_allocs - allocs_before;
+    const unsigned long long io = ProcessIoOperations() - io_before;
+    stats.latency_us.push_back(std::chrono::duration<double, std::micro>(elapsed).count());
+    stats.allocs.push_back(allocs);
+    stats.io_ops.push_back(io);
+}
+
+template <typename T>
+T Percentile(std::vector<T> v, double p) {
+    if (v.empty()) return T();
+    std::sort(v.begin(), v.end());
+    size_t i = static_cast<size_t>(p * (v.size() - 1) + 0.5);
+    return v[std::min(i, v.size() - 1)];
+}
+
+template <typename T>
+double Mean(const std::vector<T>& v) {
+    if (v.empty()) return 0.0;
+    double sum = 0.0;
+    for (const T& x : v) sum += static_cast<double>(x);
+    return sum / v.size();
+}
+
+void Report(const wchar_t* name, const CallStats& s) {
+    std::wcout << std::left << std::setw(18) << name << std::right
+        << std::setw(8) << s.latency_us.size()
+        << std::fixed << std::setprecision(1)
+        << std::setw(10) << Percentile(s.latency_us, 0.50)
+        << std::setw(10) << Percentile(s.latency_us, 0.99)
+        << std::setw(10) << (s.latency_us.empty() ? 0.0 : *std::max_element(s.latency_us.begin(), s.latency_us.end()))
+        << std::setprecision(2)
+        << std::setw(10) << Mean(s.allocs)
+        << std::setw(8) << Percentile(s.allocs, 0.99)
+        << std::setw(10) << Mean(s.io_ops)
+        << std::endl;
+}
+
+bool ParseArgs(int argc, wchar_t** argv, HostConfig& cfg) {
+    for (int i = 1; i < argc; ++i) {
+        const std::wstring arg = argv[i];
+        const bool has_value = i + 1 < argc;
+        if (arg == L"--ipv6") cfg.ipv6 = true;
+        else if (arg == L"--ticks" && has_value) cfg.ticks = _wtoi(argv[++i]);
+        else if (arg == L"--rate" && has_value) cfg.rate = _wtof(argv[++i]);
+        else if (arg == L"--tooltip-every" && has_value) cfg.tooltip_every = _wtoi(argv[++i]);
+        else if (arg == L"--value-every" && has_value) cfg.value_every = _wtoi(argv[++i]);
+        else if (arg == L"--lookup-ms" && has_value) cfg.lookup_ms = _wtoi(argv[++i]);
+        else if (arg == L"--ip-change-every" && has_value) cfg.ip_change_every = _wtoi(argv[++i]);
+        else return false;
+    }
+    return cfg.ticks > 0 && cfg.rate >= 0.0;
+}
+
+} // namespace
+
+int wmain(int argc, wchar_t** argv) {
+    HostConfig cfg;
+    if (!ParseArgs(argc, argv, cfg)) {
+        std::wcerr << L"usage: plugin_host_sim [--ticks N] [--rate HZ] [--tooltip-every K] [--value-every K]"
+            L" [--lookup-ms MS] [--ip-change-every N] [--ipv6]" << std::endl;
+        return 2;
+    }
+
+    // 独立的配置目录，预先写入本次运行的选项
+    wchar_t temp[MAX_PATH]{};
+    GetTempPathW(MAX_PATH, temp);
+    const std::wstring dir = std::wstring(temp) + L"tm_ip_plugin_host";
+    CreateDirectoryW(dir.c_str(), nullptr);
+    const std::wstring ini = dir + L"\\tm_ip_plugin.ini";
+    {
+        OptionsStore store;
+        store.SetPath(ini);
+        PluginOptions o;
+        o.show_ipv6 = cfg.ipv6;
+        store.Save(o);
+        store.Flush();
+    }
+
+    FakeTrafficMonitor host(dir);
+    FakeLookupBackend backend(cfg);
+    ITMPlugin* plugin = TMPluginGetInstance();
+    // 插件构造时已把自己的IpService安装为当前服务
+    iputils::IpService::Current().SetLookupBackend(std::ref(backend));
+    plugin->OnExtenedInfo(ITMPlugin::EI_CONFIG_DIR, dir.c_str());
+    plugin->OnInitialize(&host);
+    IPluginItem* item = plugin->GetItem(0);
+
+    CallStats data, tooltip, value;
+    data.Reserve(cfg.ticks);
+    tooltip.Reserve(cfg.ticks);
+    value.Reserve(cfg.ticks);
+
+    const unsigned long long total_allocs_before = g_allocs.load();
+    const unsigned long threads_before = ProcessThreadCount();
+    const ContextSwitches switches_before = ProcessContextSwitches();
+    const auto period = cfg.rate > 0.0
+        ? std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1.0 / cfg.rate))
+        : std::chrono::steady_clock::duration::zero();
+    const auto run_start = std::chrono::steady_clock::now();
+    auto next = run_start;
+    size_t text_len = 0;
+    for (int tick = 0; tick < cfg.ticks; ++tick) {
+        Measure(data, [&] { plugin->DataRequired(); });
+        if (cfg.value_every > 0 && tick % cfg.value_every == 0) {
+            Measure(value, [&] { text_len += std::wcslen(item->GetItemValueText()); });
+        }
+        if (cfg.tooltip_every > 0 && tick % cfg.tooltip_every == 0) {
+            Measure(tooltip, [&] { text_len += std::wcslen(plugin->GetTooltipInfo()); });
+        }
+        next += period;
+        std::this_thread::sleep_until(next);
+    }
+    const double run_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - run_start).count();
+    const unsigned long long total_allocs = g_allocs.load() - total_allocs_before;
+    const ContextSwitches switches_after = ProcessContextSwitches();
+    const unsigned long threads_after = ProcessThreadCount();
+
+    std::wcout << L"Ticks:          " << cfg.ticks << L" in " << std::fixed << std::setprecision(2) << run_s << L" s"
+        << L" (target " << cfg.rate << L" Hz)" << std::endl;
+    std::wcout << L"Fake lookups:   " << backend.Calls() << L" (" << cfg.lookup_ms << L" ms each)" << std::endl;
+    std::wcout << L"Notifications:  " << host.Notifications() << std::endl;
+    std::wcout << L"Allocs/tick:    " << (double)total_allocs / cfg.ticks << L" (all threads)" << std::endl;
+    std::wcout << L"Threads:        " << threads_before << L" before, " << threads_after << L" after" << std::endl;
+    // 主线程在每次刷新之间休眠，至少切换一次；其他线程的切换来自插件的后台工作
+    std::wcout << L"Switches/tick:  "
+        << (double)(switches_after.caller - switches_before.caller) / cfg.ticks << L" host thread, "
+        << (double)(switches_after.others - switches_before.others) / cfg.ticks << L" other threads" << std::endl;
+    std::wcout << L"Value text:     " << item->GetItemValueText() << std::endl;
+    std::wcout << std::endl;
+    std::wcout << std::left << std::setw(18) << L"call" << std::right
+        << std::setw(8) << L"count" << std::setw(10) << L"p50 us" << std::setw(10) << L"p99 us"
+        << std::setw(10) << L"max us" << std::setw(10) << L"allocs" << std::setw(8) << L"p99"
+        << std::setw(10) << L"io ops" << std::endl;
+    Report(L"DataRequired", data);
+    Report(L"GetItemValueText", value);
+    Report(L"GetTooltipInfo", tooltip);
+
+    // 插件对象在main返回后才析构，先停止工作线程，避免查询回调访问已析构的假后端
+    iputils::IpService::Current().Shutdown();
+    iputils::IpService::Current().SetLookupBackend(nullptr);
+    (void)text_len;
+    DeleteFileW(ini.c_str());
+    return 0;
+}
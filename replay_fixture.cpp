@@ -0,0 +1,208 @@
+// 网络录制和回放：record模式按1秒刷新驱动真实的IP服务并录制适配器快照、路由和外网应答；
+// replay模式把录制数据作为网络状态来源和查询后端，在虚拟时钟下重放，统计外网请求次数、
+// 显示内容变化次数以及网络变化反映到显示的延迟，可设置上限，超出时返回1
+// 编译：cl /EHsc /std:c++14 /utf-8 /O2 /DUNICODE /D_UNICODE /DNOMINMAX /DWIN32_LEAN_AND_MEAN replay_fixture.cpp src\*.cpp /link User32.lib Gdi32.lib
+// 用法：replay_fixture record <文件> [--seconds N]
+//       replay_fixture replay <文件> [--tick-ms N] [--ipv6] [--max-requests N] [--max-changes N] [--max-reflect-ms N]
+#include <windows.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "src/plugin.h"
+#include "src/net_fixture.h"
+
+namespace {
+
+/**
+ * @brief 回放参数
+ */
+struct ReplayConfig {
+    long long tick_ms = 1000;       ///< 刷新间隔（与TrafficMonitor的DataRequired相同）
+    bool ipv6 = false;              ///< 是否启用IPv6显示
+    long long max_requests = -1;    ///< 外网请求次数上限（-1表示不检查）
+    long long max_changes = -1;     ///< 显示变化次数上限
+    long long max_reflect_ms = -1;  ///< 网络变化反映到显示的延迟上限
+};
+
+/**
+ * @brief 应当反映到显示上的录制事件（快照指纹变化或外网IP变化）的时间
+ */
+std::vector<long long> VisibleEvents(const iputils::NetworkFixture& fixture) {
+    std::vector<long long> events;
+    unsigned long long fingerprint = 0;
+    for (const auto& s : fixture.snapshots) {
+        if (fingerprint != 0 && s.snapshot->fingerprint != fingerprint) events.push_back(s.at_ms);
+        fingerprint = s.snapshot->fingerprint;
+    }
+    std::wstring ip;
+    for (const auto& r : fixture.responses) {
+        if (r.v6 || !r.ok) continue;
+        if (!ip.empty() && r.result.ip != ip) events.push_back(r.at_ms);
+        ip = r.result.ip;
+    }
+    std::sort(events.begin(), events.end());
+    return events;
+}
+
+int Record(const std::wstring& path, int seconds) {
+    iputils::IpService service;
+    iputils::ScopedIpService scope(service);
+    iputils::FixtureRecorder recorder;
+    iputils::HttpTransport transport, transport_v6;
+    iputils::DnsCache dns;
+    // 真实查询，录制应答和耗时
+    service.SetLookupBackend([&](iputils::LookupContext& ctx) {
+        const bool v6 = ctx.opt.host_v6 && ctx.opt.host == ctx.opt.host_v6;
+        const auto started = std::chrono::steady_clock::now();
+        bool ok = iputils::RunLookupPipeline(ctx, v6 ? transport_v6 : transport, dns);
+        recorder.RecordResponse(ctx, v6, ok, started);
+        return ok;
+    });
+
+    PluginOptions options;
+    options.show_ipv6 = true;
+    IpTextProvider provider(options);
+    IpPluginItem item(&provider);
+    for (int i = 0; i < seconds; ++i) {
+        item.Update(false);
+        recorder.RecordNetwork(service.GetAdapterSnapshot(), *service.GetDefaultRoute());
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+    }
+    service.Shutdown();
+
+    const iputils::NetworkFixture fixture = recorder.Finish();
+    if (!iputils::SaveFixture(path, fixture)) {
+        std::wcerr << L"cannot write " << path << std::endl;
+        return 1;
+    }
+    std::wcout << L"Recorded " << fixture.snapshots.size() << L" snapshots, " << fixture.routes.size()
+        << L" routes, " << fixture.responses.size() << L" responses in " << fixture.duration_ms / 1000 << L" s" << std::endl;
+    return 0;
+}
+
+int Replay(const std::wstring& path, const ReplayConfig& cfg) {
+    iputils::NetworkFixture fixture;
+    if (!iputils::LoadFixture(path, fixture)) {
+        std::wcerr << L"cannot read " << path << std::endl;
+        return 1;
+    }
+
+    iputils::VirtualClock clock;
+    iputils::FixtureReplay replay(fixture, clock);
+    iputils::IpService service;
+    iputils::ScopedIpService scope(service);
+    service.SetNetworkSource(&replay);
+    service.SetLookupBackend([&](iputils::LookupContext& ctx) { return replay.Lookup(ctx); });
+    service.SetClock([&] { return clock.Now(); });
+    service.SetManualExecution(true);
+
+    PluginOptions options;
+    options.show_ipv6 = cfg.ipv6;
+    IpTextProvider provider(options);
+    IpPluginItem item(&provider);
+
+    const std::vector<long long> events = VisibleEvents(fixture);
+    size_t next_event = 0;
+    long long pending_event = -1;       // 尚未反映到显示的事件时间
+    long long reflect_max = 0, reflect_total = 0, reflected = 0, unreflected = 0;
+    unsigned long changes = 0;
+    unsigned long content = item.ContentVersion();
+    long long due = -1;                 // 排队中的查询按录制耗时完成的时间
+
+    const auto wall_start = std::chrono::steady_clock::now();
+    for (long long t = 0; t <= fixture.duration_ms; t += cfg.tick_ms) {
+        // 新事件到来时上一个事件仍未反映，记为未反映
+        while (next_event < events.size() && events[next_event] <= t) {
+            if (pending_event >= 0) ++unreflected;
+            pending_event = events[next_event++];
+        }
+
+        if (due >= 0 && t >= due) {
+            service.RunPendingTasks();
+            due = -1;
+        }
+        item.Update(false);
+        if (due < 0 && service.PendingTaskCount() > 0) due = t + replay.CurrentLatencyMs(false);
+
+        if (item.ContentVersion() != content) {
+            content = item.ContentVersion();
+            ++changes;
+            if (pending_event >= 0) {
+                const long long latency = t - pending_event;
+                reflect_max = std::max(reflect_max, latency);
+                reflect_total += latency;
+                ++reflected;
+                pending_event = -1;
+            }
+        }
+        clock.Advance(std::chrono::milliseconds(cfg.tick_ms));
+    }
+    if (pending_event >= 0) ++unreflected;
+    const double wall_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - wall_start).count();
+
+    std::wcout << L"Replayed:        " << fixture.duration_ms / 1000 << L" s in " << wall_ms << L" ms" << std::endl;
+    std::wcout << L"Requests:        " << replay.RequestCount() << L" IPv4, " << replay.RequestCountV6() << L" IPv6" << std::endl;
+    std::wcout << L"Display changes: " << changes << std::endl;
+    std::wcout << L"Network events:  " << events.size() << L" (" << reflected << L" reflected, " << unreflected << L" superseded)" << std::endl;
+    std::wcout << L"Reflect latency: avg " << (reflected ? reflect_total / reflected : 0) << L" ms, max " << reflect_max << L" ms" << std::endl;
+    std::wcout << L"Final text:      " << item.GetItemValueText() << std::endl;
+
+    bool pass = true;
+    if (cfg.max_requests >= 0 && (long long)replay.RequestCount() > cfg.max_requests) {
+        std::wcout << L"FAIL: requests " << replay.RequestCount() << L" > " << cfg.max_requests << std::endl;
+        pass = false;
+    }
+    if (cfg.max_changes >= 0 && (long long)changes > cfg.max_changes) {
+        std::wcout << L"FAIL: display changes " << changes << L" > " << cfg.max_changes << std::endl;
+        pass = false;
+    }
+    if (cfg.max_reflect_ms >= 0 && reflect_max > cfg.max_reflect_ms) {
+        std::wcout << L"FAIL: reflect latency " << reflect_max << L" ms > " << cfg.max_reflect_ms << L" ms" << std::endl;
+        pass = false;
+    }
+    return pass ? 0 : 1;
+}
+
+int Usage() {
+    std::wcerr << L"usage: replay_fixture record <file> [--seconds N]\n"
+        L"       replay_fixture replay <file> [--tick-ms N] [--ipv6] [--max-requests N] [--max-changes N] [--max-reflect-ms N]"
+        << std::endl;
+    return 2;
+}
+
+} // namespace
+
+int wmain(int argc, wchar_t** argv) {
+    if (argc < 3) return Usage();
+    const std::wstring mode = argv[1];
+    const std::wstring path = argv[2];
+
+    if (mode == L"record") {
+        int seconds = 600;
+        for (int i = 3; i < argc; ++i) {
+            if (std::wstring(argv[i]) == L"--seconds" && i + 1 < argc) seconds = _wtoi(argv[++i]);
+            else return Usage();
+        }
+        return Record(path, seconds);
+    }
+    if (mode == L"replay") {
+        ReplayConfig cfg;
+        for (int i = 3; i < argc; ++i) {
+            const std::wstring arg = argv[i];
+            const bool has_value = i + 1 < argc;
+            if (arg == L"--ipv6") cfg.ipv6 = true;
+            else if (arg == L"--tick-ms" && has_value) cfg.tick_ms = _wtoi64(argv[++i]);
+            else if (arg == L"--max-requests" && has_value) cfg.max_requests = _wtoi64(argv[++i]);
+            else if (arg == L"--max-changes" && has_value) cfg.max_changes = _wtoi64(argv[++i]);
+            else if (arg == L"--max-reflect-ms" && has_value) cfg.max_reflect_ms = _wtoi64(argv[++i]);
+            else return Usage();
+        }
+        if (cfg.tick_ms <= 0) return Usage();
+        return Replay(path, cfg);
+    }
+    return Usage();
+}
@@ -0,0 +1,267 @@
+﻿/**
+ * @file adapter_inventory.cpp
+ * @brief 网络适配器清单服务实现
+ * @author Lynn
+ * @date 2025
+ */
+
+#include "adapter_inventory.h"
+#include "ipv6.h"
+#include "metrics.h"
+#include "module_state.h"
+
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+
+#include <windows.h>
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <iphlpapi.h>
+#include <netioapi.h>
+
+#include <cstring>
+
+#pragma comment(lib, "Iphlpapi.lib")
+#pragma comment(lib, "Ws2_32.lib")
+
+namespace iputils {
+
+namespace {
+
+VOID NETIOAPI_API_ OnInterfaceChange(PVOID context, PMIB_IPINTERFACE_ROW, MIB_NOTIFICATION_TYPE) {
+    static_cast<AdapterInventory*>(context)->Invalidate();
+}
+
+VOID NETIOAPI_API_ OnRouteChange(PVOID context, PMIB_IPFORWARD_ROW2, MIB_NOTIFICATION_TYPE) {
+    static_cast<AdapterInventory*>(context)->Invalidate();
+}
+
+VOID NETIOAPI_API_ OnAddressChange(PVOID context, PMIB_UNICASTIPADDRESS_ROW, MIB_NOTIFICATION_TYPE) {
+    static_cast<AdapterInventory*>(context)->Invalidate();
+}
+
+/**
+ * @brief 多字节（UTF-8）字符串转宽字符串
+ */
+std::wstring Utf8ToWide(const char* s) {
+    if (!s) return L"";
+    int len = MultiByteToWideChar(CP_UTF8, 0, s, -1, nullptr, 0);
+    if (len <= 1) return L"";
+    std::wstring r(len - 1, L'\0');
+    MultiByteToWideChar(CP_UTF8, 0, s, -1, &r[0], len);
+    return r;
+}
+
+/**
+ * @brief 把系统的套接字地址转换为AdapterAddress（只填充地址和文本）
+ */
+bool ConvertPlainAddress(const SOCKET_ADDRESS& sock_addr, AdapterAddress& out) {
+    const sockaddr* sa = sock_addr.lpSockaddr;
+    if (!sa) return false;
+    wchar_t buf[kIpv6TextSize] = {};
+    if (sa->sa_family == AF_INET) {
+        const auto* sin = reinterpret_cast<const sockaddr_in*>(sa);
+        out.family = AF_INET;
+        std::memcpy(out.bytes, &sin->sin_addr, 4);
+        if (InetNtopW(AF_INET, &sin->sin_addr, buf, INET_ADDRSTRLEN)) out.text = buf;
+        return true;
+    }
+    if (sa->sa_family == AF_INET6) {
+        Ipv6Address addr;
+        std::memcpy(addr.bytes, &reinterpret_cast<const sockaddr_in6*>(sa)->sin6_addr, 16);
+        out.family = AF_INET6;
+        std::memcpy(out.bytes, addr.bytes, 16);
+        FormatIPv6(addr, buf);
+        out.text = buf;
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @brief 把系统的单播地址项转换为AdapterAddress
+ * @return false表示地址族不支持
+ */
+bool ConvertAddress(const IP_ADAPTER_UNICAST_ADDRESS* ua, AdapterAddress& out) {
+    if (!ConvertPlainAddress(ua->Address, out)) return false;
+    out.prefix_len = ua->OnLinkPrefixLength;
+    out.deprecated = ua->DadState == IpDadStateDeprecated;
+    out.temporary = ua->SuffixOrigin == IpSuffixOriginRandom;
+    return true;
+}
+
+/**
+ * @brief 64位FNV-1a哈希
+ */
+class Fnv1a64 {
+public:
+    void Add(const void* data, size_t len) {
+        const auto* p = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < len; ++i) {
+            hash_ ^= p[i];
+            hash_ *= 1099511628211ULL;
+        }
+    }
+    template <typename T>
+    void AddValue(const T& v) { Add(&v, sizeof(v)); }
+    void AddAddress(const AdapterAddress& a) {
+        AddValue(a.family);
+        Add(a.bytes, a.family == AF_INET ? 4 : 16);
+    }
+    unsigned long long Value() const { return hash_; }
+
+private:
+    unsigned long long hash_ = 14695981039346656037ULL;
+};
+
+/**
+ * @brief 把首选适配器名称解析为快照中的下标
+ */
+void ResolvePreferred(AdapterSnapshot& snapshot, const std::wstring& name) {
+    snapshot.preferred_name = name;
+    const AdapterEntry* a = snapshot.FindByName(name);
+    snapshot.preferred_index = a ? static_cast<size_t>(a - snapshot.adapters.data()) : AdapterSnapshot::npos;
+}
+
+} // namespace
+
+unsigned long long ComputeFingerprint(const AdapterSnapshot& snapshot) {
+    Fnv1a64 h;
+    for (const auto& a : snapshot.adapters) {
+        if (!a.is_up) continue;
+        h.AddValue(a.luid);
+        // 每一组前写入分隔标记，避免地址在组之间移动时哈希不变
+        h.AddValue('A');
+        for (const auto& addr : a.addresses) {
+            if (addr.temporary) continue;
+            h.AddAddress(addr);
+            h.AddValue(addr.prefix_len);
+        }
+        h.AddValue('G');
+        for (const auto& gw : a.gateways) h.AddAddress(gw);
+        h.AddValue('D');
+        for (const auto& dns : a.dns_servers) h.AddAddress(dns);
+    }
+    return h.Value();
+}
+
+std::wstring AdapterEntry::DisplayName() const {
+    std::wstring name = friendly_name.empty() ? adapter_name : friendly_name;
+    if (name.empty()) return name;
+    name += is_up ? L" (已连接)" : L" (已断开)";
+    return name;
+}
+
+const AdapterEntry* AdapterSnapshot::FindByLuid(unsigned long long luid) const {
+    for (const auto& a : adapters) {
+        if (a.luid == luid) return &a;
+    }
+    return nullptr;
+}
+
+const AdapterEntry* AdapterSnapshot::FindByName(const std::wstring& name) const {
+    if (name.empty()) return nullptr;
+    // 优先匹配友好名称，然后匹配适配器名称
+    for (const auto& a : adapters) {
+        if (a.friendly_name == name) return &a;
+    }
+    for (const auto& a : adapters) {
+        if (a.adapter_name == name) return &a;
+    }
+    return nullptr;
+}
+
+AdapterInventory::AdapterInventory() {
+    PinModule();  // 通知回调在系统线程上运行本模块的代码
+    HANDLE h = nullptr;
+    if (NotifyIpInterfaceChange(AF_UNSPEC, OnInterfaceChange, this, FALSE, &h) == NO_ERROR) interface_notify_ = h;
+    h = nullptr;
+    if (NotifyUnicastIpAddressChange(AF_UNSPEC, OnAddressChange, this, FALSE, &h) == NO_ERROR) address_notify_ = h;
+    h = nullptr;
+    if (NotifyRouteChange2(AF_UNSPEC, OnRouteChange, this, FALSE, &h) == NO_ERROR) route_notify_ = h;
+}
+
+AdapterInventory::~AdapterInventory() {
+    // 模块卸载时持有加载器锁，CancelMibChangeNotify2会等待回调线程，可能死锁；进程正在退出，不再取消
+    if (IsModuleDetaching()) return;
+    if (interface_notify_) CancelMibChangeNotify2(static_cast<HANDLE>(interface_notify_));
+    if (address_notify_) CancelMibChangeNotify2(static_cast<HANDLE>(address_notify_));
+    if (route_notify_) CancelMibChangeNotify2(static_cast<HANDLE>(route_notify_));
+}
+
+std::shared_ptr<const AdapterSnapshot> AdapterInventory::Get() {
+    std::lock_guard<std::mutex> lk(mtx_);
+    const unsigned long gen = generation_.load();
+    // 注册通知失败时无法得知变化，每次都重新枚举
+    if (!cached_ || gen != cached_generation_ || !interface_notify_ || !address_notify_ || !route_notify_) {
+        auto snapshot = Query(cached_ ? cached_->version + 1 : 1);
+        ResolvePreferred(*snapshot, preferred_name_);
+        cached_ = std::move(snapshot);
+        cached_generation_ = gen;
+    }
+    return cached_;
+}
+
+void AdapterInventory::SetPreferred(const std::wstring& name) {
+    std::lock_guard<std::mutex> lk(mtx_);
+    if (name == preferred_name_) return;
+    preferred_name_ = name;
+    if (!cached_) return;  // 尚未枚举，首次Get时解析
+
+    // 适配器表不变，只复制快照并重新解析下标
+    auto snapshot = std::make_shared<AdapterSnapshot>(*cached_);
+    snapshot->version = cached_->version + 1;
+    ResolvePreferred(*snapshot, preferred_name_);
+    cached_ = std::move(snapshot);
+}
+
+std::shared_ptr<AdapterSnapshot> AdapterInventory::Query(unsigned long version) const {
+    metrics::Global().adapter_enumerations.Add();
+    auto snapshot = std::make_shared<AdapterSnapshot>();
+    snapshot->version = version;
+
+    const ULONG flags = GAA_FLAG_INCLUDE_PREFIX | GAA_FLAG_INCLUDE_GATEWAYS | GAA_FLAG_SKIP_ANYCAST | GAA_FLAG_SKIP_MULTICAST;
+    ULONG size = 15 * 1024;
+    std::vector<BYTE> buffer(size);
+    auto addrs = reinterpret_cast<IP_ADAPTER_ADDRESSES*>(buffer.data());
+    ULONG ret = GetAdaptersAddresses(AF_UNSPEC, flags, nullptr, addrs, &size);
+    if (ret == ERROR_BUFFER_OVERFLOW) {
+        buffer.resize(size);
+        addrs = reinterpret_cast<IP_ADAPTER_ADDRESSES*>(buffer.data());
+        ret = GetAdaptersAddresses(AF_UNSPEC, flags, nullptr, addrs, &size);
+    }
+    if (ret != NO_ERROR) return snapshot;
+
+    for (auto a = addrs; a; a = a->Next) {
+        if (a->IfType == IF_TYPE_SOFTWARE_LOOPBACK) continue;
+
+        AdapterEntry entry;
+        entry.luid = a->Luid.Value;
+        entry.if_index = a->IfIndex ? a->IfIndex : a->Ipv6IfIndex;
+        entry.if_type = a->IfType;
+        entry.is_up = a->OperStatus == IfOperStatusUp;
+        entry.friendly_name = a->FriendlyName ? a->FriendlyName : L"";
+        entry.adapter_name = Utf8ToWide(a->AdapterName);
+        for (auto ua = a->FirstUnicastAddress; ua; ua = ua->Next) {
+            AdapterAddress addr;
+            if (ConvertAddress(ua, addr)) entry.addresses.push_back(std::move(addr));
+        }
+        for (auto gw = a->FirstGatewayAddress; gw; gw = gw->Next) {
+            AdapterAddress addr;
+            if (ConvertPlainAddress(gw->Address, addr)) entry.gateways.push_back(std::move(addr));
+        }
+        for (auto dns = a->FirstDnsServerAddress; dns; dns = dns->Next) {
+            AdapterAddress addr;
+            if (ConvertPlainAddress(dns->Address, addr)) entry.dns_servers.push_back(std::move(addr));
+        }
+        snapshot->adapters.push_back(std::move(entry));
+    }
+    snapshot->fingerprint = ComputeFingerprint(*snapshot);
+    return snapshot;
+}
+
+} // namespace iputils
@@ -0,0 +1,130 @@
+﻿/**
+ * @file adapter_inventory.h
+ * @brief 网络适配器清单服务
+ * @details 在内存中维护一份带版本号的适配器表，由接口和地址变化通知驱动失效，
+ *          运行时的内网IP选择、出口探测和选项对话框共享同一份快照，
+ *          网络没有变化时读取快照不产生任何系统调用
+ * @author Lynn
+ * @date 2025
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+
+namespace iputils {
+
+/**
+ * @brief 适配器上的单播地址
+ */
+struct AdapterAddress {
+    int family = 0;                 ///< AF_INET或AF_INET6
+    unsigned char bytes[16] = {};   ///< 网络字节序地址（IPv4只使用前4字节）
+    unsigned char prefix_len = 0;   ///< 前缀长度
+    bool deprecated = false;        ///< 已弃用（首选生存期已过）
+    bool temporary = false;         ///< 临时（隐私扩展）地址
+    std::wstring text;              ///< 格式化后的地址字符串（构建快照时生成一次）
+};
+
+/**
+ * @brief 单个适配器
+ */
+struct AdapterEntry {
+    unsigned long long luid = 0;            ///< 接口LUID（稳定标识）
+    unsigned long if_index = 0;             ///< 接口索引
+    unsigned long if_type = 0;              ///< 接口类型（IF_TYPE_*）
+    bool is_up = false;                     ///< 是否处于连接状态
+    std::wstring friendly_name;             ///< 友好名称（如"以太网"、"Wi-Fi"）
+    std::wstring adapter_name;              ///< 适配器名称（GUID字符串，构建快照时转换一次）
+    std::vector<AdapterAddress> addresses;  ///< 单播地址（IPv4和IPv6）
+    std::vector<AdapterAddress> gateways;   ///< 默认网关（只填充family、bytes和text）
+    std::vector<AdapterAddress> dns_servers;///< DNS服务器（只填充family、bytes和text）
+
+    /// 选项对话框中的显示名称："友好名称 (状态)"
+    std::wstring DisplayName() const;
+};
+
+/**
+ * @brief 适配器表快照（构建后不再修改，可跨线程共享）
+ */
+struct AdapterSnapshot {
+    static constexpr size_t npos = static_cast<size_t>(-1);
+
+    unsigned long version = 0;          ///< 快照版本号，每次重建或首选适配器变化时加一
+    unsigned long long fingerprint = 0; ///< 网络指纹（见ComputeFingerprint），不受首选适配器影响
+    std::vector<AdapterEntry> adapters; ///< 非回环适配器，顺序与系统枚举顺序一致
+    std::wstring preferred_name;        ///< 配置的首选适配器名称（空表示自动选择）
+    size_t preferred_index = npos;      ///< 首选适配器在adapters中的下标（构建快照时解析，未找到为npos）
+
+    /// 是否配置了首选适配器
+    bool HasPreferred() const { return !preferred_name.empty(); }
+    /// 已解析的首选适配器，未配置或不存在时返回nullptr
+    const AdapterEntry* Preferred() const {
+        return preferred_index < adapters.size() ? &adapters[preferred_index] : nullptr;
+    }
+
+    /// 按LUID查找适配器，未找到返回nullptr
+    const AdapterEntry* FindByLuid(unsigned long long luid) const;
+    /// 按友好名称或适配器名称查找适配器，未找到返回nullptr
+    const AdapterEntry* FindByName(const std::wstring& name) const;
+};
+
+/**
+ * @brief 计算适配器表的64位网络指纹
+ * @details 对所有活动适配器的LUID、单播地址及前缀长度、网关和DNS服务器做FNV-1a哈希。
+ *          换了Wi-Fi网络（即使DHCP分到相同地址）、网关或DNS变化都会改变指纹；
+ *          临时IPv6地址会定期轮换且不代表网络变化，不参与计算
+ */
+unsigned long long ComputeFingerprint(const AdapterSnapshot& snapshot);
+
+/**
+ * @brief 适配器清单
+ * @details 注册NotifyIpInterfaceChange、NotifyUnicastIpAddressChange和NotifyRouteChange2（IPv4和IPv6），
+ *          收到通知时只递增代数；下一次Get发现代数变化才重新枚举适配器，
+ *          并在重建时把首选适配器名称解析为下标
+ */
+class AdapterInventory {
+public:
+    AdapterInventory();
+    ~AdapterInventory();
+
+    AdapterInventory(const AdapterInventory&) = delete;
+    AdapterInventory& operator=(const AdapterInventory&) = delete;
+
+    /**
+     * @brief 获取当前适配器表快照
+     * @details 缓存有效时只比较一次代数并复制一个shared_ptr
+     */
+    std::shared_ptr<const AdapterSnapshot> Get();
+
+    /**
+     * @brief 设置首选适配器
+     * @param name 友好名称或适配器名称（空表示自动选择）
+     * @details 只在名称变化时重新解析一次，之后每次Get直接使用快照中的下标；
+     *          适配器表重建时按当前名称重新解析
+     */
+    void SetPreferred(const std::wstring& name);
+
+    /**
+     * @brief 使缓存失效（由变化通知回调调用）
+     */
+    void Invalidate() { generation_++; }
+
+private:
+    std::shared_ptr<AdapterSnapshot> Query(unsigned long version) const;
+
+    std::atomic<unsigned long> generation_{ 1 };  ///< 每次变化通知加一
+    std::mutex mtx_;
+    unsigned long cached_generation_ = 0;          ///< cached_对应的代数
+    std::shared_ptr<const AdapterSnapshot> cached_;
+    std::wstring preferred_name_;                  ///< 首选适配器名称
+    void* interface_notify_ = nullptr;             ///< NotifyIpInterfaceChange句柄
+    void* address_notify_ = nullptr;               ///< NotifyUnicastIpAddressChange句柄
+    void* route_notify_ = nullptr;                 ///< NotifyRouteChange2句柄（网关变化）
+};
+
+} // namespace iputils
@@ -0,0 +1,131 @@
+﻿/**
+ * @file config_watcher.cpp
+ * @brief 配置文件变化监视实现
+ * @author Lynn
+ * @date 2025
+ */
+
+#include "config_watcher.h"
+#include "module_state.h"
+
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+
+#include <windows.h>
+#include <chrono>
+
+bool ConfigWatcher::Start(const std::wstring& dir, const std::wstring& file_name) {
+    if (worker_.joinable() || dir.empty() || file_name.empty()) return false;
+
+    HANDLE handle = ::CreateFileW(dir.c_str(), FILE_LIST_DIRECTORY,
+                                  FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING,
+                                  FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, nullptr);
+    if (handle == INVALID_HANDLE_VALUE) return false;
+    HANDLE stop = ::CreateEventW(nullptr, TRUE, FALSE, nullptr);
+    if (!stop) {
+        ::CloseHandle(handle);
+        return false;
+    }
+
+    dir_handle_ = handle;
+    stop_event_ = stop;
+    file_name_ = file_name;
+    iputils::PinModule();
+    worker_ = std::thread(&ConfigWatcher::Run, this);
+    return true;
+}
+
+void ConfigWatcher::Stop() {
+    if (stop_event_) ::SetEvent(static_cast<HANDLE>(stop_event_));
+    // 正常停止时监视线程在停止事件置位后取消未完成的目录读取并退出，等待它结束后再关闭句柄。
+    // 插件卸载期间析构时持有加载器锁，join会死锁，只分离线程并把两个句柄留给进程退出时回收，
+    // 避免在线程可能仍在等待它们时关闭
+    if (worker_.joinable() && iputils::IsModuleDetaching()) {
+        worker_.detach();
+        dir_handle_ = nullptr;
+        stop_event_ = nullptr;
+        return;
+    }
+    if (worker_.joinable()) worker_.join();
+    if (dir_handle_) ::CloseHandle(static_cast<HANDLE>(dir_handle_));
+    if (stop_event_) ::CloseHandle(static_cast<HANDLE>(stop_event_));
+    dir_handle_ = nullptr;
+    stop_event_ = nullptr;
+}
+
+bool ConfigWatcher::Matches(const void* buffer, unsigned long bytes) const {
+    // 缓冲区溢出时系统不返回具体文件，按变化处理
+    if (bytes == 0) return true;
+    const auto* p = static_cast<const BYTE*>(buffer);
+    for (;;) {
+        const auto* info = reinterpret_cast<const FILE_NOTIFY_INFORMATION*>(p);
+        // 写入临时文件后替换原文件时，报告为RENAMED_NEW_NAME
+        if (info->Action != FILE_ACTION_REMOVED && info->Action != FILE_ACTION_RENAMED_OLD_NAME
+            && ::CompareStringOrdinal(info->FileName, static_cast<int>(info->FileNameLength / sizeof(wchar_t)),
+                                      file_name_.c_str(), static_cast<int>(file_name_.size()), TRUE) == CSTR_EQUAL) {
+            return true;
+        }
+        if (info->NextEntryOffset == 0) return false;
+        p += info->NextEntryOffset;
+    }
+}
+
+void ConfigWatcher::Run() {
+    HANDLE dir = static_cast<HANDLE>(dir_handle_);
+    HANDLE done = ::CreateEventW(nullptr, TRUE, FALSE, nullptr);
+    if (!done) return;
+
+    alignas(DWORD) BYTE buffer[4096];
+    OVERLAPPED ov{};
+    ov.hEvent = done;
+    const DWORD filter = FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_SIZE;
+
+    bool reading = false;
+    bool debouncing = false;
+    std::chrono::steady_clock::time_point due{};
+
+    for (;;) {
+        if (!reading) {
+            ::ResetEvent(done);
+            if (!::ReadDirectoryChangesW(dir, buffer, sizeof(buffer), FALSE, filter, nullptr, &ov, nullptr)) break;
+            reading = true;
+        }
+
+        // 没有待报告的变化时无限等待，不轮询
+        DWORD timeout = INFINITE;
+        if (debouncing) {
+            const auto left = std::chrono::duration_cast<std::chrono::milliseconds>(due - std::chrono::steady_clock::now());
+            timeout = left.count() > 0 ? static_cast<DWORD>(left.count()) : 0;
+        }
+
+        HANDLE handles[2] = { static_cast<HANDLE>(stop_event_), done };
+        const DWORD r = ::WaitForMultipleObjects(2, handles, FALSE, timeout);
+        if (r == WAIT_OBJECT_0 + 1) {
+            DWORD bytes = 0;
+            reading = false;
+            if (!::GetOverlappedResult(dir, &ov, &bytes, FALSE)) break;
+            if (Matches(buffer, bytes)) {
+                // 编辑器保存和管理工具下发通常产生一连串通知，推迟到最后一次之后再报告
+                debouncing = true;
+                due = std::chrono::steady_clock::now() + std::chrono::milliseconds(kDebounceMs);
+            }
+        } else if (r == WAIT_TIMEOUT) {
+            debouncing = false;
+            changed_ = true;
+            ++changes_;
+        } else {
+            break;  // 停止事件或等待失败
+        }
+    }
+
+    if (reading) {
+        ::CancelIo(dir);
+        DWORD bytes = 0;
+        ::GetOverlappedResult(dir, &ov, &bytes, TRUE);
+    }
+    ::CloseHandle(done);
+}
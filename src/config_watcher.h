@@ -0,0 +1,67 @@
+﻿/**
+ * @file config_watcher.h
+ * @brief 配置文件变化监视
+ * @details 在后台线程上用ReadDirectoryChangesW监视配置目录，不轮询文件；
+ *          配置文件被修改、创建或替换后经过去抖延迟才报告一次变化，
+ *          由UI线程在下一次DataRequired开始时取走并重新加载
+ * @author Lynn
+ * @date 2025
+ */
+
+#pragma once
+
+#include <string>
+#include <thread>
+#include <atomic>
+
+/**
+ * @brief 配置文件监视器
+ */
+class ConfigWatcher {
+public:
+    /// 去抖延迟（毫秒）：最后一次变化通知后经过该时间才报告变化
+    static constexpr int kDebounceMs = 300;
+
+    ConfigWatcher() = default;
+    ~ConfigWatcher() { Stop(); }
+
+    ConfigWatcher(const ConfigWatcher&) = delete;
+    ConfigWatcher& operator=(const ConfigWatcher&) = delete;
+
+    /**
+     * @brief 开始监视
+     * @param dir 配置文件所在目录
+     * @param file_name 配置文件名（不含路径，比较时不区分大小写）
+     * @return false表示目录无法打开或已在监视
+     */
+    bool Start(const std::wstring& dir, const std::wstring& file_name);
+
+    /**
+     * @brief 停止监视并等待后台线程退出
+     */
+    void Stop();
+
+    /**
+     * @brief 取走变化标志
+     * @return 自上次调用以来配置文件是否变化过（已去抖）
+     */
+    bool TakeChange() { return changed_.exchange(false); }
+
+    /// 已报告的变化次数
+    unsigned long long ChangeCount() const { return changes_.load(); }
+
+private:
+    void Run();
+
+    /**
+     * @brief 检查一批变化通知中是否包含配置文件
+     */
+    bool Matches(const void* buffer, unsigned long bytes) const;
+
+    std::thread worker_;
+    void* dir_handle_ = nullptr;   ///< 配置目录句柄（重叠I/O）
+    void* stop_event_ = nullptr;   ///< 停止事件
+    std::wstring file_name_;       ///< 配置文件名
+    std::atomic<bool> changed_{ false };
+    std::atomic<unsigned long long> changes_{ 0 };
+};
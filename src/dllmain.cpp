@@ -1,4 +1,5 @@
 ﻿#include <windows.h>
+#include "module_state.h"
 
 // Module handle used for resource loading
 HINSTANCE g_hInst = nullptr;
@@ -10,7 +11,10 @@ BOOL APIENTRY DllMain(HMODULE hModule, DWORD ul_reason_for_call, LPVOID /*lpRese
         break;
     case DLL_THREAD_ATTACH:
     case DLL_THREAD_DETACH:
+        break;
     case DLL_PROCESS_DETACH:
+        // 随后运行的静态析构函数持有加载器锁，不能再等待工作线程
+        iputils::MarkModuleDetaching();
         break;
     }
     return TRUE;
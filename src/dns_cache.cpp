@@ -0,0 +1,139 @@
+﻿/**
+ * @file dns_cache.cpp
+ * @brief 外网查询服务器的DNS解析缓存实现
+ * @details 通过DnsQuery_W查询A和AAAA记录以获得TTL，
+ *          DnsQuery经过系统DNS客户端服务，因此预取同时也刷新了系统缓存
+ * @author Lynn
+ * @date 2025
+ */
+
+#include "dns_cache.h"
+#include "metrics.h"
+
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+
+#include <windows.h>
+#include <winsock2.h>
+#include <windns.h>    // DnsQuery_W
+
+#include <algorithm>
+#include <cstring>
+
+#pragma comment(lib, "Dnsapi.lib")
+
+namespace iputils {
+
+namespace {
+
+/**
+ * @brief 查询一种记录类型，追加地址并更新最小TTL
+ */
+void QueryType(const std::wstring& host, WORD type,
+               std::vector<ResolvedAddress>& out, DWORD& min_ttl) {
+    PDNS_RECORD records = nullptr;
+    metrics::Global().dns_queries.Add();
+    if (DnsQuery_W(host.c_str(), type, DNS_QUERY_STANDARD, nullptr, &records, nullptr) != 0) {
+        return;
+    }
+    for (PDNS_RECORD r = records; r; r = r->pNext) {
+        // 应答中可能包含CNAME链，只取目标类型的记录
+        if (r->wType != type || r->Flags.S.Section != DnsSectionAnswer) continue;
+        ResolvedAddress addr;
+        if (type == DNS_TYPE_A) {
+            addr.family = AF_INET;
+            std::memcpy(addr.bytes, &r->Data.A.IpAddress, 4);
+        } else {
+            addr.family = AF_INET6;
+            std::memcpy(addr.bytes, &r->Data.AAAA.Ip6Address, 16);
+        }
+        out.push_back(addr);
+        min_ttl = std::min(min_ttl, r->dwTtl);
+    }
+    DnsRecordListFree(records, DnsFreeRecordList);
+}
+
+/**
+ * @brief 通过系统DNS客户端查询AAAA和A记录
+ */
+bool SystemResolve(const std::wstring& host, std::vector<ResolvedAddress>& out, std::chrono::seconds& ttl) {
+    std::vector<ResolvedAddress> v6, v4;
+    DWORD min_ttl = MAXDWORD;
+    QueryType(host, DNS_TYPE_AAAA, v6, min_ttl);
+    QueryType(host, DNS_TYPE_A, v4, min_ttl);
+
+    // RFC 8305：按地址族交替排列，IPv6优先
+    out.clear();
+    for (size_t i = 0; i < std::max(v6.size(), v4.size()); ++i) {
+        if (i < v6.size()) out.push_back(v6[i]);
+        if (i < v4.size()) out.push_back(v4[i]);
+    }
+    ttl = std::chrono::seconds(min_ttl);
+    return !out.empty();
+}
+
+} // namespace
+
+bool DnsCache::Query(const std::wstring& host, Entry& out) const {
+    std::chrono::seconds ttl{ 0 };
+    out.addresses.clear();
+    const bool ok = resolver_ ? resolver_(host, out.addresses, ttl) : SystemResolve(host, out.addresses, ttl);
+    if (!ok || out.addresses.empty()) return false;
+
+    auto lifetime = ttl;
+    lifetime = std::max(lifetime, min_ttl);
+    lifetime = std::min(lifetime, max_ttl);
+    out.resolved = Now();
+    out.expires = out.resolved + lifetime;
+    out.used = false;
+    return true;
+}
+
+bool DnsCache::Resolve(const std::wstring& host, Entry& out) {
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        auto it = entries_.find(host);
+        if (it != entries_.end() && Now() < it->second.expires) {
+            it->second.used = true;
+            out = it->second;
+            return true;
+        }
+    }
+
+    Entry fresh;
+    if (!Query(host, fresh)) return false;
+    fresh.used = true;
+
+    std::lock_guard<std::mutex> lk(mtx_);
+    entries_[host] = fresh;
+    out = fresh;
+    return true;
+}
+
+bool DnsCache::NeedsPrefetch(const std::wstring& host) {
+    std::lock_guard<std::mutex> lk(mtx_);
+    auto it = entries_.find(host);
+    if (it == entries_.end() || !it->second.used) return false;
+
+    const auto now = Now();
+    if (now >= it->second.expires) return false;  // 已过期，下次查询时同步解析
+    auto window = (it->second.expires - it->second.resolved) / 10;
+    if (it->second.expires - now > window) return false;
+    it->second.used = false;
+    return true;
+}
+
+bool DnsCache::Prefetch(const std::wstring& host) {
+    Entry fresh;
+    if (!Query(host, fresh)) return false;
+
+    std::lock_guard<std::mutex> lk(mtx_);
+    entries_[host] = fresh;
+    return true;
+}
+
+} // namespace iputils
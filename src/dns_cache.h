@@ -0,0 +1,104 @@
+﻿/**
+ * @file dns_cache.h
+ * @brief 外网查询服务器的DNS解析缓存
+ * @details 按记录TTL缓存A/AAAA解析结果，并在过期前预取，
+ *          使查询时WinHTTP自己的名称解析命中系统DNS缓存。
+ *          HTTPS查询只用缓存的地址数量拆分连接超时，连接仍由WinHTTP自己解析；
+ *          按接口出口探测和往返时延探测直接连接缓存的地址
+ * @author Lynn
+ * @date 2025
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <chrono>
+#include <functional>
+
+namespace iputils {
+
+/**
+ * @brief 解析得到的单个地址（紧凑存储，不依赖Winsock头文件）
+ */
+struct ResolvedAddress {
+    int family = 0;                 ///< AF_INET或AF_INET6
+    unsigned char bytes[16] = {};   ///< 网络字节序地址，IPv4只使用前4字节
+};
+
+/**
+ * @brief 带TTL的DNS解析缓存
+ * @details 线程安全。TTL取记录中最小值，并限制在[min_ttl, max_ttl]范围内
+ */
+class DnsCache {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    /**
+     * @brief 解析函数
+     * @details 输出地址（IPv6和IPv4交替排列）和记录中最小的TTL，返回true表示得到了至少一个地址
+     */
+    using Resolver = std::function<bool(const std::wstring& host, std::vector<ResolvedAddress>& out,
+                                        std::chrono::seconds& ttl)>;
+    /// 时钟（返回steady_clock时间点）
+    using NowFunction = std::function<Clock::time_point()>;
+
+    /**
+     * @brief 缓存条目
+     */
+    struct Entry {
+        std::vector<ResolvedAddress> addresses;  ///< IPv6和IPv4地址（交替排列，便于依次尝试）
+        Clock::time_point resolved{};            ///< 解析时间
+        Clock::time_point expires{};             ///< 过期时间
+        bool used = false;                       ///< 解析后是否被使用过（用于决定是否预取）
+    };
+
+    std::chrono::seconds min_ttl{ 30 };          ///< TTL下限
+    std::chrono::seconds max_ttl{ 3600 };        ///< TTL上限
+
+    /**
+     * @brief 解析主机名，缓存未过期时直接返回缓存结果
+     * @param host 主机名
+     * @param out 输出：解析结果
+     * @return true表示得到了至少一个地址
+     */
+    bool Resolve(const std::wstring& host, Entry& out);
+
+    /**
+     * @brief 判断条目是否需要预取
+     * @return true表示条目被使用过且已进入过期前的预取窗口（剩余TTL不足10%）
+     * @details 返回true时同时清除条目的使用标记，保证每个窗口只预取一次
+     */
+    bool NeedsPrefetch(const std::wstring& host);
+
+    /**
+     * @brief 立即重新解析并更新缓存（在工作线程上调用）
+     */
+    bool Prefetch(const std::wstring& host);
+
+    /**
+     * @brief 替换解析函数
+     * @param resolver 解析函数，为空时使用DnsQuery_W
+     * @details 供测试程序使用本机替身解析器，只能在第一次解析之前调用
+     */
+    void SetResolver(Resolver resolver) { resolver_ = std::move(resolver); }
+
+    /**
+     * @brief 替换计算TTL和预取窗口使用的时钟
+     * @param clock 时钟，为空时使用steady_clock
+     */
+    void SetClock(NowFunction clock) { clock_ = std::move(clock); }
+
+private:
+    bool Query(const std::wstring& host, Entry& out) const;
+    Clock::time_point Now() const { return clock_ ? clock_() : Clock::now(); }
+
+    mutable std::mutex mtx_;
+    std::map<std::wstring, Entry> entries_;
+    Resolver resolver_;         ///< 替换的解析函数（为空时使用DnsQuery_W）
+    NowFunction clock_;         ///< 替换的时钟（为空时使用steady_clock）
+};
+
+} // namespace iputils
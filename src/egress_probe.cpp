@@ -0,0 +1,236 @@
+﻿/**
+ * @file egress_probe.cpp
+ * @brief 按网络接口探测出口IP的实现
+ * @details 每个接口一个非阻塞套接字：bind(源地址) -> connect -> 发送请求 -> 读取到连接关闭，
+ *          用select在同一线程上统一等待，整体截止时间为连接超时加接收超时
+ * @author Lynn
+ * @date 2025
+ */
+
+#include "egress_probe.h"
+
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+
+#include <windows.h>
+#include <winsock2.h>
+#include <ws2tcpip.h>
+
+#include <algorithm>
+#include <cstring>
+
+#pragma comment(lib, "Ws2_32.lib")
+
+namespace iputils {
+
+namespace {
+
+/// 响应大小上限（纯文本IP响应通常不足1KB）
+constexpr size_t kMaxResponseSize = 4 * 1024;
+
+/**
+ * @brief 单个接口的探测状态
+ */
+struct ProbeSlot {
+    SOCKET sock = INVALID_SOCKET;
+    sockaddr_in source{};
+    bool connected = false;     ///< 连接已建立且请求已发送
+    bool done = false;          ///< 已完成（成功或失败）
+    std::string response;       ///< 已接收的原始HTTP响应
+    size_t result_index = 0;    ///< 对应结果表中的位置
+};
+
+/**
+ * @brief 宽字符串转ASCII（主机名和路径只含ASCII字符）
+ */
+std::string ToAscii(const wchar_t* s) {
+    std::string r;
+    for (; s && *s; ++s) r.push_back(static_cast<char>(*s));
+    return r;
+}
+
+/**
+ * @brief 从HTTP响应中取出响应体并校验是否为IP地址
+ * @details 请求使用HTTP/1.0，服务器不会返回分块编码的响应体；
+ *          响应体的第一个词必须能被InetPtonW解析为IPv4或IPv6地址
+ */
+std::wstring ParseEgressIp(const std::string& response) {
+    if (response.compare(0, 9, "HTTP/1.1 ") != 0 && response.compare(0, 9, "HTTP/1.0 ") != 0) return L"";
+    if (response.compare(9, 3, "200") != 0) return L"";
+    size_t body = response.find("\r\n\r\n");
+    if (body == std::string::npos) return L"";
+    body += 4;
+
+    std::wstring ip;
+    for (size_t i = body; i < response.size(); ++i) {
+        char c = response[i];
+        if (c == '\r' || c == '\n' || c == ' ') {
+            if (!ip.empty()) break;
+            continue;
+        }
+        if (ip.size() >= 45) return L"";  // INET6_ADDRSTRLEN - 1
+        ip.push_back(static_cast<wchar_t>(static_cast<unsigned char>(c)));
+    }
+
+    in6_addr buf;
+    if (InetPtonW(AF_INET, ip.c_str(), &buf) != 1 && InetPtonW(AF_INET6, ip.c_str(), &buf) != 1) return L"";
+    return ip;
+}
+
+/**
+ * @brief 从适配器快照中取出所有活动接口的首个IPv4单播地址
+ */
+void CollectSources(const AdapterSnapshot& adapters, std::vector<InterfaceEgress>& table, std::vector<ProbeSlot>& slots) {
+    for (const auto& a : adapters.adapters) {
+        if (!a.is_up) continue;
+        for (const auto& addr : a.addresses) {
+            if (addr.family != AF_INET) continue;
+            uint32_t host = 0;
+            std::memcpy(&host, addr.bytes, 4);
+            host = ntohl(host);
+            if (host == 0 || (host & 0xFF000000) == 0x7F000000) continue;
+            // 169.254.x.x链路本地地址无法访问外网
+            if ((host & 0xFFFF0000) == 0xA9FE0000) continue;
+
+            InterfaceEgress entry;
+            entry.adapter_name = a.friendly_name;
+            entry.source_ip = addr.text;
+
+            ProbeSlot slot;
+            slot.source.sin_family = AF_INET;
+            std::memcpy(&slot.source.sin_addr, addr.bytes, 4);
+            slot.result_index = table.size();
+            table.push_back(entry);
+            slots.push_back(slot);
+            break;  // 每个接口只探测一个源地址
+        }
+    }
+}
+
+void CloseSlot(ProbeSlot& slot) {
+    if (slot.sock != INVALID_SOCKET) closesocket(slot.sock);
+    slot.sock = INVALID_SOCKET;
+    slot.done = true;
+}
+
+} // namespace
+
+std::vector<InterfaceEgress> ProbeEgressPerInterface(const ExternalIpOptions& opt, DnsCache& dns,
+                                                     const AdapterSnapshot& adapters) {
+    std::vector<InterfaceEgress> table;
+    if (!opt.ip_only_path) return table;
+
+    WSADATA wsa;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) return table;
+
+    // 提供商的IPv4地址（出口表只覆盖IPv4接口）
+    sockaddr_in server{};
+    DnsCache::Entry entry;
+    bool have_server = false;
+    if (dns.Resolve(opt.host, entry)) {
+        for (const auto& a : entry.addresses) {
+            if (a.family != AF_INET) continue;
+            server.sin_family = AF_INET;
+            server.sin_port = htons(80);
+            std::memcpy(&server.sin_addr, a.bytes, 4);
+            have_server = true;
+            break;
+        }
+    }
+
+    std::vector<ProbeSlot> slots;
+    if (have_server) CollectSources(adapters, table, slots);
+
+    // HTTP/1.0：响应体直到连接关闭，不需要处理分块传输编码
+    const std::string request = "GET " + ToAscii(opt.ip_only_path) + " HTTP/1.0\r\n"
+        "Host: " + ToAscii(opt.host) + "\r\n"
+        "User-Agent: TrafficMonitorIpPlugin/1.0\r\n"
+        "Accept: text/plain\r\n"
+        "Connection: close\r\n\r\n";
+
+    const auto start = std::chrono::steady_clock::now();
+    const auto deadline = start + std::chrono::milliseconds(opt.connect_timeout_ms + opt.receive_timeout_ms);
+
+    // 发起所有连接
+    for (auto& slot : slots) {
+        slot.sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        if (slot.sock == INVALID_SOCKET) { slot.done = true; continue; }
+        u_long nonblocking = 1;
+        ioctlsocket(slot.sock, FIONBIO, &nonblocking);
+        if (bind(slot.sock, reinterpret_cast<const sockaddr*>(&slot.source), sizeof(slot.source)) != 0) {
+            CloseSlot(slot);
+            continue;
+        }
+        if (connect(slot.sock, reinterpret_cast<const sockaddr*>(&server), sizeof(server)) != 0
+            && WSAGetLastError() != WSAEWOULDBLOCK) {
+            CloseSlot(slot);
+        }
+    }
+
+    // 统一等待所有套接字
+    for (;;) {
+        fd_set readfds, writefds, exceptfds;
+        FD_ZERO(&readfds);
+        FD_ZERO(&writefds);
+        FD_ZERO(&exceptfds);
+        int pending = 0;
+        for (auto& slot : slots) {
+            if (slot.done) continue;
+            if (slot.connected) {
+                FD_SET(slot.sock, &readfds);
+            } else {
+                FD_SET(slot.sock, &writefds);
+                FD_SET(slot.sock, &exceptfds);
+            }
+            if (++pending == FD_SETSIZE) break;
+        }
+        if (pending == 0) break;
+
+        const auto now = std::chrono::steady_clock::now();
+        if (now >= deadline) break;
+        auto remaining = std::chrono::duration_cast<std::chrono::microseconds>(deadline - now).count();
+        timeval tv;
+        tv.tv_sec = static_cast<long>(remaining / 1000000);
+        tv.tv_usec = static_cast<long>(remaining % 1000000);
+        if (select(0, &readfds, &writefds, &exceptfds, &tv) <= 0) break;
+
+        for (auto& slot : slots) {
+            if (slot.done) continue;
+            if (!slot.connected) {
+                if (FD_ISSET(slot.sock, &exceptfds)) {
+                    CloseSlot(slot);  // 连接失败
+                } else if (FD_ISSET(slot.sock, &writefds)) {
+                    // 请求很短，一次send即可写入套接字缓冲区
+                    int sent = send(slot.sock, request.data(), (int)request.size(), 0);
+                    if (sent != (int)request.size()) CloseSlot(slot);
+                    else slot.connected = true;
+                }
+            } else if (FD_ISSET(slot.sock, &readfds)) {
+                char buf[1024];
+                int n = recv(slot.sock, buf, sizeof(buf), 0);
+                if (n > 0 && slot.response.size() + n <= kMaxResponseSize) {
+                    slot.response.append(buf, n);
+                    continue;
+                }
+                // n == 0：服务器关闭连接，响应完整
+                auto& result = table[slot.result_index];
+                if (n == 0) result.egress_ip = ParseEgressIp(slot.response);
+                result.elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    std::chrono::steady_clock::now() - start);
+                CloseSlot(slot);
+            }
+        }
+    }
+
+    for (auto& slot : slots) {
+        if (!slot.done) CloseSlot(slot);
+    }
+    WSACleanup();
+    return table;
+}
+
+} // namespace iputils
@@ -0,0 +1,32 @@
+﻿/**
+ * @file egress_probe.h
+ * @brief 按网络接口探测出口IP（多WAN）
+ * @details 以太网、Wi-Fi和VPN同时在线时，分别绑定每个接口的源地址请求提供商的纯文本IP路径，
+ *          得到每个接口各自的出口IP。所有接口的请求在同一线程上用非阻塞套接字并行完成，
+ *          总耗时约为一次往返
+ * @author Lynn
+ * @date 2025
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include "ip_utils.h"
+#include "dns_cache.h"
+
+namespace iputils {
+
+/**
+ * @brief 并行探测所有活动接口的出口IP
+ * @param opt 外网IP获取选项（使用host、ip_only_path和超时设置）
+ * @param dns 提供商地址解析缓存
+ * @param adapters 适配器清单快照（提供各接口的源地址）
+ * @return 每个活动IPv4接口一项，顺序与系统适配器顺序一致
+ * @details 使用明文HTTP（80端口）请求ip_only_path，以便对每个套接字单独绑定源地址；
+ *          提供商不支持纯文本IP路径时返回空表
+ */
+std::vector<InterfaceEgress> ProbeEgressPerInterface(const ExternalIpOptions& opt, DnsCache& dns,
+                                                     const AdapterSnapshot& adapters);
+
+} // namespace iputils
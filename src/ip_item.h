@@ -24,13 +24,26 @@ public:
      * @brief 构造函数
      * @param opts 插件配置选项
      */
-    explicit IpTextProvider(PluginOptions opts = {}) : options_(std::move(opts)) {}
+    explicit IpTextProvider(PluginOptions opts = {}) : options_(std::move(opts)) {
+        iputils::SetPreferredAdapter(options_.preferred_adapter);
+    }
 
     /**
      * @brief 设置配置选项
      * @param opts 新的配置选项
+     * @details 首选适配器在此解析一次，之后每次刷新直接使用解析结果
+     */
+    void SetOptions(const PluginOptions& opts) {
+        options_ = opts;
+        ++options_version_;
+        iputils::SetPreferredAdapter(options_.preferred_adapter);
+    }
+
+    /**
+     * @brief 获取配置选项版本号
+     * @return 每次SetOptions加一，用于判断显示文本是否需要重建
      */
-    void SetOptions(const PluginOptions& opts) { options_ = opts; }
+    unsigned long OptionsVersion() const { return options_version_; }
     
     /**
      * @brief 获取当前配置选项
@@ -55,7 +68,7 @@ public:
 
         // 获取内网IP（如果启用）
         if (options_.show_internal) {
-            internal = iputils::GetInternalIPv4(options_.preferred_adapter);
+            internal = iputils::GetInternalIPv4();  // 首选适配器已在SetOptions中解析
             if (internal.empty()) {
                 internal = L"N/A";  // 显示获取失败状态，而不是空白
             }
@@ -67,7 +80,7 @@ public:
         if (options_.show_external) {
             iputils::ExternalIpOptions opt;
             opt.min_refresh = options_.external_refresh;  // 使用配置的刷新间隔
-            result = iputils::GetExternalIPv4WithCountry(opt, force_external_refresh);
+            result = iputils::RequestExternalIPv4WithCountry(opt, force_external_refresh);
             if (result.IsValid()) {
                 external = result.GetDisplayString();  // 使用格式化字符串（包含国家代码）
                 company_name = result.GetCompanyName();  // 获取公司名称
@@ -76,6 +89,18 @@ public:
             }
         }
 
+        return FormatText(internal, external, result);
+    }
+
+    /**
+     * @brief 按配置组合显示文本（不获取数据）
+     * @param internal 内网IP（未启用时忽略）
+     * @param external 外网显示字符串（未启用时忽略）
+     * @param result 外网查询结果（用于仅显示外网时的公司名称）
+     * @return 组合后的显示文本
+     */
+    std::wstring FormatText(const std::wstring& internal, const std::wstring& external,
+                            const iputils::IpWithCountry& result) const {
         // 根据配置组合显示文本
         if (options_.show_internal && options_.show_external) {
             // 同时显示内网和外网IP，用分隔符连接
@@ -89,6 +114,7 @@ public:
             // 仅显示外网IP时，如果有公司信息则在内网位置显示，外网位置显示IP
             if (!result.as_name.empty() && external != L"N/A") {
                 // 先尝试使用处理过的公司名称
+                std::wstring company_name = result.GetCompanyName();
                 if (!company_name.empty()) {
                     return company_name + options_.separator + external;
                 }
@@ -104,5 +130,6 @@ public:
 
 private:
     PluginOptions options_{};
+    unsigned long options_version_ = 1;  ///< 配置选项版本号
 };
 
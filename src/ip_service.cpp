@@ -0,0 +1,927 @@
+﻿/**
+ * @file ip_service.cpp
+ * @brief IP地址服务实现
+ * @details 内网IP按默认路由和适配器优先级选择，外网IP按智能缓存策略在工作线程上刷新
+ * @author Lynn
+ * @date 2025
+ */
+
+#include "ip_service.h"
+
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN  // 减少Windows头文件的包含内容，提高编译速度
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX  // 避免Windows.h中定义的min/max宏与std::min/max冲突
+#endif
+
+#include <windows.h>
+#include <winsock2.h>  // Windows套接字API
+#include <ws2tcpip.h>  // TCP/IP辅助函数
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+#include "egress_probe.h"     // 按接口探测出口IP
+#include "metrics.h"          // 运行统计
+
+#pragma comment(lib, "Ws2_32.lib")    // Winsock 2.0库
+
+namespace iputils {
+
+namespace {
+
+/// SetCurrent安装的服务
+std::atomic<IpService*> g_current{ nullptr };
+
+} // namespace
+
+IpService::~IpService() {
+    // 先停止工作线程，避免排队中的查询访问已析构的成员
+    executor_.Stop();
+    if (Installed() == this) SetCurrent(nullptr);
+}
+
+IpService& IpService::Current() {
+    if (IpService* service = g_current.load(std::memory_order_acquire)) return *service;
+    static IpService fallback;  // 未安装服务时（如独立的测试程序）使用
+    return fallback;
+}
+
+IpService* IpService::Installed() {
+    return g_current.load(std::memory_order_acquire);
+}
+
+void IpService::SetCurrent(IpService* service) {
+    g_current.store(service, std::memory_order_release);
+}
+
+/**
+ * @brief 取IPv4地址的主机字节序数值
+ * @details bytes是unsigned char数组，用memcpy读取以避免违反严格别名规则和未对齐访问
+ */
+static uint32_t HostOrderIPv4(const AdapterAddress& a) {
+    uint32_t addr = 0;
+    std::memcpy(&addr, a.bytes, 4);
+    return ntohl(addr);
+}
+
+/**
+ * @brief 检查地址是否为有效的IPv4地址
+ * @param a 适配器地址
+ * @return true表示是有效的IPv4地址，false表示无效
+ * @details 过滤掉非IPv4地址、回环地址(127.0.0.1)和0.0.0.0地址
+ */
+static bool IsValidIPv4(const AdapterAddress& a) {
+    // 检查地址族
+    if (a.family != AF_INET) return false;
+    
+    const uint32_t addr = HostOrderIPv4(a);  // 转换为主机字节序
+    
+    // 排除回环地址 127.0.0.1
+    if (addr == 0x7F000001) return false; 
+    
+    // 排除0.0.0.0地址
+    return addr != 0;
+}
+
+/**
+ * @brief IP地址优先级判断函数，用于选择最合适的内网IP地址
+ * @param a 适配器地址
+ * @return 优先级数值，数值越高优先级越高，0表示无效IP
+ * @details 优先级策略：
+ *          - 192.168.x.x (C类私网地址): 100 - 最高优先级，家用路由器常用
+ *          - 10.x.x.x (A类私网地址): 50 - 中等优先级，企业网络常用
+ *          - 172.16.x.x-172.31.x.x (B类私网地址): 30 - 较低优先级
+ *          - 其他有效IP: 10 - 最低优先级
+ */
+int GetIPPriority(const AdapterAddress& a) {
+    // 检查地址有效性
+    if (!IsValidIPv4(a)) return 0;
+    
+    const uint32_t addr = HostOrderIPv4(a);  // 转换为主机字节序
+    
+    // 192.168.x.x (C类私网地址) - 最高优先级 (家用路由器常用)
+    // 地址范围: 192.168.0.0/16，掩码: 0xFFFF0000 (255.255.0.0)
+    if ((addr & 0xFFFF0000) == 0xC0A80000) return 100;
+    
+    // 10.x.x.x (A类私网地址) - 中等优先级
+    // 地址范围: 10.0.0.0/8，掩码: 0xFF000000 (255.0.0.0)
+    if ((addr & 0xFF000000) == 0x0A000000) return 50;
+    
+    // 172.16.x.x - 172.31.x.x (B类私网地址) - 较低优先级
+    // 地址范围: 172.16.0.0/12，掩码: 0xFFF00000 (255.240.0.0)
+    if ((addr & 0xFFF00000) == 0xAC100000) return 30;
+    
+    // 其他有效IP - 最低优先级
+    return 10;
+}
+
+/**
+ * @brief 从指定适配器中选择优先级最高的IPv4地址
+ * @param a 适配器
+ * @return 优先级最高的IP地址字符串，无有效IP时返回空字符串
+ */
+std::wstring PickIPv4(const AdapterEntry& a) {
+    const std::wstring* best_ip = nullptr;  // 当前找到的最佳IP地址
+    int best_priority = 0;                  // 当前最高优先级
+    for (const auto& addr : a.addresses) {
+        int priority = GetIPPriority(addr);
+        if (priority > best_priority && !addr.text.empty()) {
+            best_ip = &addr.text;
+            best_priority = priority;
+        }
+    }
+    return best_ip ? *best_ip : std::wstring();
+}
+
+/**
+ * @brief 在适配器快照中选择内网IPv4地址
+ * @param snapshot 适配器快照
+ * @param preferred 首选适配器（nullptr表示自动选择或首选适配器不存在）
+ * @return 内网IPv4地址字符串，获取失败返回空字符串
+ */
+std::wstring IpService::SelectInternalIPv4(const AdapterSnapshot& snapshot, const AdapterEntry* preferred) {
+    // 第一步：如果指定了首选适配器，优先从该适配器获取IP
+    if (preferred && preferred->is_up) {
+        auto ip = PickIPv4(*preferred);
+        if (!ip.empty()) return ip;  // 找到有效IP，直接返回
+    }
+
+    // 第二步：指定适配器不可用时，使用默认路由的源地址
+    const auto route = Route();
+    if (route->valid && !route->source_ip.empty()) return route->source_ip;
+
+    // 第三步：Fallback策略 - 没有默认路由（如离线）时从所有活动适配器中选择全局最优IP
+    std::wstring best_global_ip;       // 全局最佳IP地址
+    int best_global_priority = 0;      // 全局最高优先级
+    for (const auto& a : snapshot.adapters) {
+        // 跳过非活动适配器（快照中已不含回环适配器）
+        if (!a.is_up) continue;
+        for (const auto& addr : a.addresses) {
+            int priority = GetIPPriority(addr);
+            // 如果发现更高优先级的IP地址，更新全局最佳选择
+            if (priority > best_global_priority && !addr.text.empty()) {
+                best_global_ip = addr.text;
+                best_global_priority = priority;
+            }
+        }
+    }
+    
+    // 返回全局最优IP地址（可能为空字符串，表示未找到有效IP）
+    return best_global_ip;
+}
+
+/**
+ * @brief 在适配器快照中选择内网IPv6地址
+ * @param snapshot 适配器快照
+ * @param preferred 首选适配器（可为nullptr）
+ * @param opt 选择选项（是否跳过弃用/临时地址）
+ * @return 压缩形式的IPv6地址字符串，获取失败返回空字符串
+ * @details 依次在首选适配器、默认路由出接口、所有活动适配器中选择排序值最高的地址
+ */
+std::wstring IpService::SelectInternalIPv6(const AdapterSnapshot& snapshot, const AdapterEntry* preferred,
+                                           const Ipv6SelectOptions& opt) {
+    // 在满足条件的适配器中选择排序值最高的地址，match为空表示所有活动适配器
+    auto pick = [&](const AdapterEntry* match) -> std::wstring {
+        const AdapterAddress* best = nullptr;
+        int best_rank = 0;
+        for (const auto& a : snapshot.adapters) {
+            if (!a.is_up || (match && &a != match)) continue;
+            for (const auto& addr : a.addresses) {
+                if (addr.family != AF_INET6) continue;
+                Ipv6Candidate c;
+                std::memcpy(c.addr.bytes, addr.bytes, 16);
+                c.deprecated = addr.deprecated;
+                c.temporary = addr.temporary;
+                int rank = RankIPv6(c, opt);
+                if (rank > best_rank) {
+                    best_rank = rank;
+                    best = &addr;
+                }
+            }
+        }
+        return best ? best->text : std::wstring();
+    };
+
+    std::wstring ip;
+    if (preferred) {
+        ip = pick(preferred);
+        if (!ip.empty()) return ip;
+    }
+
+    const auto route = Route();
+    if (route->valid) {
+        if (const AdapterEntry* a = snapshot.FindByLuid(route->luid)) {
+            ip = pick(a);
+            if (!ip.empty()) return ip;
+        }
+    }
+
+    return pick(nullptr);
+}
+
+namespace {
+
+/**
+ * @brief 比较两次查询结果的显示内容是否相同
+ */
+bool SameResult(const IpWithCountry& a, const IpWithCountry& b) {
+    return a.ip == b.ip && a.country == b.country && a.as_name == b.as_name;
+}
+
+/**
+ * @brief 比较两张出口IP表的显示内容是否相同（忽略耗时）
+ */
+bool SameEgressTable(const std::vector<InterfaceEgress>& a, const std::vector<InterfaceEgress>& b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (a[i].adapter_name != b[i].adapter_name || a[i].egress_ip != b[i].egress_ip) return false;
+    }
+    return true;
+}
+
+/// 按网络指纹记住的结果个数上限
+constexpr size_t kMaxRememberedNetworks = 8;
+
+/**
+ * @brief 记住某个网络下的查询结果（调用方持有mtx）
+ */
+void RememberForNetwork(ExternalCacheState& s, unsigned long long fingerprint, const IpWithCountry& result) {
+    if (fingerprint == 0 || !result.IsValid()) return;
+    for (auto it = s.by_network.begin(); it != s.by_network.end(); ++it) {
+        if (it->first == fingerprint) {
+            s.by_network.erase(it);
+            break;
+        }
+    }
+    s.by_network.insert(s.by_network.begin(), std::make_pair(fingerprint, result));
+    if (s.by_network.size() > kMaxRememberedNetworks) s.by_network.pop_back();
+}
+
+/**
+ * @brief 查找某个网络下记住的结果（调用方持有mtx）
+ * @return 未记住时返回nullptr
+ */
+const IpWithCountry* RecallForNetwork(const ExternalCacheState& s, unsigned long long fingerprint) {
+    for (const auto& entry : s.by_network) {
+        if (entry.first == fingerprint) return &entry.second;
+    }
+    return nullptr;
+}
+
+/// 空闲关闭时间相对标准刷新间隔的余量：计划刷新略有延迟时连接仍可复用
+constexpr std::chrono::seconds kIdleCloseMargin{ 30 };
+
+/// 往返时延探测的超时时间（毫秒），超过时按丢失计
+constexpr unsigned kRttTimeoutMs = 1000;
+
+/**
+ * @brief 把一次探测结果写入窗口（调用方持有mtx）
+ * @details 目标地址变化时（如切换网络）先清空窗口，不同目标的时延不混在一起
+ */
+void RecordRtt(RttWindow& window, std::wstring& current, const std::wstring& target, std::uint32_t ms) {
+    if (target != current) {
+        window.Clear();
+        current = target;
+    }
+    if (!target.empty()) window.Push(ms);
+}
+
+} // namespace
+
+std::shared_ptr<const AdapterSnapshot> IpService::GetAdapterSnapshot() {
+    return Snapshot();
+}
+
+void IpService::SetPreferredAdapter(const std::wstring& preferred_adapter) {
+    if (network_) network_->SetPreferred(preferred_adapter);
+    else adapters_.SetPreferred(preferred_adapter);
+}
+
+/**
+ * @brief 获取内网IPv4地址（使用SetPreferredAdapter设置的首选适配器）
+ * @return 内网IPv4地址字符串，获取失败返回空字符串
+ * @details 首选适配器在适配器表或设置变化时已解析为快照下标，
+ *          每次调用只取一次快照，不做任何字符串转换或比较；
+ *          未设置首选适配器时直接使用默认路由的源地址，路由未变化时不产生系统调用
+ */
+std::wstring IpService::GetInternalIPv4() {
+    auto snapshot = Snapshot();
+    if (!snapshot->HasPreferred()) {
+        const auto route = Route();
+        if (route->valid && !route->source_ip.empty()) return route->source_ip;
+    }
+    return SelectInternalIPv4(*snapshot, snapshot->Preferred());
+}
+
+/**
+ * @brief 获取当前内网IPv4所在接口的名称
+ * @details 首选适配器可用且有IPv4地址时返回其名称，否则返回默认路由出接口的名称
+ */
+std::wstring IpService::GetInternalInterfaceName() {
+    auto snapshot = Snapshot();
+    const AdapterEntry* a = snapshot->Preferred();
+    if (!a || !a->is_up || PickIPv4(*a).empty()) {
+        const auto route = Route();
+        a = route->valid ? snapshot->FindByLuid(route->luid) : nullptr;
+    }
+    if (!a) return L"";
+    return a->friendly_name.empty() ? a->adapter_name : a->friendly_name;
+}
+
+/**
+ * @brief 获取内网IPv4地址，支持优先级选择和指定适配器
+ * @param preferred_adapter 首选网络适配器名称（可为空）
+ * @return 内网IPv4地址字符串，获取失败返回空字符串
+ * @details 功能特性：
+ *          1. 支持指定首选适配器（按FriendlyName或AdapterName匹配）
+ *          2. 自动选择时使用默认路由（跃点数最低）出接口的源地址，
+ *             避免选中Hyper-V/WSL/Docker等虚拟网卡
+ *          3. 没有默认路由时按优先级选择（优先192.168.x.x，然后10.x.x.x，最后172.16-31.x.x）
+ *          4. 自动排除回环地址、无效地址和非活动适配器
+ *          适配器信息来自适配器清单的快照，网络未变化时不枚举适配器
+ */
+std::wstring IpService::GetInternalIPv4(const std::wstring& preferred_adapter) {
+    // 未指定首选适配器时直接使用默认路由的源地址，路由未变化时不产生系统调用
+    if (preferred_adapter.empty()) {
+        const auto route = Route();
+        if (route->valid && !route->source_ip.empty()) return route->source_ip;
+    }
+
+    auto snapshot = Snapshot();
+    return SelectInternalIPv4(*snapshot, snapshot->FindByName(preferred_adapter));
+}
+
+/**
+ * @brief 获取内网IPv6地址（RFC 6724排序）
+ * @param preferred_adapter 首选网络适配器名称（可为空）
+ * @param opt 选择选项（是否跳过弃用/临时地址）
+ * @return 压缩形式的IPv6地址字符串，获取失败返回空字符串
+ */
+std::wstring IpService::GetInternalIPv6(const std::wstring& preferred_adapter, const Ipv6SelectOptions& opt) {
+    auto snapshot = Snapshot();
+    return SelectInternalIPv6(*snapshot, snapshot->FindByName(preferred_adapter), opt);
+}
+
+/**
+ * @brief 获取内网IPv6地址（使用SetPreferredAdapter设置的首选适配器）
+ * @param opt 选择选项（是否跳过弃用/临时地址）
+ * @return 压缩形式的IPv6地址字符串，获取失败返回空字符串
+ */
+std::wstring IpService::GetInternalIPv6(const Ipv6SelectOptions& opt) {
+    auto snapshot = Snapshot();
+    return SelectInternalIPv6(*snapshot, snapshot->Preferred(), opt);
+}
+
+/**
+ * @brief 获取外网IPv4地址和国家信息，支持缓存和强制刷新
+ * @param opt 外网IP获取选项配置
+ * @param force_refresh 是否强制刷新（跳过缓存）
+ * @return IpWithCountry结构，包含IP地址和国家代码，获取失败返回空的结构
+ * @details 先按缓存策略判断，需要查询时在调用线程上同步执行查询流水线
+ */
+IpWithCountry IpService::GetExternalIPv4WithCountry(const ExternalIpOptions& opt, bool force_refresh) {
+    IpWithCountry cached;
+    if (ServeFromCache(opt, force_refresh, &cached)) {
+        return cached;  // 返回缓存的结果
+    }
+    return FetchAndStore(opt, force_refresh);
+}
+
+/**
+ * @brief 获取外网IPv4地址和国家信息（非阻塞）
+ * @param opt 外网IP获取选项配置
+ * @param force_refresh 是否强制刷新（跳过缓存）
+ * @return 当前缓存的结果（可能为空）
+ * @details 需要查询时将查询流水线投递到后台工作线程，本次调用立即返回旧的缓存结果，
+ *          查询完成后的结果在下一次调用时可见。同一时间最多只有一个查询在执行，
+ *          执行期间发生的网络变化或强制刷新会在当前查询完成后再查询一次
+ */
+IpWithCountry IpService::RequestExternalIPv4WithCountry(const ExternalIpOptions& opt, bool force_refresh) {
+    IpWithCountry cached;
+    ScheduleExternalIPv4(opt, force_refresh, &cached);
+    return cached;
+}
+
+/**
+ * @brief 驱动外网IPv4刷新计划，只返回版本号
+ */
+unsigned long IpService::PollExternalIPv4(const ExternalIpOptions& opt, bool force_refresh) {
+    return ScheduleExternalIPv4(opt, force_refresh, nullptr);
+}
+
+/**
+ * @brief 获取外网IPv6地址（非阻塞）
+ * @param opt 外网IP获取选项配置（使用host_v6和ip_only_path）
+ * @return 当前缓存的外网IPv6地址，尚未获取成功时返回空字符串
+ */
+std::wstring IpService::RequestExternalIPv6(const ExternalIpOptions& opt) {
+    std::wstring cached;
+    ScheduleExternalIPv6(opt, &cached);
+    return cached;
+}
+
+/**
+ * @brief 驱动外网IPv6刷新计划，只返回版本号
+ */
+unsigned long IpService::PollExternalIPv6(const ExternalIpOptions& opt) {
+    return ScheduleExternalIPv6(opt, nullptr);
+}
+
+/**
+ * @brief 获取缓存的外网IPv4结果（不触发查询）
+ */
+IpWithCountry IpService::GetCachedExternalIPv4() {
+    auto& s = cache_;
+    std::lock_guard<std::mutex> lk(s.mtx);
+    return s.cached_result;
+}
+
+/**
+ * @brief 获取缓存的外网IPv6地址（不触发查询）
+ */
+std::wstring IpService::GetCachedExternalIPv6() {
+    auto& s = cache_;
+    std::lock_guard<std::mutex> lk(s.mtx);
+    return s.cached_v6;
+}
+
+/**
+ * @brief 获取最近一次成功的外网查询信息（不触发查询）
+ */
+ExternalQueryInfo IpService::GetExternalQueryInfo() {
+    auto& s = cache_;
+    std::lock_guard<std::mutex> lk(s.mtx);
+    ExternalQueryInfo info;
+    info.provider = s.provider;
+    info.fetched_at = s.last_fetch;
+    info.latency = s.last_latency;
+    return info;
+}
+
+/**
+ * @brief 获取网络状态版本号
+ */
+unsigned long IpService::GetNetworkVersion() {
+    return Snapshot()->version;
+}
+
+/**
+ * @brief 获取最近一次按接口探测的出口IP表
+ */
+std::vector<InterfaceEgress> IpService::GetInterfaceEgressTable() {
+    auto& s = cache_;
+    std::lock_guard<std::mutex> lk(s.mtx);
+    return s.egress_table;
+}
+
+/**
+ * @brief 获取外网查询传输层统计
+ */
+TransportStats IpService::GetTransportStats() {
+    return transport_.GetStats();
+}
+
+/**
+ * @brief 获取最近的外网IPv4查询耗时样本（不触发查询）
+ */
+unsigned long long IpService::GetLookupLatencySamples(std::uint32_t* out, size_t max) {
+    const unsigned long long total = lookup_latency_.Total();
+    lookup_latency_.Recent(out, max);
+    return total;
+}
+
+/**
+ * @brief 缓存策略检查
+ * @param opt 外网IP获取选项配置
+ * @param force_refresh 是否强制刷新
+ * @param cached 输出：当前缓存的结果（可为nullptr）
+ * @return true表示可以直接使用缓存结果，false表示需要执行查询
+ */
+bool IpService::ServeFromCache(const ExternalIpOptions& opt, bool force_refresh, IpWithCountry* cached) {
+    auto& s = cache_;
+    const auto now = Now();
+
+    // 网络指纹：适配器、地址、网关或DNS变化时改变，网络未变化时只比较一个整数
+    const unsigned long long fingerprint = Snapshot()->fingerprint;
+
+    std::lock_guard<std::mutex> lk(s.mtx);
+
+    bool network_changed = false;
+    if (s.last_fingerprint != 0 && fingerprint != s.last_fingerprint) {
+        network_changed = true;
+        s.last_change = now;
+        s.last_fetch_v6 = {};  // 网络变化后外网IPv6也需要重新获取
+        s.fast_mode_counter = opt.adaptive_cycles;  // 启动快速模式
+        // 回到之前用过的网络时，先显示该网络上次的结果，查询完成后再更新
+        const IpWithCountry* known = RecallForNetwork(s, fingerprint);
+        if (known && !SameResult(*known, s.cached_result)) {
+            s.cached_result = *known;
+            ++s.version;
+        }
+        s.last_fingerprint = fingerprint;
+    } else if (s.last_fingerprint == 0) {
+        s.last_fingerprint = fingerprint;
+    }
+    if (cached) *cached = s.cached_result;
+
+    // 已有查询在执行时，这次变化或强制刷新不能丢弃：记下来，由正在执行的查询完成后再查询一次
+    if ((force_refresh || network_changed) && s.in_flight) {
+        s.rerun_requested = true;
+        s.rerun_full = s.rerun_full || force_refresh;
+        s.rerun_opt = opt;
+    }
+
+    // 如果强制刷新或网络发生变化，跳过缓存检查
+    if (force_refresh || network_changed) return false;
+    if (!s.cached_result.IsValid() || s.last_fetch.time_since_epoch().count() == 0) return false;
+
+    std::chrono::milliseconds refresh_interval = opt.min_refresh;
+
+    // 根据策略选择刷新间隔
+    switch (opt.strategy) {
+        case CacheStrategy::FIXED:
+            refresh_interval = opt.min_refresh;
+            break;
+
+        case CacheStrategy::ADAPTIVE:
+        case CacheStrategy::HYBRID:
+            if (s.fast_mode_counter > 0) {
+                refresh_interval = opt.fast_refresh;  // 快速模式：30秒
+                s.fast_mode_counter--;
+            } else {
+                // 根据稳定时间逐渐延长间隔
+                auto stable_time = now - s.last_change;
+                if (stable_time > std::chrono::hours(1)) {
+                    refresh_interval = opt.max_refresh;  // 超过1小时稳定：15分钟
+                } else {
+                    refresh_interval = opt.min_refresh;  // 标准间隔：5分钟
+                }
+            }
+            break;
+
+        case CacheStrategy::NETWORK_EVENT:
+            refresh_interval = opt.max_refresh;  // 仅在网络事件时刷新
+            break;
+    }
+
+    s.next_due = s.last_fetch + refresh_interval;
+    return now < s.next_due;
+}
+
+/**
+ * @brief 按刷新计划维护传输连接
+ * @details 距离下一次计划刷新不足prewarm_lead时预热连接（每次计划刷新只预热一次），
+ *          否则关闭空闲超过idle_close的连接。空闲时间不短于min_refresh加余量，
+ *          否则按标准间隔刷新时连接总是已被关闭，无法复用；同一时间最多排队一个关闭任务
+ */
+void IpService::MaintainTransport(const ExternalIpOptions& opt) {
+    if (backend_) return;  // 替换后端时没有需要维护的连接
+    auto& s = cache_;
+    const auto now = Now();
+
+    if (opt.prewarm_lead.count() > 0) {
+        bool prewarm = false;
+        {
+            std::lock_guard<std::mutex> lk(s.mtx);
+            if (!s.in_flight && s.next_due != s.prewarmed_for && now + opt.prewarm_lead >= s.next_due) {
+                s.prewarmed_for = s.next_due;
+                prewarm = true;
+            }
+        }
+        if (prewarm) {
+            executor_.Post([this, opt]() { transport_.Prewarm(opt, dns_); });
+            return;
+        }
+    }
+
+    const auto limit = std::max(opt.idle_close,
+                                std::chrono::duration_cast<std::chrono::milliseconds>(opt.min_refresh + kIdleCloseMargin));
+    if (!transport_.IsIdleFor(limit)) return;
+    {
+        std::lock_guard<std::mutex> lk(s.mtx);
+        if (s.close_pending) return;
+        s.close_pending = true;
+    }
+    bool posted = executor_.Post([this, limit]() {
+        transport_.CloseIfIdle(limit);
+        std::lock_guard<std::mutex> lk(cache_.mtx);
+        cache_.close_pending = false;
+    });
+    if (!posted) {
+        std::lock_guard<std::mutex> lk(s.mtx);
+        s.close_pending = false;
+    }
+}
+
+/**
+ * @brief 通过替换的后端或查询流水线执行一次查询
+ */
+bool IpService::Lookup(LookupContext& ctx, HttpTransport& transport) {
+    const auto started = std::chrono::steady_clock::now();
+    const bool ok = backend_ ? backend_(ctx) : RunLookupPipeline(ctx, transport, dns_);
+
+    auto& m = metrics::Global();
+    auto& provider = m.Provider(ctx.opt.host);
+    provider.lookups.Add();
+    if (!ok) provider.failures.Add();
+    provider.latency.Record(std::chrono::steady_clock::now() - started);
+    m.bytes_received.Add(ctx.body.size());
+    return ok;
+}
+
+/**
+ * @brief 执行查询并在成功时更新缓存
+ * @param opt 外网IP获取选项配置
+ * @param full 是否直接获取完整信息（跳过纯文本IP探测）
+ * @details 已有国家/供应商信息时先请求提供商的纯文本IP路径，
+ *          IP未变化则沿用缓存中的补充信息，只有IP变化时才请求完整JSON
+ */
+IpWithCountry IpService::FetchAndStore(const ExternalIpOptions& opt, bool full) {
+    auto& s = cache_;
+    IpWithCountry previous;
+    unsigned long long fingerprint = 0;  // 查询开始时所在的网络
+    {
+        std::lock_guard<std::mutex> lk(s.mtx);
+        previous = s.cached_result;
+        fingerprint = s.last_fingerprint;
+    }
+
+    IpWithCountry result;
+    std::chrono::milliseconds latency{ 0 };  // 产生最终结果的那次请求的耗时
+    bool enriched = previous.IsValid() && (!previous.country.empty() || !previous.as_name.empty());
+    if (!full && opt.ip_only_path && enriched) {
+        LookupContext probe(opt);
+        probe.ip_only = true;
+        if (Lookup(probe, transport_)) {
+            if (probe.result.ip == previous.ip) {
+                result = previous;
+                latency = probe.elapsed;
+            }
+        } else if (probe.stage <= LookupStage::REQUEST) {
+            metrics::Global().lookups_skipped.Add();
+            lookup_latency_.Push(kFailedSample);
+            return result;  // 网络不可用，不再尝试完整请求
+        }
+    }
+
+    if (!result.IsValid()) {
+        LookupContext ctx(opt);
+        Lookup(ctx, transport_);
+        result = ctx.result;
+        latency = ctx.elapsed;
+    }
+
+    // 产生结果的那次请求的耗时，失败时记为失败样本
+    lookup_latency_.Push(result.IsValid() ? static_cast<std::uint32_t>(latency.count()) : kFailedSample);
+
+    if (result.IsValid()) {
+        std::lock_guard<std::mutex> lk(s.mtx);
+        if (!SameResult(result, s.cached_result)) {
+            s.cached_result = result;
+            ++s.version;
+        }
+        s.last_fetch = Now();
+        s.last_latency = latency;
+        if (opt.host) s.provider = opt.host;
+        // 查询期间网络又变化时，结果不能确定属于哪个网络，不记住
+        if (fingerprint == s.last_fingerprint) RememberForNetwork(s, fingerprint, result);
+    }
+    return result;
+}
+
+/**
+ * @brief 按缓存策略驱动外网IPv4刷新（非阻塞）
+ * @param opt 外网IP获取选项配置
+ * @param force_refresh 是否强制刷新（跳过缓存）
+ * @param cached 输出：当前缓存的结果（可为nullptr）
+ * @return 缓存数据版本号
+ * @details 需要查询时将查询流水线投递到后台工作线程，本次调用立即返回，
+ *          查询完成后的结果在下一次调用时可见。同一时间最多只有一个查询在执行
+ */
+unsigned long IpService::ScheduleExternalIPv4(const ExternalIpOptions& opt, bool force_refresh, IpWithCountry* cached) {
+    auto& s = cache_;
+    auto& m = metrics::Global();
+    if (ServeFromCache(opt, force_refresh, cached)) {
+        m.cache_hits.Add();
+        // 使用缓存期间，在服务器地址的DNS记录过期前预取
+        if (!backend_ && dns_.NeedsPrefetch(opt.host)) {
+            std::wstring host = opt.host;
+            executor_.Post([this, host]() { dns_.Prefetch(host); });
+        }
+        MaintainTransport(opt);
+        std::lock_guard<std::mutex> lk(s.mtx);
+        return s.version;
+    }
+
+    {
+        std::lock_guard<std::mutex> lk(s.mtx);
+        if (s.in_flight) {
+            m.lookups_skipped.Add();
+            return s.version;
+        }
+        s.in_flight = true;
+    }
+    m.cache_misses.Add();
+
+    bool posted = PostExternalIPv4(opt, force_refresh);
+    std::lock_guard<std::mutex> lk(s.mtx);
+    if (!posted) s.in_flight = false;
+    return s.version;
+}
+
+/**
+ * @brief 将一次外网IPv4查询投递到工作线程
+ * @param opt 外网IP获取选项配置
+ * @param full 是否直接获取完整信息
+ * @return 是否投递成功（执行器已停止时失败）
+ * @details 调用前in_flight已置位。查询完成时如果期间有人请求过再次查询，
+ *          in_flight保持置位并立即投递下一次查询，否则清除in_flight
+ */
+bool IpService::PostExternalIPv4(const ExternalIpOptions& opt, bool full) {
+    return executor_.Post([this, opt, full]() {
+        FetchAndStore(opt, full);
+        std::vector<InterfaceEgress> table;
+        if (opt.probe_interfaces && !backend_) table = ProbeEgressPerInterface(opt, dns_, *Snapshot());
+
+        auto& state = cache_;
+        ExternalIpOptions next;
+        bool next_full = false;
+        {
+            std::lock_guard<std::mutex> lk(state.mtx);
+            if (!SameEgressTable(table, state.egress_table)) ++state.version;
+            state.egress_table.swap(table);
+            if (!state.rerun_requested) {
+                state.in_flight = false;
+                return;
+            }
+            next = state.rerun_opt;
+            next_full = state.rerun_full;
+            state.rerun_requested = false;
+            state.rerun_full = false;
+        }
+        if (!PostExternalIPv4(next, next_full)) {
+            std::lock_guard<std::mutex> lk(state.mtx);
+            state.in_flight = false;
+        }
+    });
+}
+
+/**
+ * @brief 按刷新间隔驱动外网IPv6刷新（非阻塞）
+ * @param opt 外网IP获取选项配置（使用host_v6和ip_only_path）
+ * @param cached 输出：当前缓存的外网IPv6地址（可为nullptr）
+ * @return 缓存数据版本号
+ * @details 请求只有AAAA记录的IPv6专用主机，按min_refresh间隔在工作线程上刷新
+ */
+unsigned long IpService::ScheduleExternalIPv6(const ExternalIpOptions& opt, std::wstring* cached) {
+    auto& s = cache_;
+    const auto now = Now();
+    {
+        std::lock_guard<std::mutex> lk(s.mtx);
+        bool fresh = s.last_fetch_v6.time_since_epoch().count() != 0 && now - s.last_fetch_v6 < opt.min_refresh;
+        if (fresh || s.v6_in_flight || !opt.host_v6 || !opt.ip_only_path) {
+            if (cached) *cached = s.cached_v6;
+            return s.version;
+        }
+        s.v6_in_flight = true;
+    }
+
+    ExternalIpOptions v6 = opt;
+    v6.host = opt.host_v6;
+    bool posted = executor_.Post([this, v6]() {
+        LookupContext ctx(v6);
+        ctx.ip_only = true;
+        bool ok = Lookup(ctx, transport_v6_);
+
+        auto& state = cache_;
+        std::lock_guard<std::mutex> lk(state.mtx);
+        // 失败（如没有IPv6外网连接）时同样按刷新间隔重试，避免每次刷新都发起请求
+        std::wstring ip = ok ? ctx.result.ip : std::wstring();
+        if (ip != state.cached_v6) {
+            state.cached_v6.swap(ip);
+            ++state.version;
+        }
+        state.last_fetch_v6 = Now();
+        state.v6_in_flight = false;
+    });
+    std::lock_guard<std::mutex> lk(s.mtx);
+    if (!posted) s.v6_in_flight = false;
+    if (cached) *cached = s.cached_v6;
+    return s.version;
+}
+
+/**
+ * @brief 选择要探测的默认网关
+ * @param snapshot 适配器快照
+ * @return 首选适配器（可用时）或默认路由出接口的IPv4网关，没有时返回nullptr
+ */
+const AdapterAddress* IpService::SelectGateway(const AdapterSnapshot& snapshot) {
+    const AdapterEntry* a = snapshot.Preferred();
+    if (!a || !a->is_up) {
+        const auto route = Route();
+        a = route->valid ? snapshot.FindByLuid(route->luid) : nullptr;
+    }
+    if (!a) return nullptr;
+    for (const auto& g : a->gateways) {
+        if (g.family == AF_INET) return &g;
+    }
+    return nullptr;
+}
+
+/**
+ * @brief 按探测间隔驱动往返时延探测（非阻塞）
+ * @param opt 外网IP获取选项配置
+ * @param interval 探测间隔
+ * @return 探测数据版本号
+ * @details 与外网查询共用工作线程，网关在调用线程上从当前快照中取出；
+ *          替换了查询后端或网络状态来源（测试程序）时没有真实网络可探测，不执行
+ */
+unsigned long IpService::PollRttProbe(const ExternalIpOptions& opt, std::chrono::milliseconds interval) {
+    auto& s = rtt_;
+    const auto now = Now();
+    {
+        std::lock_guard<std::mutex> lk(s.mtx);
+        if (s.in_flight || now < s.next_due || backend_ || network_) return s.version;
+        s.in_flight = true;
+        s.next_due = now + interval;
+    }
+
+    AdapterAddress gateway;
+    auto snapshot = Snapshot();
+    if (const AdapterAddress* g = SelectGateway(*snapshot)) gateway = *g;
+
+    bool posted = executor_.Post([this, opt, gateway]() { ProbeRtt(opt, gateway); });
+    std::lock_guard<std::mutex> lk(s.mtx);
+    if (!posted) s.in_flight = false;
+    return s.version;
+}
+
+/**
+ * @brief 执行一轮往返时延探测（工作线程）
+ * @param opt 外网IP获取选项配置
+ * @param gateway 要探测的网关（family为0表示没有网关）
+ * @details 网关用ICMP回显；服务器用TCP连接耗时（服务器通常不响应ICMP），
+ *          地址取自DNS缓存中的第一个IPv4地址，没有时取第一个地址
+ */
+void IpService::ProbeRtt(const ExternalIpOptions& opt, const AdapterAddress& gateway) {
+    metrics::Global().rtt_probes.Add();
+
+    std::wstring gateway_target;
+    std::uint32_t gateway_ms = kFailedSample;
+    if (gateway.family == AF_INET) {
+        gateway_target = gateway.text;
+        gateway_ms = PingIPv4(gateway.bytes, kRttTimeoutMs);
+        gateway_rtt_.Push(gateway_ms);
+    }
+
+    std::wstring provider_target;
+    std::uint32_t provider_ms = kFailedSample;
+    DnsCache::Entry entry;
+    if (opt.host && dns_.Resolve(opt.host, entry) && !entry.addresses.empty()) {
+        const ResolvedAddress* target = &entry.addresses.front();
+        for (const auto& a : entry.addresses) {
+            if (a.family == AF_INET) {
+                target = &a;
+                break;
+            }
+        }
+        provider_target = FormatAddress(*target);
+        const unsigned short port = opt.port ? opt.port : static_cast<unsigned short>(opt.secure ? 443 : 80);
+        provider_ms = TcpConnectRtt(*target, port, kRttTimeoutMs);
+    }
+
+    auto& s = rtt_;
+    std::lock_guard<std::mutex> lk(s.mtx);
+    RecordRtt(s.gateway, s.gateway_target, gateway_target, gateway_ms);
+    RecordRtt(s.provider, s.provider_target, provider_target, provider_ms);
+    ++s.version;
+    s.in_flight = false;
+}
+
+/**
+ * @brief 获取往返时延探测结果（不触发探测）
+ */
+RttReport IpService::GetRttReport() {
+    auto& s = rtt_;
+    std::lock_guard<std::mutex> lk(s.mtx);
+    RttReport report;
+    report.gateway.target = s.gateway_target;
+    s.gateway.Summarize(report.gateway);
+    report.provider.target = s.provider_target;
+    s.provider.Summarize(report.provider);
+    return report;
+}
+
+/**
+ * @brief 获取最近的网关往返时延样本（不触发探测）
+ */
+unsigned long long IpService::GetGatewayRttSamples(std::uint32_t* out, size_t max) {
+    const unsigned long long total = gateway_rtt_.Total();
+    gateway_rtt_.Recent(out, max);
+    return total;
+}
+
+} // namespace iputils
@@ -0,0 +1,269 @@
+﻿/**
+ * @file ip_service.h
+ * @brief IP地址服务
+ * @details 把外网查询的传输连接、DNS缓存、结果缓存、刷新计划、工作线程，
+ *          以及默认路由缓存和适配器清单集中到一个对象中，生命周期由创建者决定。
+ *          插件主体持有一个实例并安装为当前服务，ip_utils.h中的自由函数转发到当前服务；
+ *          测试程序可以同时创建多个互不影响的实例
+ * @author Lynn
+ * @date 2025
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <chrono>
+#include <functional>
+#include <utility>
+#include "ip_utils.h"
+#include "adapter_inventory.h"
+#include "route_table.h"
+#include "dns_cache.h"
+#include "lookup_pipeline.h"
+#include "task_executor.h"
+#include "sample_ring.h"
+#include "rtt_probe.h"
+
+namespace iputils {
+
+/**
+ * @brief 外网IP缓存状态
+ * @details 所有字段由mtx保护，查询在工作线程上完成后写回
+ */
+struct ExternalCacheState {
+    std::mutex mtx;                                      // 互斥锁保护缓存
+    IpWithCountry cached_result;                         // 缓存的IP和国家信息
+    std::chrono::steady_clock::time_point last_fetch{};  // 上次获取时间
+    std::chrono::milliseconds last_latency{ 0 };         // 上次成功查询的耗时
+    const wchar_t* provider = nullptr;                   // 上次成功应答的服务器主机名（指向选项中的静态字符串）
+    std::chrono::steady_clock::time_point last_change{}; // 上次IP变化时间
+    int fast_mode_counter = 0;                           // 快速模式计数器
+    unsigned long long last_fingerprint = 0;             // 上次的网络指纹（用于变化检测，0表示尚未记录）
+    std::vector<std::pair<unsigned long long, IpWithCountry>> by_network; // 按网络指纹记住的最近结果（最近使用的在前）
+    bool in_flight = false;                              // 是否已有查询在工作线程上执行
+    bool rerun_requested = false;                        // 查询执行期间网络变化或强制刷新，完成后需要再查询一次
+    bool rerun_full = false;                             // 再次查询时是否直接获取完整信息
+    ExternalIpOptions rerun_opt;                         // 再次查询使用的选项（最近一次请求的选项）
+    std::chrono::steady_clock::time_point next_due{};    // 下一次计划刷新时间
+    std::chrono::steady_clock::time_point prewarmed_for{}; // 已为哪一次计划刷新发起过预热
+    bool close_pending = false;                          // 是否已有空闲关闭任务在排队
+    std::vector<InterfaceEgress> egress_table;           // 按接口探测的出口IP表
+
+    unsigned long version = 0;                           // 缓存数据版本号（IPv4结果、IPv6地址或出口表变化时加一）
+
+    std::wstring cached_v6;                              // 缓存的外网IPv6地址
+    std::chrono::steady_clock::time_point last_fetch_v6{}; // 上次获取外网IPv6的时间
+    bool v6_in_flight = false;                           // 是否已有IPv6查询在工作线程上执行
+};
+
+/**
+ * @brief 往返时延探测状态
+ * @details 所有字段由mtx保护，探测在工作线程上完成后写回
+ */
+struct RttProbeState {
+    std::mutex mtx;                                      // 互斥锁保护探测状态
+    RttWindow gateway;                                   // 到网关的滚动窗口
+    RttWindow provider;                                  // 到查询服务器的滚动窗口
+    std::wstring gateway_target;                         // 网关窗口对应的地址（变化时清空窗口）
+    std::wstring provider_target;                        // 服务器窗口对应的地址
+    std::chrono::steady_clock::time_point next_due{};    // 下一次探测时间
+    bool in_flight = false;                              // 是否已有探测在工作线程上执行
+    unsigned long version = 0;                           // 探测数据版本号（每完成一轮加一）
+};
+
+/**
+ * @brief 内网IPv4地址优先级（192.168/16 > 10/8 > 172.16/12 > 其他，0表示无效）
+ */
+int GetIPPriority(const AdapterAddress& a);
+
+/**
+ * @brief 从适配器中选择优先级最高的IPv4地址，无有效地址时返回空字符串
+ */
+std::wstring PickIPv4(const AdapterEntry& a);
+
+/**
+ * @brief 外网查询后端
+ * @details 参数与RunLookupPipeline相同（不含传输和DNS缓存），成功时填充ctx.result并返回true
+ */
+using LookupBackend = std::function<bool(LookupContext& ctx)>;
+
+/**
+ * @brief 时钟（返回steady_clock时间点）
+ */
+using ServiceClock = std::function<std::chrono::steady_clock::time_point()>;
+
+/**
+ * @brief 网络状态来源
+ * @details 默认使用系统的适配器清单和默认路由缓存；回放测试替换为按录制数据变化的实现
+ */
+class NetworkSource {
+public:
+    virtual ~NetworkSource() = default;
+
+    /// 当前适配器表快照（版本号在内容或首选适配器变化时递增）
+    virtual std::shared_ptr<const AdapterSnapshot> Snapshot() = 0;
+    /// 设置首选适配器
+    virtual void SetPreferred(const std::wstring& name) = 0;
+    /// 当前默认路由（不为空）
+    virtual std::shared_ptr<const DefaultRoute> Route() = 0;
+};
+
+/**
+ * @brief IP地址服务
+ * @details 各方法与ip_utils.h中的同名自由函数含义相同。
+ *          析构时先停止工作线程，尚未执行的查询被丢弃，正在执行的查询完成后才返回
+ */
+class IpService {
+public:
+    IpService() = default;
+    ~IpService();
+
+    IpService(const IpService&) = delete;
+    IpService& operator=(const IpService&) = delete;
+
+    /**
+     * @brief 获取当前服务
+     * @details 返回SetCurrent安装的实例；未安装时返回进程内的默认实例（供独立的测试程序使用）
+     */
+    static IpService& Current();
+
+    /**
+     * @brief 获取已安装的服务（未安装时返回nullptr）
+     */
+    static IpService* Installed();
+
+    /**
+     * @brief 安装当前服务
+     * @param service 要安装的实例（nullptr表示恢复默认实例）
+     */
+    static void SetCurrent(IpService* service);
+
+    // === 内网 ===
+    std::shared_ptr<const AdapterSnapshot> GetAdapterSnapshot();
+    void SetPreferredAdapter(const std::wstring& preferred_adapter);
+    std::wstring GetInternalIPv4();
+    std::wstring GetInternalIPv4(const std::wstring& preferred_adapter);
+    std::wstring GetInternalInterfaceName();
+    std::wstring GetInternalIPv6(const std::wstring& preferred_adapter, const Ipv6SelectOptions& opt);
+    std::wstring GetInternalIPv6(const Ipv6SelectOptions& opt);
+    unsigned long GetNetworkVersion();
+
+    // === 外网 ===
+    IpWithCountry GetExternalIPv4WithCountry(const ExternalIpOptions& opt, bool force_refresh);
+    IpWithCountry RequestExternalIPv4WithCountry(const ExternalIpOptions& opt, bool force_refresh);
+    unsigned long PollExternalIPv4(const ExternalIpOptions& opt, bool force_refresh);
+    std::wstring RequestExternalIPv6(const ExternalIpOptions& opt);
+    unsigned long PollExternalIPv6(const ExternalIpOptions& opt);
+    IpWithCountry GetCachedExternalIPv4();
+    std::wstring GetCachedExternalIPv6();
+    ExternalQueryInfo GetExternalQueryInfo();
+    std::vector<InterfaceEgress> GetInterfaceEgressTable();
+    TransportStats GetTransportStats();
+    unsigned long long GetLookupLatencySamples(std::uint32_t* out, size_t max);
+
+    // === 往返时延 ===
+    unsigned long PollRttProbe(const ExternalIpOptions& opt, std::chrono::milliseconds interval);
+    RttReport GetRttReport();
+    unsigned long long GetGatewayRttSamples(std::uint32_t* out, size_t max);
+
+    /**
+     * @brief 停止工作线程
+     * @details 之后的外网查询不再执行，只返回缓存结果
+     */
+    void Shutdown() { executor_.Stop(); }
+
+    /**
+     * @brief 替换外网查询后端
+     * @param backend 查询函数，为空时恢复真实的查询流水线
+     * @details 供无网络的测试程序使用，只能在发起第一次外网查询之前调用；
+     *          设置后不再预热和维护HTTPS连接
+     */
+    void SetLookupBackend(LookupBackend backend) { backend_ = std::move(backend); }
+
+    /**
+     * @brief 替换网络状态来源
+     * @param source 网络状态来源（由调用方持有），nullptr表示恢复系统的适配器清单和默认路由
+     * @details 与SetLookupBackend相同，只能在第一次查询之前调用
+     */
+    void SetNetworkSource(NetworkSource* source) { network_ = source; }
+
+    /**
+     * @brief 替换刷新计划使用的时钟
+     * @param clock 时钟，为空时使用steady_clock
+     */
+    void SetClock(ServiceClock clock) { clock_ = std::move(clock); }
+
+    /**
+     * @brief 切换为手动执行模式
+     * @details 外网查询不再在工作线程上执行，而是排队到RunPendingTasks时在调用线程上执行
+     */
+    void SetManualExecution(bool manual) { executor_.SetManual(manual); }
+
+    /**
+     * @brief 执行排队中的查询（仅手动执行模式）
+     * @return 执行的任务数
+     */
+    size_t RunPendingTasks() { return executor_.RunPending(); }
+
+    /**
+     * @brief 排队中尚未执行的查询数
+     */
+    size_t PendingTaskCount() { return executor_.PendingCount(); }
+
+    /**
+     * @brief 获取当前默认路由
+     */
+    std::shared_ptr<const DefaultRoute> GetDefaultRoute() { return Route(); }
+
+private:
+    bool ServeFromCache(const ExternalIpOptions& opt, bool force_refresh, IpWithCountry* cached);
+    void MaintainTransport(const ExternalIpOptions& opt);
+    IpWithCountry FetchAndStore(const ExternalIpOptions& opt, bool full);
+    unsigned long ScheduleExternalIPv4(const ExternalIpOptions& opt, bool force_refresh, IpWithCountry* cached);
+    bool PostExternalIPv4(const ExternalIpOptions& opt, bool full);
+    unsigned long ScheduleExternalIPv6(const ExternalIpOptions& opt, std::wstring* cached);
+    bool Lookup(LookupContext& ctx, HttpTransport& transport);
+    std::shared_ptr<const AdapterSnapshot> Snapshot() { return network_ ? network_->Snapshot() : adapters_.Get(); }
+    std::shared_ptr<const DefaultRoute> Route() { return network_ ? network_->Route() : routes_.Get(); }
+    std::chrono::steady_clock::time_point Now() const { return clock_ ? clock_() : std::chrono::steady_clock::now(); }
+    std::wstring SelectInternalIPv4(const AdapterSnapshot& snapshot, const AdapterEntry* preferred);
+    std::wstring SelectInternalIPv6(const AdapterSnapshot& snapshot, const AdapterEntry* preferred, const Ipv6SelectOptions& opt);
+    const AdapterAddress* SelectGateway(const AdapterSnapshot& snapshot);
+    void ProbeRtt(const ExternalIpOptions& opt, const AdapterAddress& gateway);
+
+    DefaultRouteCache routes_;      ///< 默认路由缓存
+    AdapterInventory adapters_;     ///< 适配器清单
+    ExternalCacheState cache_;      ///< 外网结果缓存和刷新计划
+    SampleRing<64> lookup_latency_; ///< 最近的外网IPv4查询耗时（毫秒）
+    RttProbeState rtt_;             ///< 往返时延探测窗口和计划
+    SampleRing<64> gateway_rtt_;    ///< 最近的网关往返时延（毫秒，用于资源占用图）
+    DnsCache dns_;                  ///< 查询服务器的DNS解析缓存
+    HttpTransport transport_;       ///< 外网IPv4查询的HTTPS传输（仅在工作线程或同步查询中使用）
+    HttpTransport transport_v6_;    ///< 外网IPv6查询的传输（与IPv4查询的主机不同，分开保持连接）
+    LookupBackend backend_;         ///< 替换的查询后端（为空时使用查询流水线）
+    NetworkSource* network_ = nullptr; ///< 替换的网络状态来源（nullptr时使用routes_和adapters_）
+    ServiceClock clock_;            ///< 替换的时钟（为空时使用steady_clock）
+    TaskExecutor executor_;         ///< 外网查询工作线程（最后声明，最先析构）
+};
+
+/**
+ * @brief 在作用域内把服务安装为当前服务，离开作用域时恢复之前的服务
+ */
+class ScopedIpService {
+public:
+    explicit ScopedIpService(IpService& service) : previous_(IpService::Installed()) {
+        IpService::SetCurrent(&service);
+    }
+    ~ScopedIpService() { IpService::SetCurrent(previous_); }
+
+    ScopedIpService(const ScopedIpService&) = delete;
+    ScopedIpService& operator=(const ScopedIpService&) = delete;
+
+private:
+    IpService* previous_;
+};
+
+} // namespace iputils
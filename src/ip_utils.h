@@ -11,7 +11,12 @@
 #pragma once
 
 #include <string>
+#include <vector>
 #include <chrono>
+#include <memory>
+#include "ipv6.h"
+#include "adapter_inventory.h"
+#include "sample_ring.h"
 
 namespace iputils {
 
@@ -107,6 +112,41 @@ struct IpWithCountry {
         // 如果最终结果为空，返回原始as_name
         return name.empty() ? as_name : name;
     }
+
+    /**
+     * @brief 从as_name(org)中提取AS号
+     * @return AS号，如"AS906 DMIT Cloud Services"返回"AS906"，没有AS号时返回空字符串
+     */
+    std::wstring GetAsn() const {
+        if (as_name.size() < 3 || as_name.compare(0, 2, L"AS") != 0) {
+            return L"";
+        }
+        size_t end = 2;
+        while (end < as_name.size() && as_name[end] >= L'0' && as_name[end] <= L'9') {
+            ++end;
+        }
+        return end > 2 ? as_name.substr(0, end) : std::wstring();
+    }
+};
+
+/**
+ * @brief 最近一次成功的外网查询信息
+ * @details 用于工具提示显示数据来源、数据新旧和查询延迟
+ */
+struct ExternalQueryInfo {
+    const wchar_t* provider = nullptr;                  ///< 应答查询的服务器主机名（选项中的静态字符串，尚未成功查询时为nullptr）
+    std::chrono::steady_clock::time_point fetched_at{}; ///< 最近一次成功查询的时间
+    std::chrono::milliseconds latency{ 0 };            ///< 最近一次成功查询的耗时
+};
+
+/**
+ * @brief 单个接口的出口IP探测结果
+ */
+struct InterfaceEgress {
+    std::wstring adapter_name;                  ///< 适配器友好名称
+    std::wstring source_ip;                     ///< 绑定的源地址
+    std::wstring egress_ip;                     ///< 提供商看到的出口IP（失败时为空）
+    std::chrono::milliseconds elapsed{ 0 };     ///< 从发起连接到收到响应的耗时
 };
 
 /**
@@ -126,6 +166,10 @@ enum class CacheStrategy {
 struct ExternalIpOptions {
     const wchar_t* host = L"ipinfo.io";                                // 服务器主机名
     const wchar_t* path = L"/json";                                     // 请求路径（返回JSON格式）
+    const wchar_t* ip_only_path = L"/ip";                               // 仅返回IP的纯文本路径（nullptr表示提供商不支持）
+    const wchar_t* host_v6 = L"v6.ipinfo.io";                          // 仅有AAAA记录的IPv6查询主机（nullptr表示不查询外网IPv6）
+    unsigned short port = 0;                                            // 服务器端口（0表示按协议使用默认端口）
+    bool secure = true;                                                 // 是否使用HTTPS（false仅用于本机测试服务器）
     unsigned connect_timeout_ms = 3000;                                 // 连接超时时间（毫秒）
     unsigned send_timeout_ms = 3000;                                    // 发送超时时间（毫秒）
     unsigned receive_timeout_ms = 5000;                                 // 接收超时时间（毫秒）
@@ -136,16 +180,122 @@ struct ExternalIpOptions {
     std::chrono::milliseconds fast_refresh{ std::chrono::seconds(30) }; // 快速刷新间隔
     std::chrono::milliseconds max_refresh{ std::chrono::minutes(15) };  // 最大刷新间隔
     int adaptive_cycles = 6;                                            // 快速模式持续周期数
+
+    // 连接预热配置
+    std::chrono::milliseconds prewarm_lead{ 0 };                        // 在计划刷新前多久预先建立连接（0表示不预热）
+    std::chrono::milliseconds idle_close{ std::chrono::seconds(60) };   // 连接空闲超过该时间后主动关闭（实际不短于min_refresh加30秒）
+
+    // 多WAN配置
+    bool probe_interfaces = false;                                      // 每次刷新时同时探测各接口的出口IP
+};
+
+/**
+ * @brief 一个探测目标的往返时延统计
+ * @details 统计范围是最近若干次探测组成的滚动窗口
+ */
+struct RttSummary {
+    std::wstring target;        ///< 探测目标地址（空表示当前没有可探测的目标）
+    unsigned samples = 0;       ///< 窗口内成功的探测次数
+    unsigned lost = 0;          ///< 窗口内失败（超时或不可达）的探测次数
+    unsigned min_ms = 0;        ///< 最小往返时延（毫秒）
+    unsigned avg_ms = 0;        ///< 平均往返时延（毫秒）
+    unsigned p95_ms = 0;        ///< 第95百分位往返时延（毫秒）
+    unsigned last_ms = 0;       ///< 最近一次的往返时延（毫秒）
+    bool last_ok = false;       ///< 最近一次探测是否成功
+};
+
+/**
+ * @brief 往返时延探测结果
+ */
+struct RttReport {
+    RttSummary gateway;         ///< 到默认网关（ICMP回显）
+    RttSummary provider;        ///< 到查询服务器（TCP连接）
 };
 
+/**
+ * @brief 外网查询传输层统计
+ * @details 用于对比开启/关闭连接预热时的连接复用率和首字节时间
+ */
+struct TransportStats {
+    unsigned long long requests = 0;            ///< 完成响应头接收的查询次数
+    unsigned long long reused_connections = 0;  ///< 复用已有连接的查询次数
+    unsigned long long prewarms = 0;            ///< 成功的预热次数
+    unsigned long long idle_closes = 0;         ///< 因空闲而主动关闭连接的次数
+    unsigned long long warm_requests = 0;       ///< 紧随预热之后的查询次数
+    unsigned long long warm_ttfb_ms = 0;        ///< 预热查询的首字节时间累计（毫秒）
+    unsigned long long cold_requests = 0;       ///< 未经预热的查询次数
+    unsigned long long cold_ttfb_ms = 0;        ///< 未预热查询的首字节时间累计（毫秒）
+    unsigned long long ip_only_requests = 0;    ///< 使用纯文本IP路径的查询次数
+    unsigned long long full_requests = 0;       ///< 使用完整JSON路径的查询次数
+    unsigned long long bytes_received = 0;      ///< 响应体字节数累计
+    unsigned long long parse_us = 0;            ///< 响应体解析耗时累计（微秒）
+
+    /// 连接复用率（0~1）
+    double ReuseRate() const { return requests ? (double)reused_connections / requests : 0.0; }
+    /// 预热查询的平均首字节时间（毫秒）
+    double WarmTtfbMs() const { return warm_requests ? (double)warm_ttfb_ms / warm_requests : 0.0; }
+    /// 未预热查询的平均首字节时间（毫秒）
+    double ColdTtfbMs() const { return cold_requests ? (double)cold_ttfb_ms / cold_requests : 0.0; }
+    /// 每次查询的平均响应体字节数
+    double BytesPerRequest() const { return requests ? (double)bytes_received / requests : 0.0; }
+    /// 每次查询的平均解析耗时（微秒）
+    double ParseUsPerRequest() const { return requests ? (double)parse_us / requests : 0.0; }
+};
+
+/**
+ * @brief 获取当前网络适配器表快照
+ * @return 进程内共享的适配器清单快照（网络未变化时不重新枚举）
+ * @details 供选项对话框等界面直接使用，避免各自调用GetAdaptersAddresses
+ */
+std::shared_ptr<const AdapterSnapshot> GetAdapterSnapshot();
+
 /**
  * @brief 获取内网IPv4地址（支持智能优先级选择）
  * @param preferred_adapter 首选网络适配器名称（可选）
  * @return IPv4地址字符串（如"192.168.1.12"），获取失败返回空字符串
- * @details 优先级策略：192.168.x.x > 10.x.x.x > 172.16-31.x.x > 其他
- *          支持通过FriendlyName或AdapterName指定首选适配器
+ * @details 支持通过FriendlyName或AdapterName指定首选适配器；
+ *          自动选择时使用默认路由出接口的源地址（路由表缓存，路由变化通知时失效），
+ *          没有默认路由时按优先级：192.168.x.x > 10.x.x.x > 172.16-31.x.x > 其他
+ */
+std::wstring GetInternalIPv4(const std::wstring& preferred_adapter);
+
+/**
+ * @brief 设置运行时使用的首选网络适配器
+ * @param preferred_adapter 友好名称或适配器名称（空表示自动选择）
+ * @details 名称只在设置变化和适配器表重建时解析为适配器下标，
+ *          之后GetInternalIPv4()/GetInternalIPv6(opt)不再做字符串转换或比较
+ */
+void SetPreferredAdapter(const std::wstring& preferred_adapter);
+
+/**
+ * @brief 获取内网IPv4地址（使用SetPreferredAdapter设置的首选适配器）
+ * @return IPv4地址字符串，获取失败返回空字符串
+ * @details 供每次刷新调用：首选适配器通过快照中预先解析的下标直接定位
+ */
+std::wstring GetInternalIPv4();
+
+/**
+ * @brief 获取内网IPv6地址（双栈，按RFC 6724排序）
+ * @param preferred_adapter 首选网络适配器名称（可选）
+ * @param opt 选择选项（是否跳过弃用/临时地址）
+ * @return 压缩形式的IPv6地址字符串，获取失败返回空字符串
+ * @details 全局地址 > ULA > 链路本地；同级按RFC 6724策略表优先级比较
  */
-std::wstring GetInternalIPv4(const std::wstring& preferred_adapter = L"");
+std::wstring GetInternalIPv6(const std::wstring& preferred_adapter, const Ipv6SelectOptions& opt = {});
+
+/**
+ * @brief 获取内网IPv6地址（使用SetPreferredAdapter设置的首选适配器）
+ * @param opt 选择选项（是否跳过弃用/临时地址）
+ * @return 压缩形式的IPv6地址字符串，获取失败返回空字符串
+ */
+std::wstring GetInternalIPv6(const Ipv6SelectOptions& opt = {});
+
+/**
+ * @brief 获取外网IPv6地址（非阻塞，供UI线程调用）
+ * @param opt 外网IP获取选项配置
+ * @return 当前缓存的外网IPv6地址，尚未获取或没有IPv6外网连接时返回空字符串
+ */
+std::wstring RequestExternalIPv6(const ExternalIpOptions& opt = {});
 
 /**
  * @brief 获取外网IPv4地址和国家信息（支持缓存和强制刷新）
@@ -158,6 +308,106 @@ std::wstring GetInternalIPv4(const std::wstring& preferred_adapter = L"");
  */
 IpWithCountry GetExternalIPv4WithCountry(const ExternalIpOptions& opt = {}, bool force_refresh = false);
 
+/**
+ * @brief 获取外网IPv4地址和国家信息（非阻塞，供UI线程调用）
+ * @param opt 外网IP获取选项配置
+ * @param force_refresh 是否强制刷新（跳过缓存）
+ * @return 当前缓存的结果，尚未获取成功时返回空的结构
+ * @details 与GetExternalIPv4WithCountry共享同一缓存和缓存策略，
+ *          需要查询时把查询流水线投递到后台工作线程执行，不阻塞调用线程
+ */
+IpWithCountry RequestExternalIPv4WithCountry(const ExternalIpOptions& opt = {}, bool force_refresh = false);
+
+/**
+ * @brief 驱动外网IPv4刷新计划（非阻塞，不复制结果）
+ * @param opt 外网IP获取选项配置
+ * @param force_refresh 是否强制刷新（跳过缓存）
+ * @return 外网数据版本号：缓存的IPv4结果、IPv6地址或出口表变化时加一
+ * @details 与RequestExternalIPv4WithCountry的缓存策略相同；
+ *          调用方只在版本号变化时通过GetCachedExternalIPv4取结果
+ */
+unsigned long PollExternalIPv4(const ExternalIpOptions& opt = {}, bool force_refresh = false);
+
+/**
+ * @brief 驱动外网IPv6刷新计划（非阻塞，不复制结果）
+ * @param opt 外网IP获取选项配置
+ * @return 外网数据版本号（与PollExternalIPv4相同的计数器）
+ */
+unsigned long PollExternalIPv6(const ExternalIpOptions& opt = {});
+
+/**
+ * @brief 获取缓存的外网IPv4结果（不触发查询）
+ */
+IpWithCountry GetCachedExternalIPv4();
+
+/**
+ * @brief 获取缓存的外网IPv6地址（不触发查询）
+ */
+std::wstring GetCachedExternalIPv6();
+
+/**
+ * @brief 获取最近一次成功的外网查询信息（不触发查询）
+ */
+ExternalQueryInfo GetExternalQueryInfo();
+
+/**
+ * @brief 获取当前内网IPv4所在接口的名称
+ * @return 首选适配器（可用时）或默认路由出接口的友好名称，都不存在时返回空字符串
+ * @details 与GetInternalIPv4()使用相同的选择顺序，结果随GetNetworkVersion()变化
+ */
+std::wstring GetInternalInterfaceName();
+
+/**
+ * @brief 获取网络状态版本号
+ * @return 适配器清单快照的版本号：接口、地址、路由或首选适配器变化时改变
+ * @details 版本号不变时GetInternalIPv4()/GetInternalIPv6(opt)的结果也不变
+ */
+unsigned long GetNetworkVersion();
+
+/**
+ * @brief 获取最近一次按接口探测的出口IP表
+ * @return 每个活动IPv4接口一项；未开启probe_interfaces或尚未探测时为空
+ */
+std::vector<InterfaceEgress> GetInterfaceEgressTable();
+
+/**
+ * @brief 获取外网查询传输层统计
+ * @return 统计快照
+ */
+TransportStats GetTransportStats();
+
+/**
+ * @brief 获取最近的外网IPv4查询耗时样本（不触发查询）
+ * @param out 输出：按从新到旧的顺序，单位毫秒，失败的查询为kFailedSample
+ * @param max out的容量
+ * @return 已记录的样本总数（只增不减，可用于判断是否有新样本）
+ * @details 样本保存在固定容量的无锁样本环中，每次查询完成时写入一个
+ */
+unsigned long long GetLookupLatencySamples(std::uint32_t* out, size_t max);
+
+/**
+ * @brief 驱动往返时延探测计划（非阻塞）
+ * @param opt 外网IP获取选项配置（使用其中的服务器主机名、端口和连接超时）
+ * @param interval 探测间隔
+ * @return 探测数据版本号，每完成一轮探测加一
+ * @details 到期时把一轮探测投递到外网查询所用的工作线程：网关取自共享的适配器快照
+ *          （首选适配器或默认路由出接口的IPv4网关），服务器地址取自DNS缓存，不另行枚举
+ */
+unsigned long PollRttProbe(const ExternalIpOptions& opt, std::chrono::milliseconds interval);
+
+/**
+ * @brief 获取往返时延探测结果（不触发探测）
+ */
+RttReport GetRttReport();
+
+/**
+ * @brief 获取最近的网关往返时延样本（不触发探测）
+ * @param out 输出：按从新到旧的顺序，单位毫秒，失败的探测为kFailedSample
+ * @param max out的容量
+ * @return 已记录的样本总数
+ */
+unsigned long long GetGatewayRttSamples(std::uint32_t* out, size_t max);
+
 /**
  * @brief 获取外网IPv4地址（兼容性函数）
  * @param opt 外网IP获取选项配置
@@ -0,0 +1,156 @@
+﻿/**
+ * @file ipv6.cpp
+ * @brief IPv6地址的紧凑存储、格式化和RFC 6724排序实现
+ * @details 本文件不依赖Windows头文件，只处理16字节地址
+ * @author Lynn
+ * @date 2025
+ */
+
+#include "ipv6.h"
+
+#include <cstring>
+
+namespace iputils {
+
+namespace {
+
+/**
+ * @brief RFC 6724第2.1节默认策略表的一项
+ */
+struct PolicyEntry {
+    uint8_t prefix[16];
+    int prefix_len;
+    int precedence;
+};
+
+/// RFC 6724默认策略表（按前缀长度从长到短排列，首个匹配即最长匹配）
+const PolicyEntry kPolicyTable[] = {
+    { { 0,0,0,0, 0,0,0,0, 0,0,0,0, 0,0,0,1 },                 128, 50 },  // ::1/128
+    { { 0,0,0,0, 0,0,0,0, 0,0,0xff,0xff, 0,0,0,0 },            96, 35 },  // ::ffff:0:0/96
+    { { 0,0,0,0, 0,0,0,0, 0,0,0,0, 0,0,0,0 },                  96,  1 },  // ::/96
+    { { 0x20,0x01,0,0, 0,0,0,0, 0,0,0,0, 0,0,0,0 },            32,  5 },  // 2001::/32（Teredo）
+    { { 0x20,0x02,0,0, 0,0,0,0, 0,0,0,0, 0,0,0,0 },            16, 30 },  // 2002::/16（6to4）
+    { { 0x3f,0xfe,0,0, 0,0,0,0, 0,0,0,0, 0,0,0,0 },            16,  1 },  // 3ffe::/16（6bone）
+    { { 0xfe,0xc0,0,0, 0,0,0,0, 0,0,0,0, 0,0,0,0 },            10,  1 },  // fec0::/10（站点本地）
+    { { 0xfc,0,0,0, 0,0,0,0, 0,0,0,0, 0,0,0,0 },                7,  3 },  // fc00::/7（ULA）
+    { { 0,0,0,0, 0,0,0,0, 0,0,0,0, 0,0,0,0 },                   0, 40 },  // ::/0
+};
+
+bool MatchPrefix(const Ipv6Address& addr, const uint8_t (&prefix)[16], int len) {
+    const int full = len / 8;
+    if (std::memcmp(addr.bytes, prefix, full) != 0) return false;
+    const int rest = len % 8;
+    if (rest == 0) return true;
+    const uint8_t mask = static_cast<uint8_t>(0xFF << (8 - rest));
+    return (addr.bytes[full] & mask) == (prefix[full] & mask);
+}
+
+} // namespace
+
+bool Ipv6Address::operator==(const Ipv6Address& o) const {
+    return std::memcmp(bytes, o.bytes, sizeof(bytes)) == 0;
+}
+
+size_t FormatIPv6(const Ipv6Address& addr, wchar_t (&buf)[kIpv6TextSize]) {
+    static const wchar_t kHex[] = L"0123456789abcdef";
+
+    uint16_t g[8];
+    for (int i = 0; i < 8; ++i) {
+        g[i] = static_cast<uint16_t>((addr.bytes[2 * i] << 8) | addr.bytes[2 * i + 1]);
+    }
+
+    // ::ffff:a.b.c.d（IPv4映射地址）最后32位以点分十进制输出
+    const bool mapped = g[0] == 0 && g[1] == 0 && g[2] == 0 && g[3] == 0 && g[4] == 0 && g[5] == 0xFFFF;
+    const int groups = mapped ? 6 : 8;
+
+    // 找出最长的连续零段（长度相同时取第一个），长度不足2不压缩
+    int best_start = -1, best_len = 0;
+    for (int i = 0; i < groups;) {
+        if (g[i] != 0) { ++i; continue; }
+        int j = i;
+        while (j < groups && g[j] == 0) ++j;
+        if (j - i > best_len) { best_start = i; best_len = j - i; }
+        i = j;
+    }
+    if (best_len < 2) best_start = -1;
+
+    size_t n = 0;
+    for (int i = 0; i < groups;) {
+        if (i == best_start) {
+            buf[n++] = L':';
+            buf[n++] = L':';
+            i += best_len;
+            continue;
+        }
+        if (i > 0 && i != best_start + best_len) buf[n++] = L':';
+        bool started = false;
+        for (int shift = 12; shift >= 0; shift -= 4) {
+            unsigned d = (g[i] >> shift) & 0xF;
+            if (d || started || shift == 0) {
+                buf[n++] = kHex[d];
+                started = true;
+            }
+        }
+        ++i;
+    }
+
+    if (mapped) {
+        if (buf[n - 1] != L':') buf[n++] = L':';
+        for (int k = 12; k < 16; ++k) {
+            unsigned v = addr.bytes[k];
+            if (v >= 100) buf[n++] = static_cast<wchar_t>(L'0' + v / 100);
+            if (v >= 10) buf[n++] = static_cast<wchar_t>(L'0' + (v / 10) % 10);
+            buf[n++] = static_cast<wchar_t>(L'0' + v % 10);
+            if (k < 15) buf[n++] = L'.';
+        }
+    }
+
+    buf[n] = L'\0';
+    return n;
+}
+
+Ipv6Class ClassifyIPv6(const Ipv6Address& addr) {
+    const uint8_t* b = addr.bytes;
+    static const uint8_t kZero[16] = {};
+    // 未指定地址::和回环地址::1
+    if (std::memcmp(b, kZero, 15) == 0 && (b[15] == 0 || b[15] == 1)) return Ipv6Class::INVALID;
+    if (b[0] == 0xFF) return Ipv6Class::INVALID;                                // ff00::/8 组播
+    if (b[0] == 0xFE && (b[1] & 0xC0) == 0x80) return Ipv6Class::LINK_LOCAL;    // fe80::/10
+    if (b[0] == 0xFE && (b[1] & 0xC0) == 0xC0) return Ipv6Class::LINK_LOCAL;    // fec0::/10
+    if ((b[0] & 0xFE) == 0xFC) return Ipv6Class::UNIQUE_LOCAL;                  // fc00::/7
+    return Ipv6Class::GLOBAL;
+}
+
+int Ipv6Precedence(const Ipv6Address& addr) {
+    for (const auto& e : kPolicyTable) {
+        if (MatchPrefix(addr, e.prefix, e.prefix_len)) return e.precedence;
+    }
+    return 40;
+}
+
+int RankIPv6(const Ipv6Candidate& c, const Ipv6SelectOptions& opt) {
+    if (opt.skip_deprecated && c.deprecated) return 0;
+    if (opt.skip_temporary && c.temporary) return 0;
+    const Ipv6Class cls = ClassifyIPv6(c.addr);
+    if (cls == Ipv6Class::INVALID) return 0;
+
+    return static_cast<int>(cls) * 100000
+        + Ipv6Precedence(c.addr) * 100
+        + (c.deprecated ? 0 : 10)
+        + (c.temporary ? 0 : 1);
+}
+
+size_t SelectBestIPv6(const Ipv6Candidate* candidates, size_t count, const Ipv6SelectOptions& opt) {
+    size_t best = count;
+    int best_rank = 0;
+    for (size_t i = 0; i < count; ++i) {
+        int rank = RankIPv6(candidates[i], opt);
+        if (rank > best_rank) {
+            best_rank = rank;
+            best = i;
+        }
+    }
+    return best;
+}
+
+} // namespace iputils
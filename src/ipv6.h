@@ -0,0 +1,90 @@
+﻿/**
+ * @file ipv6.h
+ * @brief IPv6地址的紧凑存储、格式化和RFC 6724排序
+ * @details 地址以16字节存储；格式化按RFC 5952压缩形式写入调用方提供的缓冲区，不分配内存；
+ *          排序使用RFC 6724默认策略表的优先级，并按 全局 > ULA > 链路本地 的范围分级
+ * @author Lynn
+ * @date 2025
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace iputils {
+
+/**
+ * @brief 紧凑的IPv6地址（网络字节序）
+ */
+struct Ipv6Address {
+    uint8_t bytes[16] = {};
+
+    bool operator==(const Ipv6Address& o) const;
+    bool operator!=(const Ipv6Address& o) const { return !(*this == o); }
+};
+
+/// RFC 5952压缩形式的最大长度（含结尾0），与INET6_ADDRSTRLEN一致
+constexpr size_t kIpv6TextSize = 46;
+
+/**
+ * @brief 按RFC 5952格式化IPv6地址
+ * @param addr 地址
+ * @param buf 输出缓冲区
+ * @return 写入的字符数（不含结尾0）
+ * @details 小写十六进制、省略前导零、最长的连续零段（至少两段）压缩为"::"，
+ *          IPv4映射地址输出为"::ffff:a.b.c.d"
+ */
+size_t FormatIPv6(const Ipv6Address& addr, wchar_t (&buf)[kIpv6TextSize]);
+
+/**
+ * @brief IPv6地址的范围分级（数值越大越优先）
+ */
+enum class Ipv6Class {
+    INVALID = 0,    ///< 未指定地址、回环地址、组播地址
+    LINK_LOCAL,     ///< fe80::/10（以及已废弃的站点本地fec0::/10）
+    UNIQUE_LOCAL,   ///< fc00::/7（ULA）
+    GLOBAL          ///< 其他单播地址
+};
+
+/**
+ * @brief 获取地址的范围分级
+ */
+Ipv6Class ClassifyIPv6(const Ipv6Address& addr);
+
+/**
+ * @brief 获取地址在RFC 6724默认策略表中的优先级（Precedence）
+ */
+int Ipv6Precedence(const Ipv6Address& addr);
+
+/**
+ * @brief 内网IPv6地址选择的候选项
+ */
+struct Ipv6Candidate {
+    Ipv6Address addr;
+    bool deprecated = false;        ///< 已弃用（首选生存期已过）
+    bool temporary = false;         ///< 临时（隐私扩展）地址
+};
+
+/**
+ * @brief 内网IPv6地址选择选项
+ */
+struct Ipv6SelectOptions {
+    bool skip_deprecated = true;    ///< 跳过已弃用地址
+    bool skip_temporary = true;     ///< 跳过临时地址
+};
+
+/**
+ * @brief 计算候选地址的排序值
+ * @return 排序值，越大越优先；0表示不可选
+ * @details 依次比较：范围分级 > RFC 6724优先级 > 非弃用 > 稳定地址（非临时）
+ */
+int RankIPv6(const Ipv6Candidate& c, const Ipv6SelectOptions& opt);
+
+/**
+ * @brief 从候选地址中选出排序值最高的一个
+ * @return 候选项下标，没有可选地址时返回count
+ */
+size_t SelectBestIPv6(const Ipv6Candidate* candidates, size_t count, const Ipv6SelectOptions& opt);
+
+} // namespace iputils
@@ -0,0 +1,415 @@
+﻿/**
+ * @file lookup_pipeline.cpp
+ * @brief 外网IP查询流水线实现
+ * @details 每个阶段是一个独立的静态函数，只读写LookupContext和传输句柄，
+ *          任一阶段失败即终止流水线
+ * @author Lynn
+ * @date 2025
+ */
+
+#include "lookup_pipeline.h"
+#include "module_state.h"
+
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+
+#include <windows.h>
+#include <winhttp.h>
+
+#include <algorithm>
+
+#pragma comment(lib, "Winhttp.lib")
+
+namespace iputils {
+
+namespace {
+
+/// 响应体大小上限，防止异常响应占用过多内存
+constexpr size_t kMaxBodySize = 64 * 1024;
+
+/**
+ * @brief WinHTTP句柄的RAII封装
+ */
+struct WinHttpHandle {
+    HINTERNET h = nullptr;
+    WinHttpHandle() = default;
+    ~WinHttpHandle() { if (h) WinHttpCloseHandle(h); }
+    WinHttpHandle(const WinHttpHandle&) = delete;
+    WinHttpHandle& operator=(const WinHttpHandle&) = delete;
+};
+
+/// 每个地址的最短连接超时（RFC 8305建议的连接尝试间隔量级）
+constexpr unsigned kMinAttemptTimeoutMs = 250;
+
+/**
+ * @brief 请求标志（HTTPS时为WINHTTP_FLAG_SECURE）
+ */
+DWORD RequestFlags(const ExternalIpOptions& opt) {
+    return opt.secure ? WINHTTP_FLAG_SECURE : 0;
+}
+
+/**
+ * @brief 连接端口（未指定时按协议使用默认端口）
+ */
+INTERNET_PORT ConnectPort(const ExternalIpOptions& opt) {
+    if (opt.port) return opt.port;
+    return opt.secure ? INTERNET_DEFAULT_HTTPS_PORT : INTERNET_DEFAULT_HTTP_PORT;
+}
+
+/**
+ * @brief 检查纯文本响应是否像一个IP地址（只含十六进制数字、'.'和':'）
+ */
+bool IsPlainIpText(const std::string& text) {
+    if (text.empty() || text.size() > 45) return false;  // INET6_ADDRSTRLEN - 1
+    for (char c : text) {
+        bool ok = (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F')
+            || c == '.' || c == ':';
+        if (!ok) return false;
+    }
+    return true;
+}
+
+/**
+ * @brief 将UTF-8字符串转换为宽字符串
+ */
+std::wstring Utf8ToWide(const std::string& s) {
+    if (s.empty()) return std::wstring();
+    int wlen = MultiByteToWideChar(CP_UTF8, 0, s.c_str(), (int)s.size(), nullptr, 0);
+    if (wlen <= 0) return std::wstring();
+    std::wstring ws(wlen, L'\0');
+    MultiByteToWideChar(CP_UTF8, 0, s.c_str(), (int)s.size(), &ws[0], wlen);
+    return ws;
+}
+
+/**
+ * @brief 判断请求是否复用了连接池中的已有连接
+ * @details 依赖WINHTTP_OPTION_REQUEST_STATS（Windows 10 1903及以上），不支持时返回false
+ */
+bool IsReusedConnection(HINTERNET hRequest) {
+#if defined(WINHTTP_OPTION_REQUEST_STATS) && defined(WINHTTP_REQUEST_STAT_FLAG_FIRST_REQUEST)
+    WINHTTP_REQUEST_STATS stats = {};
+    DWORD len = sizeof(stats);
+    if (WinHttpQueryOption(hRequest, WINHTTP_OPTION_REQUEST_STATS, &stats, &len)) {
+        return (stats.ullFlags & WINHTTP_REQUEST_STAT_FLAG_FIRST_REQUEST) == 0;
+    }
+#else
+    (void)hRequest;
+#endif
+    return false;
+}
+
+/**
+ * @brief 阶段1：通过DNS缓存解析服务器地址
+ * @details 这里只取地址数量，用于阶段3拆分连接超时；连接仍由WinHTTP按主机名自行解析
+ *          （直接连接缓存中的地址会丢失SNI和证书主机名校验），DNS缓存的作用是
+ *          在TTL内预取，使WinHTTP的解析命中已预热的系统DNS缓存。
+ *          解析失败不终止流水线：系统可能通过代理访问外网，此时由WinHTTP自行处理
+ */
+bool StageResolve(LookupContext& ctx, DnsCache& dns) {
+    DnsCache::Entry entry;
+    if (dns.Resolve(ctx.opt.host, entry)) {
+        ctx.address_count = entry.addresses.size();
+    }
+    return true;
+}
+
+/**
+ * @brief 阶段2：复用或建立到服务器的连接句柄
+ */
+bool StageConnect(LookupContext& ctx, HttpTransport& transport, HINTERNET& hConnect) {
+    hConnect = static_cast<HINTERNET>(transport.Connect(ctx.opt));
+    return hConnect != nullptr;
+}
+
+/**
+ * @brief 阶段3：发送HTTPS GET请求并接收响应头
+ * @details WinHTTP对每个解析地址单独计算连接超时，因此按地址数量拆分连接超时预算，
+ *          使一个不可达地址不会耗尽整个connect_timeout_ms
+ */
+bool StageRequest(LookupContext& ctx, HINTERNET hConnect, WinHttpHandle& request) {
+    const wchar_t* path = ctx.ip_only ? ctx.opt.ip_only_path : ctx.opt.path;
+    request.h = WinHttpOpenRequest(hConnect, L"GET", path, nullptr,
+                                   WINHTTP_NO_REFERER, WINHTTP_DEFAULT_ACCEPT_TYPES,
+                                   RequestFlags(ctx.opt));
+    if (!request.h) return false;
+
+    unsigned connect_timeout = ctx.opt.connect_timeout_ms;
+    if (ctx.address_count > 1) {
+        connect_timeout = std::max(kMinAttemptTimeoutMs,
+                                   connect_timeout / static_cast<unsigned>(ctx.address_count));
+    }
+    WinHttpSetTimeouts(request.h, ctx.opt.connect_timeout_ms, connect_timeout, ctx.opt.send_timeout_ms, ctx.opt.receive_timeout_ms);
+
+    const auto send_time = std::chrono::steady_clock::now();
+    if (!WinHttpSendRequest(request.h, WINHTTP_NO_ADDITIONAL_HEADERS, 0,
+                            WINHTTP_NO_REQUEST_DATA, 0, 0, 0))
+        return false;
+    if (!WinHttpReceiveResponse(request.h, nullptr)) return false;
+    ctx.ttfb = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - send_time);
+    ctx.reused_connection = IsReusedConnection(request.h);
+
+    DWORD status = 0;
+    DWORD len = sizeof(status);
+    if (WinHttpQueryHeaders(request.h, WINHTTP_QUERY_STATUS_CODE | WINHTTP_QUERY_FLAG_NUMBER,
+                            WINHTTP_HEADER_NAME_BY_INDEX, &status, &len, WINHTTP_NO_HEADER_INDEX)) {
+        ctx.status_code = status;
+    }
+    return ctx.status_code == 0 || ctx.status_code == 200;
+}
+
+/**
+ * @brief 阶段4：按块读取响应体，读取完成后解析JSON字段
+ */
+bool StageStreamParse(LookupContext& ctx, HINTERNET hRequest) {
+    DWORD dwSize = 0;
+    do {
+        dwSize = 0;
+        if (!WinHttpQueryDataAvailable(hRequest, &dwSize)) break;  // 查询可用数据大小
+        if (dwSize == 0) break;  // 没有更多数据
+        if (ctx.body.size() + dwSize > kMaxBodySize) break;  // 超出上限，按已读取部分解析
+
+        size_t old = ctx.body.size();
+        ctx.body.resize(old + dwSize);
+        DWORD dwRead = 0;
+        if (!WinHttpReadData(hRequest, &ctx.body[old], dwSize, &dwRead)) {
+            ctx.body.resize(old);
+            break;
+        }
+        ctx.body.resize(old + dwRead);
+    } while (dwSize > 0);
+
+    const auto parse_start = std::chrono::steady_clock::now();
+    auto begin = ctx.body.find_first_not_of(" \t\r\n");
+    if (begin != std::string::npos) {
+        auto end = ctx.body.find_last_not_of(" \t\r\n");
+        std::string trimmed = ctx.body.substr(begin, end - begin + 1);
+
+        if (ctx.ip_only) {
+            // 纯文本响应：整个响应体就是IP地址
+            if (IsPlainIpText(trimmed)) ctx.ip = trimmed;
+        } else {
+            // 解析JSON响应数据（ipinfo.io格式）
+            ctx.ip = ExtractJsonField(trimmed, "ip");
+            if (ctx.ip.empty()) {
+                ctx.ip = ExtractJsonField(trimmed, "origin");  // httpbin.org格式备用
+            }
+            ctx.country = ExtractJsonField(trimmed, "country");
+            ctx.org = ExtractJsonField(trimmed, "org");
+        }
+    }
+    ctx.parse_time = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - parse_start);
+    return !ctx.ip.empty();
+}
+
+/**
+ * @brief 阶段5：将UTF-8字段转换为宽字符串并填充结果
+ */
+bool StageEnrich(LookupContext& ctx) {
+    ctx.result.ip = Utf8ToWide(ctx.ip);
+    ctx.result.country = Utf8ToWide(ctx.country);
+    ctx.result.as_name = Utf8ToWide(ctx.org);
+    return ctx.result.IsValid();
+}
+
+} // namespace
+
+std::string ExtractJsonField(const std::string& json, const std::string& field) {
+    // 构造查找模式："field"，允许冒号后有可选空格
+    std::string pattern = "\"" + field + "\"";
+    size_t start = json.find(pattern);
+    if (start == std::string::npos) return "";
+
+    // 跳过字段名
+    start += pattern.length();
+
+    // 跳过冒号和可能的空格
+    while (start < json.length() && (json[start] == ':' || json[start] == ' ' || json[start] == '\t')) {
+        start++;
+    }
+
+    // 检查是否为字符串值（以"开始）
+    if (start >= json.length() || json[start] != '"') return "";
+    start++; // 跳过开始的引号
+
+    // 查找结束引号
+    size_t end = json.find("\"", start);
+    if (end == std::string::npos) return "";
+
+    return json.substr(start, end - start);
+}
+
+void* HttpTransport::Connect(const ExternalIpOptions& opt) {
+    if (connect_ && host_ == opt.host && port_ == ConnectPort(opt) && secure_ == opt.secure) return connect_;
+    Reset();
+
+    session_ = WinHttpOpen(L"TrafficMonitorIpPlugin/1.0",
+                           WINHTTP_ACCESS_TYPE_DEFAULT_PROXY,
+                           WINHTTP_NO_PROXY_NAME,
+                           WINHTTP_NO_PROXY_BYPASS, 0);
+    if (!session_) return nullptr;
+
+#ifdef WINHTTP_OPTION_IPV6_FAST_FALLBACK
+    // 同时尝试IPv6和IPv4（Happy Eyeballs），旧系统上设置失败时忽略
+    DWORD fast_fallback = TRUE;
+    WinHttpSetOption(session_, WINHTTP_OPTION_IPV6_FAST_FALLBACK, &fast_fallback, sizeof(fast_fallback));
+#endif
+
+    WinHttpSetTimeouts(session_, opt.connect_timeout_ms, opt.connect_timeout_ms, opt.send_timeout_ms, opt.receive_timeout_ms);
+
+    connect_ = WinHttpConnect(session_, opt.host, ConnectPort(opt), 0);
+    if (!connect_) {
+        Reset();
+        return nullptr;
+    }
+    host_ = opt.host;
+    port_ = ConnectPort(opt);
+    secure_ = opt.secure;
+    open_ = true;
+    return connect_;
+}
+
+HttpTransport::~HttpTransport() {
+    // 模块卸载时不能调用WinHttpCloseHandle（WinHTTP内部会等待自己的线程），进程正在退出，句柄交给系统回收
+    if (!IsModuleDetaching()) Reset();
+}
+
+void HttpTransport::Reset() {
+    if (connect_) WinHttpCloseHandle(connect_);
+    if (session_) WinHttpCloseHandle(session_);
+    connect_ = nullptr;
+    session_ = nullptr;
+    host_.clear();
+    prewarmed_ = false;
+    open_ = false;
+}
+
+bool HttpTransport::Prewarm(const ExternalIpOptions& opt, DnsCache& dns) {
+    std::lock_guard<std::mutex> lk(mtx_);
+    DnsCache::Entry entry;
+    dns.Resolve(opt.host, entry);  // 同时保证DNS缓存是新的
+
+    HINTERNET hConnect = static_cast<HINTERNET>(Connect(opt));
+    if (!hConnect) return false;
+
+    WinHttpHandle request;
+    request.h = WinHttpOpenRequest(hConnect, L"HEAD", opt.path, nullptr,
+                                   WINHTTP_NO_REFERER, WINHTTP_DEFAULT_ACCEPT_TYPES,
+                                   RequestFlags(opt));
+    bool ok = request.h
+        && WinHttpSendRequest(request.h, WINHTTP_NO_ADDITIONAL_HEADERS, 0, WINHTTP_NO_REQUEST_DATA, 0, 0, 0)
+        && WinHttpReceiveResponse(request.h, nullptr);
+    if (!ok) {
+        if (request.h) {
+            WinHttpCloseHandle(request.h);
+            request.h = nullptr;
+        }
+        Reset();
+        return false;
+    }
+
+    prewarmed_ = true;
+    MarkUsed();
+    std::lock_guard<std::mutex> slk(stats_mtx_);
+    stats_.prewarms++;
+    return true;
+}
+
+bool HttpTransport::CloseIfIdle(std::chrono::milliseconds limit) {
+    std::lock_guard<std::mutex> lk(mtx_);
+    if (!IsIdleFor(limit)) return false;
+    Reset();
+    std::lock_guard<std::mutex> slk(stats_mtx_);
+    stats_.idle_closes++;
+    return true;
+}
+
+bool HttpTransport::IsIdleFor(std::chrono::milliseconds limit) const {
+    if (!open_) return false;
+    const auto last = std::chrono::steady_clock::time_point(
+        std::chrono::steady_clock::duration(last_used_.load()));
+    return std::chrono::steady_clock::now() - last > limit;
+}
+
+TransportStats HttpTransport::GetStats() const {
+    std::lock_guard<std::mutex> lk(stats_mtx_);
+    return stats_;
+}
+
+void HttpTransport::MarkUsed() {
+    last_used_ = std::chrono::steady_clock::now().time_since_epoch().count();
+}
+
+void HttpTransport::RecordBody(const LookupContext& ctx) {
+    std::lock_guard<std::mutex> lk(stats_mtx_);
+    stats_.bytes_received += ctx.body.size();
+    stats_.parse_us += ctx.parse_time.count();
+}
+
+void HttpTransport::Record(const LookupContext& ctx) {
+    std::lock_guard<std::mutex> lk(stats_mtx_);
+    stats_.requests++;
+    if (ctx.ip_only) stats_.ip_only_requests++;
+    else stats_.full_requests++;
+    if (ctx.reused_connection) stats_.reused_connections++;
+    if (ctx.prewarmed) {
+        stats_.warm_requests++;
+        stats_.warm_ttfb_ms += ctx.ttfb.count();
+    } else {
+        stats_.cold_requests++;
+        stats_.cold_ttfb_ms += ctx.ttfb.count();
+    }
+}
+
+bool RunLookupPipeline(LookupContext& ctx, HttpTransport& transport, DnsCache& dns) {
+    const auto start = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lk(transport.Mutex());
+    HINTERNET hConnect = nullptr;
+    WinHttpHandle request;
+    bool ok = false;
+    ctx.prewarmed = transport.prewarmed_;
+    transport.prewarmed_ = false;
+
+    ctx.stage = LookupStage::RESOLVE;
+    if (StageResolve(ctx, dns)) {
+        ctx.stage = LookupStage::CONNECT;
+        if (StageConnect(ctx, transport, hConnect)) {
+            ctx.stage = LookupStage::REQUEST;
+            if (StageRequest(ctx, hConnect, request)) {
+                transport.Record(ctx);
+                ctx.stage = LookupStage::STREAM_PARSE;
+                bool parsed = StageStreamParse(ctx, request.h);
+                transport.RecordBody(ctx);
+                if (parsed) {
+                    ctx.stage = LookupStage::ENRICH;
+                    if (StageEnrich(ctx)) {
+                        ctx.stage = LookupStage::DONE;
+                        ok = true;
+                    }
+                }
+            }
+        }
+    }
+
+    // 传输层失败时丢弃会话，避免下次继续复用已失效的连接
+    if (ctx.stage == LookupStage::CONNECT || ctx.stage == LookupStage::REQUEST) {
+        if (request.h) {
+            WinHttpCloseHandle(request.h);
+            request.h = nullptr;
+        }
+        transport.Reset();
+    } else {
+        transport.MarkUsed();
+    }
+
+    ctx.elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start);
+    return ok;
+}
+
+} // namespace iputils
@@ -0,0 +1,147 @@
+﻿/**
+ * @file lookup_pipeline.h
+ * @brief 外网IP查询流水线
+ * @details 将一次外网IP查询拆分为相互独立的阶段：
+ *          解析(RESOLVE) -> 连接(CONNECT) -> 请求(REQUEST) -> 流式读取并解析(STREAM_PARSE) -> 信息补全(ENRICH)
+ *          缓存策略不属于流水线，由调用方（ip_service.cpp）决定是否需要执行查询
+ * @author Lynn
+ * @date 2025
+ */
+
+#pragma once
+
+#include <string>
+#include <chrono>
+#include <mutex>
+#include <atomic>
+#include "ip_utils.h"
+#include "dns_cache.h"
+
+namespace iputils {
+
+/**
+ * @brief 查询流水线的阶段
+ */
+enum class LookupStage {
+    RESOLVE,        ///< 通过DNS缓存解析服务器地址
+    CONNECT,        ///< 复用或创建WinHTTP会话和连接
+    REQUEST,        ///< 发送HTTPS请求并接收响应头
+    STREAM_PARSE,   ///< 读取响应体并解析JSON字段
+    ENRICH,         ///< 转换编码并填充IpWithCountry
+    DONE            ///< 全部阶段执行成功
+};
+
+/**
+ * @brief 单次查询的上下文
+ * @details 在各阶段之间传递中间结果，查询失败时stage指示失败所在阶段
+ */
+struct LookupContext {
+    explicit LookupContext(const ExternalIpOptions& o) : opt(o) {}
+
+    ExternalIpOptions opt;                      ///< 本次查询使用的选项
+    bool ip_only = false;                       ///< 只请求纯文本IP（opt.ip_only_path），不获取国家和供应商
+    LookupStage stage = LookupStage::RESOLVE;   ///< 当前（或失败时所在的）阶段
+    size_t address_count = 0;                   ///< 服务器解析得到的地址数量（0表示未知）
+    unsigned long status_code = 0;              ///< HTTP状态码
+    std::string body;                           ///< 原始响应体（UTF-8）
+    std::string ip;                             ///< 解析出的IP字段（UTF-8）
+    std::string country;                        ///< 解析出的国家代码字段（UTF-8）
+    std::string org;                            ///< 解析出的org字段（UTF-8）
+    IpWithCountry result;                       ///< 最终结果
+    bool prewarmed = false;                     ///< 本次查询前连接是否已预热
+    bool reused_connection = false;             ///< 是否复用了已有连接
+    std::chrono::milliseconds ttfb{ 0 };        ///< 首字节时间（发送请求到收到响应头）
+    std::chrono::microseconds parse_time{ 0 };  ///< 响应体解析耗时
+    std::chrono::milliseconds elapsed{ 0 };     ///< 整个流水线耗时
+};
+
+/**
+ * @brief 跨查询复用的HTTPS传输
+ * @details 保持WinHTTP会话和连接句柄，使下一次查询可以复用会话内的keep-alive连接；
+ *          启用IPv6/IPv4快速回退（Happy Eyeballs，需要较新的Windows SDK和系统）
+ */
+class HttpTransport {
+public:
+    HttpTransport() = default;
+    ~HttpTransport();
+
+    HttpTransport(const HttpTransport&) = delete;
+    HttpTransport& operator=(const HttpTransport&) = delete;
+
+    /**
+     * @brief 确保已建立到指定主机的会话和连接句柄
+     * @return 连接句柄（HINTERNET），失败返回nullptr
+     */
+    void* Connect(const ExternalIpOptions& opt);
+
+    /**
+     * @brief 关闭会话和连接句柄，丢弃连接池中的所有连接
+     */
+    void Reset();
+
+    /**
+     * @brief 预热：提前完成TCP连接和TLS握手，使连接留在会话的连接池中
+     * @details 发送一个HEAD请求并只读取响应头
+     * @return true表示预热成功
+     */
+    bool Prewarm(const ExternalIpOptions& opt, DnsCache& dns);
+
+    /**
+     * @brief 连接空闲超过指定时间时关闭
+     * @return true表示关闭了连接
+     */
+    bool CloseIfIdle(std::chrono::milliseconds limit);
+
+    /**
+     * @brief 连接是否已打开且空闲超过指定时间（不加锁，可在UI线程调用）
+     */
+    bool IsIdleFor(std::chrono::milliseconds limit) const;
+
+    /**
+     * @brief 获取统计快照
+     */
+    TransportStats GetStats() const;
+
+    std::mutex& Mutex() { return mtx_; }
+
+private:
+    friend bool RunLookupPipeline(LookupContext& ctx, HttpTransport& transport, DnsCache& dns);
+
+    void MarkUsed();
+    void Record(const LookupContext& ctx);
+    void RecordBody(const LookupContext& ctx);
+
+    std::mutex mtx_;             ///< 保证同一时间只有一个查询使用传输
+    void* session_ = nullptr;    ///< WinHTTP会话句柄
+    void* connect_ = nullptr;    ///< WinHTTP连接句柄
+    std::wstring host_;          ///< 连接句柄对应的主机名
+    unsigned short port_ = 0;    ///< 连接句柄对应的端口
+    bool secure_ = true;         ///< 连接句柄是否用于HTTPS
+    bool prewarmed_ = false;     ///< 预热后尚未被查询使用
+
+    std::atomic<bool> open_{ false };                ///< 连接句柄是否存在
+    std::atomic<long long> last_used_{ 0 };          ///< 上次使用时间（steady_clock计数）
+
+    mutable std::mutex stats_mtx_;                   ///< 保护stats_，避免读取统计时等待查询完成
+    TransportStats stats_;
+};
+
+/**
+ * @brief 简单的JSON字段提取函数
+ * @param json JSON字符串
+ * @param field 要提取的字段名
+ * @return 字段值，如果未找到返回空字符串
+ * @details 简单实现，只处理字符串字段，格式："field":"value"
+ */
+std::string ExtractJsonField(const std::string& json, const std::string& field);
+
+/**
+ * @brief 依次执行查询流水线的所有阶段
+ * @param ctx 查询上下文
+ * @param transport 复用的HTTPS传输
+ * @param dns 服务器地址解析缓存
+ * @return true表示成功获取到有效IP（ctx.result有效），false表示某一阶段失败
+ */
+bool RunLookupPipeline(LookupContext& ctx, HttpTransport& transport, DnsCache& dns);
+
+} // namespace iputils
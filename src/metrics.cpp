@@ -0,0 +1,189 @@
+﻿/**
+ * @file metrics.cpp
+ * @brief 插件运行统计实现
+ * @author Lynn
+ * @date 2025
+ */
+
+#include "metrics.h"
+#include "ip_utils.h"
+
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+
+#include <windows.h>
+
+#include <cstdio>
+#include <cwchar>
+
+namespace metrics {
+
+namespace {
+
+/// 桶上界（微秒），0表示无上界
+const unsigned long long kBucketBounds[LatencyHistogram::kBuckets] = {
+    50, 100, 250, 500,
+    1000, 2500, 5000, 10000, 25000, 50000,
+    100000, 250000, 500000, 1000000, 2500000, 10000000,
+    0,
+};
+
+void AppendCounter(std::wstring& out, const wchar_t* name, const Counter& c) {
+    out += name;
+    out += L": ";
+    out += std::to_wstring(c.Value());
+    out += L"\r\n";
+}
+
+void AppendHistogram(std::wstring& out, const wchar_t* name, const LatencyHistogram& h) {
+    const unsigned long long n = h.Count();
+    out += name;
+    out += L": " + std::to_wstring(n) + L" 次";
+    if (n > 0) {
+        out += L", 平均 " + std::to_wstring(h.SumUs() / n) + L" us";
+        out += L", p50 ≤" + std::to_wstring(h.PercentileUs(0.50)) + L" us";
+        out += L", p99 ≤" + std::to_wstring(h.PercentileUs(0.99)) + L" us";
+        out += L", 最大 " + std::to_wstring(h.MaxUs()) + L" us";
+    }
+    out += L"\r\n";
+}
+
+void AppendProvider(std::wstring& out, const wchar_t* host, const ProviderMetrics& p) {
+    out += L"  ";
+    out += host;
+    out += L": 查询 " + std::to_wstring(p.lookups.Value()) + L", 失败 " + std::to_wstring(p.failures.Value());
+    AppendHistogram(out, L", 耗时", p.latency);
+}
+
+/// 保留一位小数
+std::wstring Fixed1(double v) {
+    wchar_t buf[32];
+    std::swprintf(buf, _countof(buf), L"%.1f", v);
+    return buf;
+}
+
+/**
+ * @brief 连接复用和预热效果（开启/关闭预热的首字节时间对比），以及纯文本IP和完整JSON查询的响应体大小和解析耗时
+ */
+void AppendTransport(std::wstring& out, const iputils::TransportStats& t) {
+    out += L"\r\n[连接]\r\n";
+    out += L"完成的查询: " + std::to_wstring(t.requests) + L"\r\n";
+    out += L"复用连接: " + std::to_wstring(t.reused_connections)
+        + L", 复用率 " + Fixed1(t.ReuseRate() * 100.0) + L"%\r\n";
+    out += L"预热: " + std::to_wstring(t.prewarms) + L" 次, 空闲关闭: " + std::to_wstring(t.idle_closes) + L" 次\r\n";
+    out += L"首字节时间（预热后）: " + std::to_wstring(t.warm_requests) + L" 次";
+    if (t.warm_requests) out += L", 平均 " + Fixed1(t.WarmTtfbMs()) + L" ms";
+    out += L"\r\n";
+    out += L"首字节时间（未预热）: " + std::to_wstring(t.cold_requests) + L" 次";
+    if (t.cold_requests) out += L", 平均 " + Fixed1(t.ColdTtfbMs()) + L" ms";
+    out += L"\r\n";
+    out += L"纯文本IP查询: " + std::to_wstring(t.ip_only_requests)
+        + L", 完整JSON查询: " + std::to_wstring(t.full_requests) + L"\r\n";
+    out += L"每次查询响应体: " + Fixed1(t.BytesPerRequest()) + L" 字节, 解析 "
+        + Fixed1(t.ParseUsPerRequest()) + L" us\r\n";
+}
+
+} // namespace
+
+void LatencyHistogram::RecordUs(long long value) {
+    const unsigned long long us = value > 0 ? static_cast<unsigned long long>(value) : 0;
+    int i = 0;
+    while (i < kBuckets - 1 && us > kBucketBounds[i]) ++i;
+    buckets_[i].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    sum_us_.fetch_add(us, std::memory_order_relaxed);
+    unsigned long long prev = max_us_.load(std::memory_order_relaxed);
+    while (us > prev && !max_us_.compare_exchange_weak(prev, us, std::memory_order_relaxed)) {
+    }
+}
+
+unsigned long long LatencyHistogram::PercentileUs(double p) const {
+    const unsigned long long n = Count();
+    if (n == 0) return 0;
+    const unsigned long long target = static_cast<unsigned long long>(p * n + 0.5);
+    unsigned long long seen = 0;
+    for (int i = 0; i < kBuckets - 1; ++i) {
+        seen += BucketCount(i);
+        if (seen >= target && seen > 0) return kBucketBounds[i];
+    }
+    return MaxUs();
+}
+
+unsigned long long LatencyHistogram::BucketBoundUs(int i) {
+    return kBucketBounds[i];
+}
+
+ProviderMetrics& Registry::Provider(const wchar_t* host) {
+    if (!host) return other_provider;
+    for (auto& p : providers) {
+        const wchar_t* current = p.host.load(std::memory_order_acquire);
+        if (!current) {
+            // 登记到空槽；其他线程抢先登记时按它登记的主机重新比较
+            if (p.host.compare_exchange_strong(current, host, std::memory_order_acq_rel)) return p;
+        }
+        if (current == host || std::wcscmp(current, host) == 0) return p;
+    }
+    return other_provider;
+}
+
+unsigned long long Registry::TotalLookups() const {
+    unsigned long long total = other_provider.lookups.Value();
+    for (const auto& p : providers) total += p.lookups.Value();
+    return total;
+}
+
+Registry& Global() {
+    static Registry registry;  // 只含原子变量，析构时没有任何操作
+    return registry;
+}
+
+std::wstring Format(const Registry& r, const iputils::TransportStats* transport) {
+    std::wstring out;
+    out.reserve(2048);
+    out += L"[网络状态]\r\n";
+    AppendCounter(out, L"适配器枚举", r.adapter_enumerations);
+    AppendCounter(out, L"默认路由查询", r.route_queries);
+    AppendCounter(out, L"DNS查询", r.dns_queries);
+    AppendCounter(out, L"往返时延探测", r.rtt_probes);
+
+    out += L"\r\n[外网查询]\r\n";
+    AppendCounter(out, L"缓存命中", r.cache_hits);
+    AppendCounter(out, L"缓存未命中", r.cache_misses);
+    const unsigned long long total = r.cache_hits.Value() + r.cache_misses.Value();
+    if (total > 0) {
+        out += L"缓存命中率: " + std::to_wstring(r.cache_hits.Value() * 100 / total) + L"%\r\n";
+    }
+    AppendCounter(out, L"跳过的查询", r.lookups_skipped);
+    AppendCounter(out, L"响应体字节", r.bytes_received);
+    out += L"按服务器:\r\n";
+    for (const auto& p : r.providers) {
+        const wchar_t* host = p.host.load(std::memory_order_acquire);
+        if (host) AppendProvider(out, host, p);
+    }
+    if (r.other_provider.lookups.Value() > 0) AppendProvider(out, L"(其他)", r.other_provider);
+    if (transport) AppendTransport(out, *transport);
+
+    out += L"\r\n[显示]\r\n";
+    AppendCounter(out, L"显示文本重建", r.rebuilds);
+    AppendCounter(out, L"工具提示生成", r.tooltips);
+    AppendHistogram(out, L"刷新耗时", r.update_time);
+    AppendHistogram(out, L"绘制耗时", r.paint_time);
+    return out;
+}
+
+bool DumpToFile(const Registry& r, const std::wstring& path, const iputils::TransportStats* transport) {
+    const std::wstring text = L"\xFEFF" + Format(r, transport);
+    HANDLE file = ::CreateFileW(path.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return false;
+    const DWORD bytes = static_cast<DWORD>(text.size() * sizeof(wchar_t));
+    DWORD written = 0;
+    const bool ok = ::WriteFile(file, text.data(), bytes, &written, nullptr) && written == bytes;
+    ::CloseHandle(file);
+    return ok;
+}
+
+} // namespace metrics
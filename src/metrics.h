@@ -0,0 +1,129 @@
+﻿/**
+ * @file metrics.h
+ * @brief 插件运行统计
+ * @details 进程内唯一的统计表，只由原子计数器和固定分桶的耗时直方图组成，
+ *          记录时不加锁、不分配内存，刷新路径上的开销只有几次原子加法；
+ *          统计结果用于工具提示和"导出诊断信息"命令
+ * @author Lynn
+ * @date 2025
+ */
+
+#pragma once
+
+#include <string>
+#include <atomic>
+#include <chrono>
+
+namespace iputils {
+struct TransportStats;
+}
+
+namespace metrics {
+
+/**
+ * @brief 原子计数器
+ */
+class Counter {
+public:
+    void Add(unsigned long long n = 1) { value_.fetch_add(n, std::memory_order_relaxed); }
+    unsigned long long Value() const { return value_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<unsigned long long> value_{ 0 };
+};
+
+/**
+ * @brief 固定分桶的耗时直方图（微秒）
+ * @details 桶上界按1-2.5-5递增，从50微秒到10秒，最后一个桶收纳更大的值；
+ *          分位数按所在桶的上界估算
+ */
+class LatencyHistogram {
+public:
+    static constexpr int kBuckets = 17;
+
+    void RecordUs(long long us);
+    template <class Rep, class Period>
+    void Record(std::chrono::duration<Rep, Period> d) {
+        RecordUs(static_cast<long long>(std::chrono::duration_cast<std::chrono::microseconds>(d).count()));
+    }
+
+    unsigned long long Count() const { return count_.load(std::memory_order_relaxed); }
+    unsigned long long SumUs() const { return sum_us_.load(std::memory_order_relaxed); }
+    unsigned long long MaxUs() const { return max_us_.load(std::memory_order_relaxed); }
+    /// 估算的分位数（微秒），没有样本时返回0
+    unsigned long long PercentileUs(double p) const;
+    /// 第i个桶的上界（微秒），最后一个桶返回0表示无上界
+    static unsigned long long BucketBoundUs(int i);
+    unsigned long long BucketCount(int i) const { return buckets_[i].load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<unsigned long long> buckets_[kBuckets] = {};
+    std::atomic<unsigned long long> count_{ 0 };
+    std::atomic<unsigned long long> sum_us_{ 0 };
+    std::atomic<unsigned long long> max_us_{ 0 };
+};
+
+/**
+ * @brief 按服务器主机名分类的查询统计
+ */
+struct ProviderMetrics {
+    std::atomic<const wchar_t*> host{ nullptr };    ///< 主机名（字符串常量，首次查询时登记）
+    Counter lookups;                                 ///< 查询次数
+    Counter failures;                                ///< 失败次数
+    LatencyHistogram latency;                        ///< 查询耗时
+};
+
+/**
+ * @brief 统计表
+ */
+struct Registry {
+    static constexpr int kMaxProviders = 8;
+
+    // === 网络状态 ===
+    Counter adapter_enumerations;       ///< GetAdaptersAddresses枚举次数
+    Counter route_queries;              ///< GetBestRoute2查询次数
+    Counter dns_queries;                ///< DnsQuery查询次数
+    Counter rtt_probes;                 ///< 往返时延探测轮数
+
+    // === 外网查询 ===
+    Counter cache_hits;                 ///< 刷新时直接使用缓存的次数
+    Counter cache_misses;               ///< 刷新时需要查询的次数
+    Counter lookups_skipped;            ///< 已有查询在执行或网络不可用而跳过的次数
+    Counter bytes_received;             ///< 响应体字节数
+    ProviderMetrics providers[kMaxProviders];
+    ProviderMetrics other_provider;     ///< 超出登记上限的主机
+
+    // === 显示 ===
+    Counter rebuilds;                   ///< 显示文本重建次数
+    Counter tooltips;                   ///< 工具提示生成次数
+    LatencyHistogram update_time;       ///< 每次刷新（DataRequired）的耗时
+    LatencyHistogram paint_time;        ///< 每次绘制（DrawItem）的耗时
+
+    /**
+     * @brief 取得主机对应的查询统计（不加锁，首次出现时登记到空槽）
+     */
+    ProviderMetrics& Provider(const wchar_t* host);
+
+    /// 所有主机的查询次数合计
+    unsigned long long TotalLookups() const;
+};
+
+/**
+ * @brief 进程内唯一的统计表
+ */
+Registry& Global();
+
+/**
+ * @brief 把统计表格式化为多行文本
+ * @param transport 外网查询传输层统计（iputils::GetTransportStats()），nullptr表示不输出连接部分
+ */
+std::wstring Format(const Registry& r, const iputils::TransportStats* transport = nullptr);
+
+/**
+ * @brief 把统计表写入文件（UTF-16LE，带BOM）
+ * @param transport 同Format
+ * @return true表示写入成功
+ */
+bool DumpToFile(const Registry& r, const std::wstring& path, const iputils::TransportStats* transport = nullptr);
+
+} // namespace metrics
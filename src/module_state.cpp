@@ -0,0 +1,45 @@
+﻿/**
+ * @file module_state.cpp
+ * @brief 插件模块的卸载状态实现
+ * @author Lynn
+ * @date 2025
+ */
+
+#include "module_state.h"
+
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+
+#include <windows.h>
+#include <atomic>
+
+namespace iputils {
+
+namespace {
+
+std::atomic<bool> g_pinned{ false };
+std::atomic<bool> g_detaching{ false };
+
+} // namespace
+
+void PinModule() {
+    if (g_pinned.exchange(true)) return;
+    HMODULE module = nullptr;
+    // 按本函数的地址取所在模块（插件DLL或测试程序本身）
+    ::GetModuleHandleExW(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS | GET_MODULE_HANDLE_EX_FLAG_PIN,
+                         reinterpret_cast<LPCWSTR>(&PinModule), &module);
+}
+
+void MarkModuleDetaching() {
+    g_detaching.store(true);
+}
+
+bool IsModuleDetaching() {
+    return g_detaching.load();
+}
+
+} // namespace iputils
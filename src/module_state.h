@@ -0,0 +1,33 @@
+﻿/**
+ * @file module_state.h
+ * @brief 插件模块的卸载状态
+ * @details 插件实例是TMPluginGetInstance中的函数内静态对象，它的析构函数在DLL_PROCESS_DETACH期间、
+ *          持有加载器锁时运行。此时等待工作线程退出会死锁（线程退出需要加载器锁），
+ *          因此各后台线程在创建前固定模块，使FreeLibrary不会卸载仍有线程在运行的DLL；
+ *          DLL_PROCESS_DETACH只会在进程退出时发生，其他线程已被系统终止，析构时分离线程、不再等待
+ * @author Lynn
+ * @date 2025
+ */
+
+#pragma once
+
+namespace iputils {
+
+/**
+ * @brief 固定当前模块，直到进程退出都不卸载
+ * @details 创建后台线程或注册系统回调前调用，只在第一次调用时生效；在可执行程序中调用没有影响
+ */
+void PinModule();
+
+/**
+ * @brief 标记模块正在卸载（由DllMain在DLL_PROCESS_DETACH时调用）
+ */
+void MarkModuleDetaching();
+
+/**
+ * @brief 模块是否正在卸载
+ * @details 为true时析构函数运行在加载器锁下，不能等待线程、取消系统回调或关闭WinHTTP句柄
+ */
+bool IsModuleDetaching();
+
+} // namespace iputils
@@ -0,0 +1,384 @@
+﻿/**
+ * @file net_fixture.cpp
+ * @brief 网络状态录制和回放实现
+ * @details 文件格式（UTF-8，#开头的行为注释，时间为相对录制开始的毫秒数）：
+ *            <ms> snapshot
+ *              adapter <luid> <if_index> <if_type> <up> <adapter_name> <friendly_name>
+ *              addr <ip> <prefix_len> <flags>      （flags：-、t临时、d弃用，可组合）
+ *              gateway <ip>
+ *              dns <ip>
+ *            <ms> route <valid> <luid> <source_ip> <gateway>
+ *            <ms> response <v4|v6> <latency_ms> <ok> <ip> <country> <org>
+ *            <ms> end
+ *          缩进的行属于前面最近的snapshot，空字段写作-
+ * @author Lynn
+ * @date 2025
+ */
+
+#include "net_fixture.h"
+
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+
+#include <windows.h>
+#include <winsock2.h>
+#include <ws2tcpip.h>
+
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <cwchar>
+#include <sstream>
+
+#pragma comment(lib, "Ws2_32.lib")
+
+namespace iputils {
+
+namespace {
+
+const wchar_t kHeader[] = L"# tm_ip_plugin network fixture v1\n";
+
+/// 空字段写作"-"
+std::wstring Field(const std::wstring& s) {
+    return s.empty() ? L"-" : s;
+}
+
+std::wstring Unfield(const std::wstring& s) {
+    return s == L"-" ? std::wstring() : s;
+}
+
+/// 读取行内剩余部分（去掉开头的空白）
+std::wstring Rest(std::wistringstream& in) {
+    std::wstring rest;
+    std::getline(in, rest);
+    size_t start = rest.find_first_not_of(L" \t");
+    return start == std::wstring::npos ? std::wstring() : rest.substr(start);
+}
+
+bool ParseAddress(const std::wstring& text, AdapterAddress& out) {
+    out.family = text.find(L':') != std::wstring::npos ? AF_INET6 : AF_INET;
+    if (InetPtonW(out.family, text.c_str(), out.bytes) != 1) return false;
+    out.text = text;
+    return true;
+}
+
+void WriteAddressLine(std::wstring& out, const wchar_t* kind, const AdapterAddress& a) {
+    out += L"  ";
+    out += kind;
+    out += L" " + a.text + L"\n";
+}
+
+bool IsV6Request(const LookupContext& ctx) {
+    return ctx.opt.host_v6 && ctx.opt.host && std::wcscmp(ctx.opt.host, ctx.opt.host_v6) == 0;
+}
+
+bool SameRoute(const DefaultRoute& a, const DefaultRoute& b) {
+    return a.valid == b.valid && a.luid == b.luid && a.source_ip == b.source_ip && a.gateway == b.gateway;
+}
+
+/// 按时间查找最后一个at_ms不大于now的元素，不存在时返回end
+template <typename T>
+typename std::vector<T>::const_iterator FindAt(const std::vector<T>& list, long long now) {
+    auto it = std::upper_bound(list.begin(), list.end(), now,
+                               [](long long t, const T& e) { return t < e.at_ms; });
+    return it == list.begin() ? list.end() : it - 1;
+}
+
+} // namespace
+
+bool SaveFixture(const std::wstring& path, const NetworkFixture& fixture) {
+    std::wstring out = kHeader;
+    // 三类事件按时间合并输出，便于阅读
+    size_t si = 0, ri = 0, pi = 0;
+    for (;;) {
+        long long ts = si < fixture.snapshots.size() ? fixture.snapshots[si].at_ms : LLONG_MAX;
+        long long tr = ri < fixture.routes.size() ? fixture.routes[ri].at_ms : LLONG_MAX;
+        long long tp = pi < fixture.responses.size() ? fixture.responses[pi].at_ms : LLONG_MAX;
+        long long t = std::min(ts, std::min(tr, tp));
+        if (t == LLONG_MAX) break;
+
+        if (t == ts) {
+            const AdapterSnapshot& s = *fixture.snapshots[si++].snapshot;
+            out += std::to_wstring(t) + L" snapshot\n";
+            for (const auto& a : s.adapters) {
+                out += L"  adapter " + std::to_wstring(a.luid) + L" " + std::to_wstring(a.if_index) + L" "
+                    + std::to_wstring(a.if_type) + L" " + (a.is_up ? L"1" : L"0") + L" "
+                    + Field(a.adapter_name) + L" " + Field(a.friendly_name) + L"\n";
+                for (const auto& addr : a.addresses) {
+                    std::wstring flags = addr.temporary ? L"t" : L"";
+                    if (addr.deprecated) flags += L"d";
+                    out += L"  addr " + addr.text + L" " + std::to_wstring(addr.prefix_len) + L" " + Field(flags) + L"\n";
+                }
+                for (const auto& gw : a.gateways) WriteAddressLine(out, L"gateway", gw);
+                for (const auto& dns : a.dns_servers) WriteAddressLine(out, L"dns", dns);
+            }
+        } else if (t == tr) {
+            const DefaultRoute& r = fixture.routes[ri++].route;
+            out += std::to_wstring(t) + L" route " + (r.valid ? L"1 " : L"0 ") + std::to_wstring(r.luid) + L" "
+                + Field(r.source_ip) + L" " + Field(r.gateway) + L"\n";
+        } else {
+            const FixtureResponse& r = fixture.responses[pi++];
+            out += std::to_wstring(t) + L" response " + (r.v6 ? L"v6 " : L"v4 ") + std::to_wstring(r.latency_ms)
+                + (r.ok ? L" 1 " : L" 0 ") + Field(r.result.ip) + L" " + Field(r.result.country) + L" "
+                + Field(r.result.as_name) + L"\n";
+        }
+    }
+    out += std::to_wstring(fixture.duration_ms) + L" end\n";
+
+    int len = WideCharToMultiByte(CP_UTF8, 0, out.c_str(), (int)out.size(), nullptr, 0, nullptr, nullptr);
+    std::string utf8(len, '\0');
+    WideCharToMultiByte(CP_UTF8, 0, out.c_str(), (int)out.size(), &utf8[0], len, nullptr, nullptr);
+
+    FILE* f = nullptr;
+    if (_wfopen_s(&f, path.c_str(), L"wb") != 0 || !f) return false;
+    bool ok = std::fwrite(utf8.data(), 1, utf8.size(), f) == utf8.size();
+    ok = std::fclose(f) == 0 && ok;
+    return ok;
+}
+
+bool LoadFixture(const std::wstring& path, NetworkFixture& fixture) {
+    FILE* f = nullptr;
+    if (_wfopen_s(&f, path.c_str(), L"rb") != 0 || !f) return false;
+    std::string utf8;
+    char buf[64 * 1024];
+    size_t n = 0;
+    while ((n = std::fread(buf, 1, sizeof(buf), f)) > 0) utf8.append(buf, n);
+    std::fclose(f);
+
+    std::wstring text;
+    int len = MultiByteToWideChar(CP_UTF8, 0, utf8.data(), (int)utf8.size(), nullptr, 0);
+    if (len > 0) {
+        text.resize(len);
+        MultiByteToWideChar(CP_UTF8, 0, utf8.data(), (int)utf8.size(), &text[0], len);
+    }
+
+    fixture = NetworkFixture();
+    std::shared_ptr<AdapterSnapshot> current;  // 正在读取的快照
+    AdapterEntry* adapter = nullptr;           // 正在读取的适配器
+    auto finish_snapshot = [&]() {
+        if (!current) return;
+        current->version = static_cast<unsigned long>(fixture.snapshots.size() + 1);
+        current->fingerprint = ComputeFingerprint(*current);
+        fixture.snapshots.back().snapshot = std::move(current);
+        current.reset();
+        adapter = nullptr;
+    };
+
+    std::wistringstream lines(text);
+    std::wstring line;
+    while (std::getline(lines, line)) {
+        if (!line.empty() && line.back() == L'\r') line.pop_back();
+        if (line.empty() || line[0] == L'#') continue;
+        std::wistringstream in(line);
+        const bool nested = line[0] == L' ' || line[0] == L'\t';
+
+        if (nested) {
+            if (!current) continue;
+            std::wstring kind;
+            in >> kind;
+            if (kind == L"adapter") {
+                AdapterEntry entry;
+                int up = 0;
+                std::wstring adapter_name;
+                in >> entry.luid >> entry.if_index >> entry.if_type >> up >> adapter_name;
+                if (!in) continue;
+                entry.is_up = up != 0;
+                entry.adapter_name = Unfield(adapter_name);
+                entry.friendly_name = Unfield(Rest(in));
+                current->adapters.push_back(std::move(entry));
+                adapter = &current->adapters.back();
+                continue;
+            }
+            if (!adapter) continue;
+            std::wstring ip;
+            in >> ip;
+            AdapterAddress addr;
+            if (!ParseAddress(ip, addr)) continue;
+            if (kind == L"addr") {
+                int prefix = 0;
+                std::wstring flags;
+                in >> prefix >> flags;
+                addr.prefix_len = static_cast<unsigned char>(prefix);
+                addr.temporary = flags.find(L't') != std::wstring::npos;
+                addr.deprecated = flags.find(L'd') != std::wstring::npos;
+                adapter->addresses.push_back(std::move(addr));
+            } else if (kind == L"gateway") {
+                adapter->gateways.push_back(std::move(addr));
+            } else if (kind == L"dns") {
+                adapter->dns_servers.push_back(std::move(addr));
+            }
+            continue;
+        }
+
+        finish_snapshot();
+        long long at = 0;
+        std::wstring kind;
+        in >> at >> kind;
+        if (!in) continue;
+        if (kind == L"snapshot") {
+            current = std::make_shared<AdapterSnapshot>();
+            FixtureSnapshot s;
+            s.at_ms = at;
+            fixture.snapshots.push_back(s);
+        } else if (kind == L"route") {
+            FixtureRoute r;
+            int valid = 0;
+            std::wstring source, gateway;
+            in >> valid >> r.route.luid >> source >> gateway;
+            if (!in) continue;
+            r.at_ms = at;
+            r.route.valid = valid != 0;
+            r.route.source_ip = Unfield(source);
+            r.route.gateway = Unfield(gateway);
+            fixture.routes.push_back(r);
+        } else if (kind == L"response") {
+            FixtureResponse r;
+            std::wstring family, ip, country;
+            int ok = 0;
+            in >> family >> r.latency_ms >> ok >> ip >> country;
+            if (!in) continue;
+            r.at_ms = at;
+            r.v6 = family == L"v6";
+            r.ok = ok != 0;
+            r.result.ip = Unfield(ip);
+            r.result.country = Unfield(country);
+            r.result.as_name = Unfield(Rest(in));
+            fixture.responses.push_back(r);
+        } else if (kind == L"end") {
+            fixture.duration_ms = at;
+        }
+    }
+    finish_snapshot();
+    // 没有快照的行（格式错误）不保留
+    fixture.snapshots.erase(std::remove_if(fixture.snapshots.begin(), fixture.snapshots.end(),
+                                           [](const FixtureSnapshot& s) { return !s.snapshot; }),
+                            fixture.snapshots.end());
+    return true;
+}
+
+// === 录制 ===
+
+long long FixtureRecorder::ElapsedMs(std::chrono::steady_clock::time_point t) const {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(t - start_).count();
+}
+
+void FixtureRecorder::RecordNetwork(const std::shared_ptr<const AdapterSnapshot>& snapshot, const DefaultRoute& route) {
+    const long long now = ElapsedMs(std::chrono::steady_clock::now());
+    std::lock_guard<std::mutex> lk(mtx_);
+    if (snapshot && snapshot->version != last_version_) {
+        last_version_ = snapshot->version;
+        FixtureSnapshot s;
+        s.at_ms = now;
+        s.snapshot = snapshot;
+        fixture_.snapshots.push_back(s);
+    }
+    if (fixture_.routes.empty() || !SameRoute(fixture_.routes.back().route, route)) {
+        FixtureRoute r;
+        r.at_ms = now;
+        r.route = route;
+        fixture_.routes.push_back(r);
+    }
+}
+
+void FixtureRecorder::RecordResponse(const LookupContext& ctx, bool v6, bool ok, std::chrono::steady_clock::time_point started) {
+    FixtureResponse r;
+    r.v6 = v6;
+    r.ok = ok;
+    r.latency_ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - started).count();
+    if (ok) r.result = ctx.result;
+    std::lock_guard<std::mutex> lk(mtx_);
+    r.at_ms = ElapsedMs(started);
+    // 工作线程上的查询可能晚于之后的网络事件写入，按时间插入保持有序
+    auto it = std::upper_bound(fixture_.responses.begin(), fixture_.responses.end(), r.at_ms,
+                               [](long long t, const FixtureResponse& e) { return t < e.at_ms; });
+    fixture_.responses.insert(it, r);
+}
+
+NetworkFixture FixtureRecorder::Finish() {
+    const long long now = ElapsedMs(std::chrono::steady_clock::now());
+    std::lock_guard<std::mutex> lk(mtx_);
+    fixture_.duration_ms = now;
+    return fixture_;
+}
+
+// === 回放 ===
+
+std::shared_ptr<const AdapterSnapshot> FixtureReplay::Snapshot() {
+    auto it = FindAt(fixture_.snapshots, clock_.ElapsedMs());
+    const size_t index = it == fixture_.snapshots.end() ? static_cast<size_t>(-1)
+                                                        : static_cast<size_t>(it - fixture_.snapshots.begin());
+    if (!resolved_ || index != snapshot_index_ || preferred_dirty_) {
+        auto snapshot = index == static_cast<size_t>(-1) ? std::make_shared<AdapterSnapshot>()
+                                                         : std::make_shared<AdapterSnapshot>(*it->snapshot);
+        snapshot->version = ++version_;
+        snapshot->preferred_name = preferred_;
+        const AdapterEntry* a = snapshot->FindByName(preferred_);
+        snapshot->preferred_index = a ? static_cast<size_t>(a - snapshot->adapters.data()) : AdapterSnapshot::npos;
+        resolved_ = std::move(snapshot);
+        snapshot_index_ = index;
+        preferred_dirty_ = false;
+    }
+    return resolved_;
+}
+
+void FixtureReplay::SetPreferred(const std::wstring& name) {
+    if (name == preferred_) return;
+    preferred_ = name;
+    preferred_dirty_ = true;
+}
+
+std::shared_ptr<const DefaultRoute> FixtureReplay::Route() {
+    auto it = FindAt(fixture_.routes, clock_.ElapsedMs());
+    const size_t index = it == fixture_.routes.end() ? static_cast<size_t>(-1)
+                                                     : static_cast<size_t>(it - fixture_.routes.begin());
+    if (!route_ || index != route_index_) {
+        route_ = index == static_cast<size_t>(-1) ? std::make_shared<DefaultRoute>()
+                                                  : std::make_shared<DefaultRoute>(it->route);
+        route_index_ = index;
+    }
+    return route_;
+}
+
+const FixtureResponse* FixtureReplay::CurrentResponse(bool v6) const {
+    const long long now = clock_.ElapsedMs();
+    const FixtureResponse* found = nullptr;
+    for (const auto& r : fixture_.responses) {
+        if (r.v6 != v6) continue;
+        if (r.at_ms > now && found) break;
+        found = &r;  // 当前时间之前没有应答时使用第一条
+        if (r.at_ms > now) break;
+    }
+    return found;
+}
+
+long long FixtureReplay::CurrentLatencyMs(bool v6) const {
+    const FixtureResponse* r = CurrentResponse(v6);
+    return r ? r->latency_ms : 0;
+}
+
+bool FixtureReplay::Lookup(LookupContext& ctx) {
+    const bool v6 = IsV6Request(ctx);
+    if (v6) ++requests_v6_;
+    else ++requests_;
+
+    const FixtureResponse* r = CurrentResponse(v6);
+    ctx.elapsed = std::chrono::milliseconds(r ? r->latency_ms : 0);
+    if (!r || !r->ok || !r->result.IsValid()) {
+        ctx.stage = LookupStage::REQUEST;
+        return false;
+    }
+    ctx.result.ip = r->result.ip;
+    if (!ctx.ip_only) {
+        ctx.result.country = r->result.country;
+        ctx.result.as_name = r->result.as_name;
+    }
+    ctx.status_code = 200;
+    ctx.stage = LookupStage::DONE;
+    return true;
+}
+
+} // namespace iputils
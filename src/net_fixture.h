@@ -0,0 +1,157 @@
+﻿/**
+ * @file net_fixture.h
+ * @brief 网络状态录制和回放
+ * @details 录制适配器快照、默认路由变化和外网查询应答（带时间和耗时）到文本文件，
+ *          回放时作为IpService的网络状态来源和查询后端，配合虚拟时钟在毫秒级时间内
+ *          重放长时间的网络变化，用于统计请求次数、显示变化次数和变化反映到显示的延迟
+ * @author Lynn
+ * @date 2025
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <chrono>
+#include "ip_service.h"
+
+namespace iputils {
+
+/**
+ * @brief 录制的适配器快照
+ */
+struct FixtureSnapshot {
+    long long at_ms = 0;                                ///< 相对录制开始的时间（毫秒）
+    std::shared_ptr<const AdapterSnapshot> snapshot;    ///< 快照内容（version和fingerprint在加载时重新生成）
+};
+
+/**
+ * @brief 录制的默认路由
+ */
+struct FixtureRoute {
+    long long at_ms = 0;    ///< 相对录制开始的时间（毫秒）
+    DefaultRoute route;     ///< 路由内容
+};
+
+/**
+ * @brief 录制的外网查询应答
+ */
+struct FixtureResponse {
+    long long at_ms = 0;        ///< 发起查询的时间（毫秒）
+    bool v6 = false;            ///< 是否为外网IPv6查询
+    long long latency_ms = 0;   ///< 查询耗时（毫秒）
+    bool ok = false;            ///< 查询是否成功
+    IpWithCountry result;       ///< 查询结果（失败时为空）
+};
+
+/**
+ * @brief 一段录制数据（各列表按时间排序）
+ */
+struct NetworkFixture {
+    std::vector<FixtureSnapshot> snapshots;
+    std::vector<FixtureRoute> routes;
+    std::vector<FixtureResponse> responses;
+    long long duration_ms = 0;  ///< 录制总时长（毫秒）
+};
+
+/**
+ * @brief 把录制数据写入文件（UTF-8文本，每行一个事件）
+ * @return true表示写入成功
+ */
+bool SaveFixture(const std::wstring& path, const NetworkFixture& fixture);
+
+/**
+ * @brief 从文件加载录制数据
+ * @return true表示加载成功；格式错误的行被忽略
+ */
+bool LoadFixture(const std::wstring& path, NetworkFixture& fixture);
+
+/**
+ * @brief 虚拟时钟
+ * @details 从一个非零的时间点开始，只在Advance时前进（IpService用零值表示"从未"）
+ */
+class VirtualClock {
+public:
+    using time_point = std::chrono::steady_clock::time_point;
+
+    time_point Now() const { return start_ + elapsed_; }
+    void Advance(std::chrono::milliseconds d) { elapsed_ += d; }
+    /// 相对起点经过的时间（毫秒）
+    long long ElapsedMs() const { return elapsed_.count(); }
+
+private:
+    time_point start_ = time_point(std::chrono::hours(1));
+    std::chrono::milliseconds elapsed_{ 0 };
+};
+
+/**
+ * @brief 录制器
+ * @details RecordNetwork在每次刷新时调用，只在快照版本或路由变化时记录；
+ *          RecordResponse可在工作线程上调用
+ */
+class FixtureRecorder {
+public:
+    FixtureRecorder() : start_(std::chrono::steady_clock::now()) {}
+
+    void RecordNetwork(const std::shared_ptr<const AdapterSnapshot>& snapshot, const DefaultRoute& route);
+    void RecordResponse(const LookupContext& ctx, bool v6, bool ok, std::chrono::steady_clock::time_point started);
+
+    /**
+     * @brief 结束录制并取得录制数据
+     */
+    NetworkFixture Finish();
+
+private:
+    long long ElapsedMs(std::chrono::steady_clock::time_point t) const;
+
+    std::mutex mtx_;
+    std::chrono::steady_clock::time_point start_;
+    unsigned long last_version_ = 0;
+    NetworkFixture fixture_;
+};
+
+/**
+ * @brief 回放器
+ * @details 作为IpService的网络状态来源和查询后端，按虚拟时钟返回当时的快照、路由和应答
+ */
+class FixtureReplay : public NetworkSource {
+public:
+    FixtureReplay(const NetworkFixture& fixture, const VirtualClock& clock) : fixture_(fixture), clock_(clock) {}
+
+    // === NetworkSource ===
+    std::shared_ptr<const AdapterSnapshot> Snapshot() override;
+    void SetPreferred(const std::wstring& name) override;
+    std::shared_ptr<const DefaultRoute> Route() override;
+
+    /**
+     * @brief 查询后端：返回当前时间之前最近一次录制的同类应答
+     */
+    bool Lookup(LookupContext& ctx);
+
+    /**
+     * @brief 当前时间发起查询时应答的耗时（毫秒），用于决定何时完成排队的查询
+     */
+    long long CurrentLatencyMs(bool v6) const;
+
+    unsigned long RequestCount() const { return requests_; }
+    unsigned long RequestCountV6() const { return requests_v6_; }
+
+private:
+    const FixtureResponse* CurrentResponse(bool v6) const;
+
+    const NetworkFixture& fixture_;
+    const VirtualClock& clock_;
+    size_t snapshot_index_ = static_cast<size_t>(-1);   ///< resolved_对应的录制快照下标
+    std::wstring preferred_;
+    bool preferred_dirty_ = false;
+    unsigned long version_ = 0;                         ///< 对外快照版本号
+    std::shared_ptr<const AdapterSnapshot> resolved_;   ///< 已解析首选适配器的当前快照
+    size_t route_index_ = static_cast<size_t>(-1);      ///< route_对应的录制路由下标
+    std::shared_ptr<const DefaultRoute> route_;         ///< 当前路由
+    unsigned long requests_ = 0;
+    unsigned long requests_v6_ = 0;
+};
+
+} // namespace iputils
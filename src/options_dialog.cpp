@@ -2,82 +2,17 @@
 
 #include "options_dialog.h"
 #include <string>
-#include <vector>
+#include <memory>
 #include <windows.h>
-#include <winsock2.h>
-#include <iphlpapi.h>
+#include "ip_utils.h"
 
 extern HINSTANCE g_hInst; // from dllmain
 
 #include "../res/resource.h"
 
-#pragma comment(lib, "Iphlpapi.lib")
-
 static void SetCheck(HWND hDlg, int id, bool v) { CheckDlgButton(hDlg, id, v ? BST_CHECKED : BST_UNCHECKED); }
 static bool GetCheck(HWND hDlg, int id) { return IsDlgButtonChecked(hDlg, id) == BST_CHECKED; }
 
-// Structure to hold adapter information
-struct AdapterInfo {
-    std::wstring friendlyName;
-    std::wstring adapterName;
-    std::wstring displayName;
-    bool isUp;
-};
-
-// Get list of network adapters
-static std::vector<AdapterInfo> GetNetworkAdapters() {
-    std::vector<AdapterInfo> adapters;
-    
-    ULONG flags = GAA_FLAG_INCLUDE_PREFIX;
-    ULONG family = AF_INET; // IPv4 only
-    ULONG size = 15 * 1024;
-    
-    std::vector<BYTE> buffer(size);
-    IP_ADAPTER_ADDRESSES* addrs = reinterpret_cast<IP_ADAPTER_ADDRESSES*>(buffer.data());
-    
-    ULONG ret = GetAdaptersAddresses(family, flags, nullptr, addrs, &size);
-    if (ret == ERROR_BUFFER_OVERFLOW) {
-        buffer.resize(size);
-        addrs = reinterpret_cast<IP_ADAPTER_ADDRESSES*>(buffer.data());
-        ret = GetAdaptersAddresses(family, flags, nullptr, addrs, &size);
-    }
-    
-    if (ret == NO_ERROR) {
-        for (auto a = addrs; a; a = a->Next) {
-            if (a->IfType == IF_TYPE_SOFTWARE_LOOPBACK) continue; // Skip loopback
-            
-            AdapterInfo info;
-            info.friendlyName = a->FriendlyName ? a->FriendlyName : L"";
-            
-            // Convert AdapterName from multibyte to wide string
-            if (a->AdapterName) {
-                int len = MultiByteToWideChar(CP_UTF8, 0, a->AdapterName, -1, nullptr, 0);
-                if (len > 0) {
-                    info.adapterName.resize(len - 1);
-                    MultiByteToWideChar(CP_UTF8, 0, a->AdapterName, -1, const_cast<wchar_t*>(info.adapterName.data()), len);
-                }
-            }
-            
-            info.isUp = (a->OperStatus == IfOperStatusUp);
-            
-            // Create display name: "Friendly Name (Status)"
-            info.displayName = info.friendlyName;
-            if (!info.displayName.empty()) {
-                info.displayName += info.isUp ? L" (已连接)" : L" (已断开)";
-            } else if (!info.adapterName.empty()) {
-                info.displayName = info.adapterName;
-                info.displayName += info.isUp ? L" (已连接)" : L" (已断开)";
-            }
-            
-            if (!info.displayName.empty()) {
-                adapters.push_back(info);
-            }
-        }
-    }
-    
-    return adapters;
-}
-
 static void SetEdit(HWND hDlg, int id, const std::wstring& s) { SetDlgItemTextW(hDlg, id, s.c_str()); }
 static std::wstring GetEdit(HWND hDlg, int id) {
     wchar_t buf[512]{};
@@ -85,6 +20,9 @@ static std::wstring GetEdit(HWND hDlg, int id) {
     return buf;
 }
 
+// Adapter table the combo box was filled from (shared snapshot, no enumeration)
+static std::shared_ptr<const iputils::AdapterSnapshot> s_adapters;
+
 // Fill combo box with adapter list and select current one
 static void SetupAdapterCombo(HWND hDlg, int id, const std::wstring& currentAdapter) {
     HWND hCombo = GetDlgItem(hDlg, id);
@@ -97,20 +35,21 @@ static void SetupAdapterCombo(HWND hDlg, int id, const std::wstring& currentAdap
     SendMessage(hCombo, CB_ADDSTRING, 0, (LPARAM)L"自动选择");
     SendMessage(hCombo, CB_SETITEMDATA, 0, (LPARAM)0); // Data = 0 for auto
     
-    // Get adapters and add them
-    auto adapters = GetNetworkAdapters();
+    // Add adapters from the shared inventory snapshot
+    s_adapters = iputils::GetAdapterSnapshot();
+    const iputils::AdapterEntry* current = s_adapters->FindByName(currentAdapter);
     int selectedIndex = 0; // Default to "自动选择"
     
-    for (size_t i = 0; i < adapters.size(); ++i) {
-        int index = (int)SendMessage(hCombo, CB_ADDSTRING, 0, (LPARAM)adapters[i].displayName.c_str());
+    for (const auto& adapter : s_adapters->adapters) {
+        std::wstring display = adapter.DisplayName();
+        if (display.empty()) continue;
+        int index = (int)SendMessage(hCombo, CB_ADDSTRING, 0, (LPARAM)display.c_str());
         if (index != CB_ERR) {
-            // Store adapter info as item data (index + 1 to distinguish from auto=0)
-            SendMessage(hCombo, CB_SETITEMDATA, index, (LPARAM)(i + 1));
+            // Store the interface LUID as item data (stable across adapter changes, never 0)
+            SendMessage(hCombo, CB_SETITEMDATA, index, (LPARAM)adapter.luid);
             
             // Check if this is the currently selected adapter
-            if (!currentAdapter.empty() && 
-                (currentAdapter == adapters[i].friendlyName || 
-                 currentAdapter == adapters[i].adapterName)) {
+            if (&adapter == current) {
                 selectedIndex = index;
             }
         }
@@ -128,19 +67,19 @@ static std::wstring GetSelectedAdapter(HWND hDlg, int id) {
     if (selection == CB_ERR) return L"";
     
     LPARAM data = SendMessage(hCombo, CB_GETITEMDATA, selection, 0);
-    if (data == 0) {
+    if (data == 0 || data == CB_ERR) {
         // Auto selection
         return L"";
     }
     
-    // Get the adapter info
-    auto adapters = GetNetworkAdapters();
-    size_t adapterIndex = (size_t)data - 1;
-    if (adapterIndex < adapters.size()) {
-        return adapters[adapterIndex].friendlyName;
-    }
-    
-    return L"";
+    // Map the LUID back to an adapter: prefer the current table (picks up renames),
+    // fall back to the table the list was built from if the adapter has since gone away
+    const unsigned long long luid = (unsigned long long)data;
+    auto latest = iputils::GetAdapterSnapshot();
+    const iputils::AdapterEntry* adapter = latest->FindByLuid(luid);
+    if (!adapter && s_adapters) adapter = s_adapters->FindByLuid(luid);
+    if (!adapter) return L"";
+    return adapter->friendly_name.empty() ? adapter->adapter_name : adapter->friendly_name;
 }
 
 static INT_PTR CALLBACK DlgProc(HWND hDlg, UINT msg, WPARAM wParam, LPARAM lParam) {
@@ -198,6 +137,7 @@ static INT_PTR CALLBACK DlgProc(HWND hDlg, UINT msg, WPARAM wParam, LPARAM lPara
 
 bool ShowIpOptionsDialog(HWND hParent, PluginOptions& options) {
     INT_PTR ret = DialogBoxParamW(g_hInst, MAKEINTRESOURCEW(IDD_OPTIONS), hParent, DlgProc, (LPARAM)&options);
+    s_adapters.reset();
     return (ret == IDOK);
 }
 
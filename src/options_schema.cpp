@@ -0,0 +1,226 @@
+﻿/**
+ * @file options_schema.cpp
+ * @brief 配置文件的键表、单遍解析和序列化实现
+ * @author Lynn
+ * @date 2025
+ */
+
+#include "options_schema.h"
+
+namespace {
+
+OptionField BoolField(const wchar_t* key, bool PluginOptions::* member) {
+    return { key, OptionKind::BOOL, member, nullptr, nullptr, nullptr, nullptr, 0, 1 };
+}
+
+OptionField StringField(const wchar_t* key, std::wstring PluginOptions::* member) {
+    return { key, OptionKind::STRING, nullptr, member, nullptr, nullptr, nullptr, 0, 0 };
+}
+
+OptionField MinutesField(const wchar_t* key, std::chrono::minutes PluginOptions::* member, long long lo, long long hi) {
+    return { key, OptionKind::MINUTES, nullptr, nullptr, member, nullptr, nullptr, lo, hi };
+}
+
+OptionField SecondsField(const wchar_t* key, std::chrono::seconds PluginOptions::* member, long long lo, long long hi) {
+    return { key, OptionKind::SECONDS, nullptr, nullptr, nullptr, member, nullptr, lo, hi };
+}
+
+OptionField IntegerField(const wchar_t* key, int PluginOptions::* member, long long lo, long long hi) {
+    return { key, OptionKind::INTEGER, nullptr, nullptr, nullptr, nullptr, member, lo, hi };
+}
+
+bool IsBlank(wchar_t c) {
+    return c == L' ' || c == L'\t' || c == L'\r' || c == L'\f' || c == L'\v';
+}
+
+/**
+ * @brief 去掉[begin, end)首尾的空白
+ */
+void Trim(const wchar_t*& begin, const wchar_t*& end) {
+    while (begin < end && IsBlank(*begin)) ++begin;
+    while (end > begin && IsBlank(end[-1])) --end;
+}
+
+/**
+ * @brief 比较[begin, end)与以0结尾的ASCII键名（不区分大小写）
+ */
+bool EqualsNoCase(const wchar_t* begin, const wchar_t* end, const wchar_t* key) {
+    for (; begin < end; ++begin, ++key) {
+        if (!*key) return false;
+        wchar_t a = *begin, b = *key;
+        if (a >= L'A' && a <= L'Z') a = static_cast<wchar_t>(a - L'A' + L'a');
+        if (b >= L'A' && b <= L'Z') b = static_cast<wchar_t>(b - L'A' + L'a');
+        if (a != b) return false;
+    }
+    return *key == L'\0';
+}
+
+/**
+ * @brief 解析开头的十进制整数（可带符号），忽略其后的内容
+ * @return false表示开头没有数字或数值过大
+ */
+bool ParseLeadingInt(const wchar_t* begin, const wchar_t* end, long long& value) {
+    bool negative = false;
+    if (begin < end && (*begin == L'-' || *begin == L'+')) {
+        negative = *begin == L'-';
+        ++begin;
+    }
+    if (begin == end || *begin < L'0' || *begin > L'9') return false;
+    long long v = 0;
+    for (; begin < end && *begin >= L'0' && *begin <= L'9'; ++begin) {
+        v = v * 10 + (*begin - L'0');
+        if (v > 1000000000LL) return false;
+    }
+    value = negative ? -v : v;
+    return true;
+}
+
+/**
+ * @brief 把一个值写入选项
+ * @return false表示值无效，选项保持不变
+ */
+bool ApplyValue(const OptionField& field, const wchar_t* begin, const wchar_t* end, PluginOptions& options) {
+    if (field.kind == OptionKind::STRING) {
+        // 与GetPrivateProfileString一致：成对的引号包围时去掉引号
+        if (end - begin >= 2 && ((*begin == L'"' && end[-1] == L'"') || (*begin == L'\'' && end[-1] == L'\''))) {
+            ++begin;
+            --end;
+        }
+        (options.*field.text).assign(begin, end);
+        return true;
+    }
+
+    long long v = 0;
+    if (!ParseLeadingInt(begin, end, v)) return false;
+    if (field.kind == OptionKind::BOOL) {
+        options.*field.flag = v != 0;
+        return true;
+    }
+    if (v < field.min_value || v > field.max_value) return false;
+    if (field.kind == OptionKind::MINUTES) {
+        options.*field.minutes = std::chrono::minutes(v);
+    } else if (field.kind == OptionKind::SECONDS) {
+        options.*field.seconds = std::chrono::seconds(v);
+    } else {
+        options.*field.number = static_cast<int>(v);
+    }
+    return true;
+}
+
+} // namespace
+
+const OptionField kOptionSchema[] = {
+    BoolField(L"show_internal", &PluginOptions::show_internal),
+    BoolField(L"show_external", &PluginOptions::show_external),
+    StringField(L"preferred_adapter", &PluginOptions::preferred_adapter),
+    MinutesField(L"external_refresh_minutes", &PluginOptions::external_refresh, 1, 24 * 60),
+    StringField(L"separator", &PluginOptions::separator),
+    BoolField(L"enable_smart_cache", &PluginOptions::enable_smart_cache),
+    SecondsField(L"fast_refresh_seconds", &PluginOptions::fast_refresh, 5, 60 * 60),
+    MinutesField(L"max_refresh_minutes", &PluginOptions::max_refresh, 1, 24 * 60),
+    SecondsField(L"prewarm_seconds", &PluginOptions::prewarm_lead, 0, 60 * 60),
+    BoolField(L"show_interface_egress", &PluginOptions::show_interface_egress),
+    BoolField(L"show_ipv6", &PluginOptions::show_ipv6),
+    BoolField(L"ipv6_skip_temporary", &PluginOptions::ipv6_skip_temporary),
+    BoolField(L"ipv6_skip_deprecated", &PluginOptions::ipv6_skip_deprecated),
+    IntegerField(L"usage_graph", &PluginOptions::usage_graph, kUsageGraphNone, kUsageGraphGatewayRtt),
+    IntegerField(L"usage_graph_full_ms", &PluginOptions::usage_graph_full_ms, 10, 60 * 1000),
+    SecondsField(L"rtt_probe_seconds", &PluginOptions::rtt_probe_interval, 0, 60 * 60),
+};
+
+const size_t kOptionSchemaSize = sizeof(kOptionSchema) / sizeof(kOptionSchema[0]);
+
+OptionsParseStats ParseOptionsIni(const wchar_t* text, size_t len, PluginOptions& options) {
+    static_assert(sizeof(kOptionSchema) / sizeof(kOptionSchema[0]) <= 32, "seen mask holds 32 fields");
+
+    OptionsParseStats stats;
+    unsigned long seen = 0;  // 已出现过的配置项（同名键以第一次为准）
+    bool in_section = false;
+    const wchar_t* p = text;
+    const wchar_t* const end = text + len;
+
+    while (p < end) {
+        const wchar_t* line = p;
+        while (p < end && *p != L'\n') ++p;
+        const wchar_t* line_end = p;
+        if (p < end) ++p;  // 跳过'\n'
+
+        Trim(line, line_end);
+        if (line == line_end || *line == L';' || *line == L'#') continue;
+
+        if (*line == L'[') {
+            const wchar_t* name = line + 1;
+            const wchar_t* name_end = name;
+            while (name_end < line_end && *name_end != L']') ++name_end;
+            Trim(name, name_end);
+            in_section = EqualsNoCase(name, name_end, kOptionSection);
+            continue;
+        }
+        if (!in_section) continue;
+
+        const wchar_t* eq = line;
+        while (eq < line_end && *eq != L'=') ++eq;
+        if (eq == line_end) continue;
+
+        const wchar_t* key = line;
+        const wchar_t* key_end = eq;
+        const wchar_t* value = eq + 1;
+        const wchar_t* value_end = line_end;
+        Trim(key, key_end);
+        Trim(value, value_end);
+
+        size_t i = 0;
+        while (i < kOptionSchemaSize && !EqualsNoCase(key, key_end, kOptionSchema[i].key)) ++i;
+        if (i == kOptionSchemaSize) {
+            ++stats.unknown;
+            continue;
+        }
+        if (seen & (1UL << i)) continue;
+        seen |= 1UL << i;
+
+        if (ApplyValue(kOptionSchema[i], value, value_end, options)) {
+            ++stats.applied;
+        } else {
+            ++stats.rejected;
+        }
+    }
+    return stats;
+}
+
+std::wstring SerializeOptions(const PluginOptions& options) {
+    std::wstring out;
+    out.reserve(512);
+    out += L'[';
+    out += kOptionSection;
+    out += L"]\r\n";
+    for (size_t i = 0; i < kOptionSchemaSize; ++i) {
+        const OptionField& field = kOptionSchema[i];
+        out += field.key;
+        out += L'=';
+        switch (field.kind) {
+        case OptionKind::BOOL:
+            out += (options.*field.flag) ? L'1' : L'0';
+            break;
+        case OptionKind::STRING: {
+            const std::wstring& s = options.*field.text;
+            // 首尾有空白（如默认分隔符" | "）时加引号，读取时才能原样恢复
+            const bool quote = !s.empty() && (IsBlank(s.front()) || IsBlank(s.back()) || s.front() == L'"' || s.front() == L'\'');
+            if (quote) out += L'"';
+            out += s;
+            if (quote) out += L'"';
+            break;
+        }
+        case OptionKind::MINUTES:
+            out += std::to_wstring((options.*field.minutes).count());
+            break;
+        case OptionKind::SECONDS:
+            out += std::to_wstring((options.*field.seconds).count());
+            break;
+        case OptionKind::INTEGER:
+            out += std::to_wstring(options.*field.number);
+            break;
+        }
+        out += L"\r\n";
+    }
+    return out;
+}
@@ -0,0 +1,76 @@
+﻿/**
+ * @file options_schema.h
+ * @brief 配置文件的键表、单遍解析和序列化
+ * @details 每个配置项的键名、类型、对应的PluginOptions成员和取值范围集中在一张表中，
+ *          解析和序列化都按这张表进行。解析器只处理内存中的宽字符文本，不依赖Windows API
+ * @author Lynn
+ * @date 2025
+ */
+
+#pragma once
+
+#include <string>
+#include <chrono>
+#include <cstddef>
+#include "plugin_options.h"
+
+/**
+ * @brief 配置项的值类型
+ */
+enum class OptionKind {
+    BOOL,     ///< 0/1
+    STRING,   ///< 字符串（首尾有空格时写入为带引号的形式）
+    MINUTES,  ///< 整数分钟
+    SECONDS,  ///< 整数秒
+    INTEGER   ///< 整数
+};
+
+/**
+ * @brief 一个配置项的描述
+ * @details 按kind只使用对应的成员指针，其余为nullptr
+ */
+struct OptionField {
+    const wchar_t* key;                                 ///< INI键名
+    OptionKind kind;                                    ///< 值类型
+    bool PluginOptions::* flag;                         ///< BOOL对应的成员
+    std::wstring PluginOptions::* text;                 ///< STRING对应的成员
+    std::chrono::minutes PluginOptions::* minutes;      ///< MINUTES对应的成员
+    std::chrono::seconds PluginOptions::* seconds;      ///< SECONDS对应的成员
+    int PluginOptions::* number;                        ///< INTEGER对应的成员
+    long long min_value;                                ///< 数值下限（含）
+    long long max_value;                                ///< 数值上限（含）
+};
+
+/// 配置项所在的节名
+constexpr const wchar_t* kOptionSection = L"ip";
+
+/// 配置项表
+extern const OptionField kOptionSchema[];
+/// 配置项表的项数
+extern const size_t kOptionSchemaSize;
+
+/**
+ * @brief 单遍解析的统计
+ */
+struct OptionsParseStats {
+    size_t applied = 0;   ///< 成功写入的配置项个数
+    size_t rejected = 0;  ///< 值无法解析或超出范围、保持原值的配置项个数
+    size_t unknown = 0;   ///< 配置节中未知的键个数
+};
+
+/**
+ * @brief 一次遍历INI文本，按配置项表写入选项
+ * @param text INI文本（不含BOM）
+ * @param len 文本长度（字符数）
+ * @param options 输出：只修改文本中出现且值有效的配置项
+ * @return 解析统计
+ * @details 与GetPrivateProfile*W的行为保持一致：节名和键名不区分大小写，同名键以第一次出现为准，
+ *          整数取开头的数字部分（允许后跟注释），字符串去掉首尾空白和成对的引号
+ */
+OptionsParseStats ParseOptionsIni(const wchar_t* text, size_t len, PluginOptions& options);
+
+/**
+ * @brief 按配置项表序列化选项
+ * @return 以[ip]开头、CRLF换行的完整文件内容（不含BOM）
+ */
+std::wstring SerializeOptions(const PluginOptions& options);
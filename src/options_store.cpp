@@ -0,0 +1,191 @@
+﻿/**
+ * @file options_store.cpp
+ * @brief 配置文件的读取和延迟批量写入实现
+ * @author Lynn
+ * @date 2025
+ */
+
+#include "options_store.h"
+#include "module_state.h"
+
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+
+#include <windows.h>
+
+namespace {
+
+/**
+ * @brief 把多字节文本转换为宽字符
+ * @return false表示按该代码页转换失败
+ */
+bool MultiByteToText(UINT code_page, DWORD flags, const char* data, int len, std::wstring& out) {
+    if (len == 0) {
+        out.clear();
+        return true;
+    }
+    int n = ::MultiByteToWideChar(code_page, flags, data, len, nullptr, 0);
+    if (n <= 0) return false;
+    out.resize(n);
+    return ::MultiByteToWideChar(code_page, flags, data, len, &out[0], n) == n;
+}
+
+} // namespace
+
+OptionsStore::~OptionsStore() {
+    Flush();
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        stopping_ = true;
+    }
+    cv_.notify_all();
+    if (!worker_.joinable()) return;
+    // 插件卸载期间析构时持有加载器锁，join会死锁；尚未写入的配置已由上面的Flush在本线程写出，
+    // 后台线程此时最多在等待条件变量或写同一份已写入的内容（序号不大于已写入序号时跳过）
+    if (iputils::IsModuleDetaching()) {
+        worker_.detach();
+    } else {
+        worker_.join();
+    }
+}
+
+void OptionsStore::SetPath(const std::wstring& path) {
+    std::lock_guard<std::mutex> lk(mtx_);
+    path_ = path;
+}
+
+bool OptionsStore::Load(PluginOptions& options, OptionsParseStats* stats) {
+    std::wstring path;
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        path = path_;
+    }
+    if (path.empty()) return false;
+
+    HANDLE file = ::CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER size{};
+    std::string data;
+    bool ok = ::GetFileSizeEx(file, &size) && size.QuadPart < (1 << 20);  // 配置文件不会超过1MB
+    if (ok) {
+        data.resize(static_cast<size_t>(size.QuadPart));
+        DWORD read = 0;
+        ok = data.empty() || (::ReadFile(file, &data[0], static_cast<DWORD>(data.size()), &read, nullptr) && read == data.size());
+    }
+    ::CloseHandle(file);
+    if (!ok) return false;
+
+    // 按BOM识别编码：本插件写入UTF-16LE，手工编辑的文件通常为UTF-8或ANSI
+    const wchar_t* text = nullptr;
+    size_t len = 0;
+    std::wstring converted;
+    const auto* bytes = reinterpret_cast<const unsigned char*>(data.data());
+    if (data.size() >= 2 && bytes[0] == 0xFF && bytes[1] == 0xFE) {
+        text = reinterpret_cast<const wchar_t*>(data.data() + 2);
+        len = (data.size() - 2) / sizeof(wchar_t);
+    } else {
+        size_t skip = data.size() >= 3 && bytes[0] == 0xEF && bytes[1] == 0xBB && bytes[2] == 0xBF ? 3 : 0;
+        const int n = static_cast<int>(data.size() - skip);
+        if (!MultiByteToText(CP_UTF8, MB_ERR_INVALID_CHARS, data.data() + skip, n, converted)
+            && !MultiByteToText(CP_ACP, 0, data.data() + skip, n, converted)) {
+            return false;
+        }
+        text = converted.data();
+        len = converted.size();
+    }
+
+    OptionsParseStats result = ParseOptionsIni(text, len, options);
+    if (stats) *stats = result;
+    return true;
+}
+
+void OptionsStore::Save(const PluginOptions& options) {
+    std::wstring text = SerializeOptions(options);
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        if (path_.empty() || stopping_) return;
+        pending_.swap(text);
+        has_pending_ = true;
+        ++pending_seq_;
+        due_ = std::chrono::steady_clock::now() + std::chrono::milliseconds(kDebounceMs);
+        if (!worker_.joinable()) {
+            iputils::PinModule();
+            worker_ = std::thread(&OptionsStore::Run, this);
+        }
+    }
+    cv_.notify_one();
+}
+
+void OptionsStore::Flush() {
+    std::wstring path, text;
+    unsigned long long seq = 0;
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        if (!has_pending_) return;
+        path = path_;
+        text.swap(pending_);
+        seq = pending_seq_;
+        has_pending_ = false;
+    }
+    Write(path, text, seq);
+}
+
+void OptionsStore::Run() {
+    std::unique_lock<std::mutex> lk(mtx_);
+    for (;;) {
+        if (stopping_) return;
+        if (!has_pending_) {
+            cv_.wait(lk);
+            continue;
+        }
+        // 去抖：等待期间再次保存会推迟due_，醒来后重新检查
+        if (std::chrono::steady_clock::now() < due_) {
+            cv_.wait_until(lk, due_);
+            continue;
+        }
+
+        std::wstring path = path_;
+        std::wstring text;
+        text.swap(pending_);
+        const unsigned long long seq = pending_seq_;
+        has_pending_ = false;
+
+        lk.unlock();
+        Write(path, text, seq);
+        lk.lock();
+    }
+}
+
+void OptionsStore::Write(const std::wstring& path, const std::wstring& text, unsigned long long seq) {
+    if (path.empty()) return;
+    std::lock_guard<std::mutex> lk(write_mtx_);
+    if (seq <= written_seq_) return;
+
+    const std::wstring tmp = path + L".tmp";
+    HANDLE file = ::CreateFileW(tmp.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return;
+
+    // UTF-16LE BOM + 内容，一次WriteFile写出
+    std::wstring data;
+    data.reserve(text.size() + 1);
+    data += L'\xFEFF';
+    data += text;
+    const DWORD bytes = static_cast<DWORD>(data.size() * sizeof(wchar_t));
+    DWORD written = 0;
+    const bool ok = ::WriteFile(file, data.data(), bytes, &written, nullptr) && written == bytes;
+    ::CloseHandle(file);
+
+    // 替换原文件：写入中途失败或进程退出时原文件保持完整
+    if (!ok || !::MoveFileExW(tmp.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) {
+        ::DeleteFileW(tmp.c_str());
+        return;
+    }
+    written_seq_ = seq;
+    ++writes_;
+}
@@ -0,0 +1,99 @@
+﻿/**
+ * @file options_store.h
+ * @brief 配置文件的读取和延迟批量写入
+ * @details 读取时一次读入整个文件并单遍解析；保存配置时只在内存中序列化一次，由后台线程在去抖延迟到期后整体写入临时文件再替换原文件，
+ *          连续多次保存（如快速切换显示选项）只产生一次磁盘写入，UI线程不做任何文件操作
+ * @author Lynn
+ * @date 2025
+ */
+
+#pragma once
+
+#include <string>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <atomic>
+#include "plugin_options.h"
+#include "options_schema.h"
+
+/**
+ * @brief 配置文件存储
+ * @details 写入的文件为带BOM的UTF-16LE，GetPrivateProfile*W可直接读取；
+ *          后台线程在第一次保存时才创建，析构时把尚未写入的配置同步写出
+ */
+class OptionsStore {
+public:
+    /// 去抖延迟（毫秒）：最后一次保存后经过该时间才写入磁盘
+    static constexpr int kDebounceMs = 500;
+
+    OptionsStore() = default;
+    ~OptionsStore();
+
+    OptionsStore(const OptionsStore&) = delete;
+    OptionsStore& operator=(const OptionsStore&) = delete;
+
+    /**
+     * @brief 设置配置文件路径
+     * @param path 配置文件完整路径（空表示不保存）
+     */
+    void SetPath(const std::wstring& path);
+
+    /**
+     * @brief 读取配置文件
+     * @param options 输出：文件中出现且值有效的配置项写入此处，其余保持不变
+     * @param stats 输出：解析统计（可为nullptr）
+     * @return false表示未设置路径或文件不存在、无法读取
+     * @details 一次ReadFile读入整个文件，按BOM识别UTF-16LE/UTF-8（无BOM时先按UTF-8、失败再按ANSI代码页），
+     *          再由ParseOptionsIni单遍解析
+     */
+    bool Load(PluginOptions& options, OptionsParseStats* stats = nullptr);
+
+    /**
+     * @brief 保存配置（非阻塞）
+     * @param options 要保存的配置选项
+     * @details 在调用线程上序列化，去抖延迟内的多次保存只写入最后一次的内容
+     */
+    void Save(const PluginOptions& options);
+
+    /**
+     * @brief 立即在调用线程上写出尚未写入的配置
+     */
+    void Flush();
+
+    /**
+     * @brief 是否有尚未写入磁盘的配置
+     * @details 为true时磁盘上的文件比内存中的配置旧，热加载应跳过
+     */
+    bool HasPending() {
+        std::lock_guard<std::mutex> lk(mtx_);
+        return has_pending_;
+    }
+
+    /// 实际写入磁盘的次数
+    unsigned long long WriteCount() const { return writes_.load(); }
+
+private:
+    void Run();
+
+    /**
+     * @brief 写出一份配置（先写临时文件再替换）
+     * @param seq 内容序号，不大于已写入的序号时跳过，避免较旧的内容覆盖较新的内容
+     */
+    void Write(const std::wstring& path, const std::wstring& text, unsigned long long seq);
+
+    std::mutex mtx_;
+    std::condition_variable cv_;
+    std::thread worker_;
+    bool stopping_ = false;
+    std::wstring path_;                                 ///< 配置文件路径
+    std::wstring pending_;                              ///< 等待写入的内容
+    bool has_pending_ = false;                          ///< 是否有等待写入的内容
+    unsigned long long pending_seq_ = 0;                ///< 最近一次保存的内容序号
+    std::chrono::steady_clock::time_point due_{};       ///< 计划写入时间
+
+    std::mutex write_mtx_;                              ///< 串行化磁盘写入
+    unsigned long long written_seq_ = 0;                ///< 已写入的内容序号（由write_mtx_保护）
+    std::atomic<unsigned long long> writes_{ 0 };       ///< 实际写入次数
+};
@@ -13,11 +13,10 @@
 #pragma execution_character_set("utf-8")  // 设置源代码字符集为UTF-8
 
 #include "plugin.h"
-#include <Shlwapi.h>        // Shell轻量级实用程序API（用于路径操作）
+#include <algorithm>
+#include <cstdio>
 #include "options_dialog.h"  // 选项对话框
 
-#pragma comment(lib, "Shlwapi.lib")  // 链接Shell轻量级实用程序库
-
 /**
  * @brief 路径连接辅助函数
  * @param a 基础路径
@@ -37,75 +36,35 @@ static std::wstring JoinPath(const std::wstring& a, const std::wstring& b) {
 
 /**
  * @brief TMIpPlugin构造函数
- * @details 初始化插件实例，加载配置选项
+ * @details 此时还不知道配置文件目录，先使用默认选项，配置在OnInitialize中加载
  */
-TMIpPlugin::TMIpPlugin() {
-    LoadOptions();  // 从配置文件加载用户设置
-}
+TMIpPlugin::TMIpPlugin() = default;
 
 /**
  * @brief 获取插件显示项目
- * @param index 项目索引（当前插件只有一个显示项）
+ * @param index 项目索引（0为IP地址，1为往返时延）
  * @return 显示项目指针，无效索引时返回nullptr
  * @details 实现ITMPlugin接口，告诉TrafficMonitor插件提供的显示项目
  */
 IPluginItem* TMIpPlugin::GetItem(int index) {
-    if (index == 0) return &item_;  // 返回IP显示项目
+    if (index == 0) return &item_;      // 返回IP显示项目
+    if (index == 1) return &rtt_item_;  // 返回往返时延显示项目
     return nullptr;  // 无效索引
 }
 
+/**
+ * @brief 数据更新回调
+ * @details 配置文件被外部修改时先整体替换选项；
+ *          各数据源都未变化时只做一次版本比较，显示文本不重建；
+ *          工具提示在主程序请求时才生成
+ */
 void TMIpPlugin::DataRequired() {
-    text_provider_.SetOptions(options_);
+    const auto started = std::chrono::steady_clock::now();
+    if (watcher_.TakeChange()) ReloadOptions();
     item_.Update(force_refresh_next_);
+    rtt_item_.Update();
     force_refresh_next_ = false;
-
-    const auto& v = item_.RawValue();
-    
-    // 确保即使值为空也能提供有意义的显示
-    if (v.empty()) {
-        // 如果值为空，设置一个默认提示
-        if (options_.show_internal && options_.show_external) {
-            tooltip_ = L"内网: N/A\n外网: N/A";
-        } else if (options_.show_internal) {
-            tooltip_ = L"内网: N/A";
-        } else if (options_.show_external) {
-            tooltip_ = L"外网: N/A";
-        } else {
-            tooltip_ = L"请在选项中启用IP显示";
-        }
-        return;
-    }
-    
-    if (options_.show_internal && options_.show_external) {
-        // Split for tooltip if both enabled
-        // Format: 内网: x\n外网: y
-        std::wstring internal, external;
-        size_t pos = v.find(options_.separator);
-        if (pos != std::wstring::npos) {
-            internal = v.substr(0, pos);
-            external = v.substr(pos + options_.separator.size());
-        } else {
-            internal = v;
-        }
-        tooltip_.clear();
-        if (!internal.empty()) {
-            tooltip_ += L"内网: ";
-            tooltip_ += internal;
-        }
-        if (!external.empty()) {
-            if (!tooltip_.empty()) tooltip_ += L"\n";
-            tooltip_ += L"外网: ";
-            tooltip_ += external;
-        }
-    } else if (options_.show_internal) {
-        tooltip_ = L"内网: ";
-        tooltip_ += v;
-    } else if (options_.show_external) {
-        tooltip_ = L"外网: ";
-        tooltip_ += v;
-    } else {
-        tooltip_ = L"请在选项中启用IP显示";
-    }
+    metrics::Global().update_time.Record(std::chrono::steady_clock::now() - started);
 }
 
 const wchar_t* TMIpPlugin::GetInfo(PluginInfoIndex index) {
@@ -126,10 +85,18 @@ void TMIpPlugin::OnInitialize(ITrafficMonitor* pApp) {
         const wchar_t* dir = app_->GetPluginConfigDir();
         if (dir) config_dir_ = dir;
     }
+    if (!config_dir_.empty()) {
+        store_.SetPath(JoinPath(config_dir_, L"tm_ip_plugin.ini"));
+        watcher_.Start(config_dir_, L"tm_ip_plugin.ini");
+    }
     LoadOptions();
 }
 
 const wchar_t* TMIpPlugin::GetTooltipInfo() {
+    const wchar_t* ip_tooltip = item_.Tooltip();
+    if (options_.rtt_probe_interval.count() <= 0) return ip_tooltip;
+    tooltip_.assign(ip_tooltip);  // 保留容量，不重新分配
+    rtt_item_.AppendTooltip(tooltip_);
     return tooltip_.c_str();
 }
 
@@ -150,6 +117,7 @@ const wchar_t* TMIpPlugin::GetCommandName(int command_index) {
     case 0: return L"显示内网IP"; // toggle
     case 1: return L"显示外网IP"; // toggle
     case 2: return L"刷新外网IP"; // one-shot refresh
+    case 3: return L"导出诊断信息"; // dump metrics
     default: return L"";
     }
 }
@@ -158,15 +126,20 @@ void TMIpPlugin::OnPluginCommand(int command_index, void* /*hWnd*/, void* /*para
     switch (command_index) {
     case 0:
         options_.show_internal = !options_.show_internal;
+        text_provider_.SetOptions(options_);
         SaveOptions();
         break;
     case 1:
         options_.show_external = !options_.show_external;
+        text_provider_.SetOptions(options_);
         SaveOptions();
         break;
     case 2:
         force_refresh_next_ = true;
         break;
+    case 3:
+        DumpDiagnostics();
+        break;
     default:
         break;
     }
@@ -180,38 +153,60 @@ int TMIpPlugin::IsCommandChecked(int command_index) {
     }
 }
 
-void TMIpPlugin::LoadOptions() {
-    // Defaults already set in options_. Try reading from ini if available
-    std::wstring ini;
-    if (!config_dir_.empty()) ini = JoinPath(config_dir_, L"tm_ip_plugin.ini");
+/**
+ * @brief 把运行统计写入诊断文件并通知文件位置
+ * @details 写到配置文件目录下的tm_ip_plugin_diag.txt，没有配置目录时写到临时目录
+ */
+void TMIpPlugin::DumpDiagnostics() {
+    std::wstring dir = config_dir_;
+    if (dir.empty()) {
+        wchar_t temp[MAX_PATH] = {};
+        if (::GetTempPathW(_countof(temp), temp)) dir = temp;
+    }
+    const std::wstring path = JoinPath(dir, L"tm_ip_plugin_diag.txt");
+    const iputils::TransportStats transport = iputils::GetTransportStats();
+    const bool ok = metrics::DumpToFile(metrics::Global(), path, &transport);
+    if (app_ && app_->GetAPIVersion() >= 1) {
+        const std::wstring msg = (ok ? L"诊断信息已导出到 " : L"无法写入诊断文件 ") + path;
+        app_->ShowNotifyMessage(msg.c_str());
+    }
+}
 
-    if (!ini.empty() && PathFileExistsW(ini.c_str())) {
-        options_.show_internal = GetPrivateProfileIntW(L"ip", L"show_internal", options_.show_internal ? 1 : 0, ini.c_str()) != 0;
-        options_.show_external = GetPrivateProfileIntW(L"ip", L"show_external", options_.show_external ? 1 : 0, ini.c_str()) != 0;
+/**
+ * @brief 从配置文件加载选项
+ * @details 一次读入整个文件并按配置项表单遍解析；缺失或超出范围的配置项使用默认值，
+ *          配置文件不存在时保持当前选项
+ */
+void TMIpPlugin::LoadOptions() {
+    PluginOptions loaded;
+    if (store_.Load(loaded)) options_ = loaded;
+    text_provider_.SetOptions(options_);
+}
 
-        wchar_t buf[256]{};
-        GetPrivateProfileStringW(L"ip", L"preferred_adapter", L"", buf, (DWORD)std::size(buf), ini.c_str());
-        options_.preferred_adapter = buf;
+/**
+ * @brief 配置文件被外部修改后重新加载
+ * @details 在UI线程上由DataRequired调用，新选项一次性替换，不会出现新旧混合的状态。
+ *          内容与当前选项相同（包括本插件自己写入后的通知）时什么都不做；
+ *          外网刷新间隔等调度参数每次刷新都从选项读取，替换后下一次计划刷新即按新值计算
+ */
+void TMIpPlugin::ReloadOptions() {
+    // 还有尚未写入的保存时，磁盘上的文件比内存中的配置旧，稍后本插件的写入会覆盖它
+    if (store_.HasPending()) return;
 
-        int minutes = GetPrivateProfileIntW(L"ip", L"external_refresh_minutes", (int)options_.external_refresh.count(), ini.c_str());
-        if (minutes <= 0) minutes = 5;
-        options_.external_refresh = std::chrono::minutes(minutes);
+    PluginOptions loaded;
+    if (!store_.Load(loaded)) return;
+    if (SerializeOptions(loaded) == SerializeOptions(options_)) return;
 
-        GetPrivateProfileStringW(L"ip", L"separator", L" | ", buf, (DWORD)std::size(buf), ini.c_str());
-        options_.separator = buf;
-    }
+    options_ = loaded;
+    text_provider_.SetOptions(options_);
 }
 
+/**
+ * @brief 保存选项到配置文件
+ * @details 只在内存中序列化，由配置存储在去抖延迟后于后台线程整体写入
+ */
 void TMIpPlugin::SaveOptions() {
-    if (config_dir_.empty()) return;
-    std::wstring ini = JoinPath(config_dir_, L"tm_ip_plugin.ini");
-    WritePrivateProfileStringW(L"ip", L"show_internal", options_.show_internal ? L"1" : L"0", ini.c_str());
-    WritePrivateProfileStringW(L"ip", L"show_external", options_.show_external ? L"1" : L"0", ini.c_str());
-    WritePrivateProfileStringW(L"ip", L"preferred_adapter", options_.preferred_adapter.c_str(), ini.c_str());
-    wchar_t tmp[32];
-    _itow_s((int)options_.external_refresh.count(), tmp, 10);
-    WritePrivateProfileStringW(L"ip", L"external_refresh_minutes", tmp, ini.c_str());
-    WritePrivateProfileStringW(L"ip", L"separator", options_.separator.c_str(), ini.c_str());
+    store_.Save(options_);
 }
 
 // === IpPluginItem 自定义绘制函数实现 ===
@@ -219,7 +214,8 @@ void TMIpPlugin::SaveOptions() {
 /**
  * @brief 获取显示区域所需的宽度
  * @return 显示区域宽度（像素，96 DPI基准）
- * @details 计算能容纳最长IP地址的宽度，考虑垂直排列只需要单行宽度
+ * @details 计算能容纳最长IP地址的宽度，考虑垂直排列只需要单行宽度；
+ *          仅在主程序不支持GetItemWidthEx（API版本低于3）时使用
  */
 int IpPluginItem::GetItemWidth() const {
     // 返回能容纳"255.255.255.255"的宽度，约120像素（96 DPI下）
@@ -227,6 +223,31 @@ int IpPluginItem::GetItemWidth() const {
     return 120;
 }
 
+/**
+ * @brief 按实际显示文本测量显示区域宽度
+ * @param hDC 设备上下文句柄（已选入任务栏字体）
+ * @return 显示区域宽度（实际像素），hDC为空时返回0，由主程序改用GetItemWidth
+ * @details 取各行文本宽度的最大值加左右边距。测量结果按内容版本、字体和DPI缓存，
+ *          报告的宽度带滞后：只有变长或明显变短时才改变，避免任务栏频繁重新布局
+ */
+int IpPluginItem::GetItemWidthEx(void* hDC) const {
+    if (!hDC) return 0;
+
+    HDC dc = static_cast<HDC>(hDC);
+    iputils::RenderKey key = iputils::TextRenderCache::MakeKey(dc, content_version_, 0, 0);
+    if (width_cache_.IsValid(key)) return width_cache_.Reported();
+
+    int measured = 0;
+    if (internal_ip_.empty() && external_ip_.empty()) {
+        measured = iputils::MeasureText(dc, L"请启用IP显示");
+    } else {
+        measured = std::max(iputils::MeasureText(dc, internal_ip_), iputils::MeasureText(dc, external_ip_));
+    }
+    // 左右各留4像素（96 DPI下）边距
+    measured += ::MulDiv(8, key.dpi > 0 ? key.dpi : 96, 96);
+    return width_cache_.Update(key, measured);
+}
+
 /**
  * @brief 自定义绘制函数 - 垂直排列显示内网和外网IP
  * @param hDC 设备上下文句柄
@@ -235,10 +256,13 @@ int IpPluginItem::GetItemWidth() const {
  * @param w 绘制区域宽度
  * @param h 绘制区域高度
  * @param dark_mode 是否为深色模式
- * @details 内网IP显示在上方，外网IP显示在下方，减少水平空间占用
+ * @details 内网IP显示在上方，外网IP显示在下方，减少水平空间占用。
+ *          排版结果（每行位置和省略号截断后的文本）按显示内容版本、字体、DPI和区域大小缓存，
+ *          这些都未变化时重绘只调用ExtTextOut
  */
 void IpPluginItem::DrawItem(void* hDC, int x, int y, int w, int h, bool dark_mode) {
     if (!hDC) return;
+    const auto started = std::chrono::steady_clock::now();
     
     HDC dc = static_cast<HDC>(hDC);
     
@@ -247,44 +271,245 @@ void IpPluginItem::DrawItem(void* hDC, int x, int y, int w, int h, bool dark_mod
     ::SetTextColor(dc, textColor);
     ::SetBkMode(dc, TRANSPARENT);  // 透明背景
     
-    // 计算字体高度和行间距
-    TEXTMETRIC tm;
-    ::GetTextMetrics(dc, &tm);
-    int lineHeight = tm.tmHeight;
-    int totalLines = 0;
-    
-    // 统计要显示的行数
-    if (!internal_ip_.empty()) totalLines++;
-    if (!external_ip_.empty()) totalLines++;
+    // 内容、字体、DPI或区域大小变化时重新排版
+    iputils::RenderKey key = iputils::TextRenderCache::MakeKey(dc, content_version_, w, h);
+    if (!render_cache_.IsValid(key)) {
+        std::vector<const std::wstring*> lines;
+        if (!internal_ip_.empty()) lines.push_back(&internal_ip_);
+        if (!external_ip_.empty()) lines.push_back(&external_ip_);
+        // 没有可显示的内容时显示提示
+        render_cache_.Build(dc, key, lines, L"请启用IP显示");
+    }
     
-    if (totalLines == 0) {
-        // 没有可显示的内容，显示提示
-        RECT rect = {x, y, x + w, y + h};
-        ::DrawText(dc, L"请启用IP显示", -1, &rect, 
-                  DT_CENTER | DT_VCENTER | DT_SINGLELINE | DT_END_ELLIPSIS);
+    render_cache_.Paint(dc, x, y);
+    metrics::Global().paint_time.Record(std::chrono::steady_clock::now() - started);
+}
+
+// === IpPluginItem 资源占用图 ===
+
+int IpPluginItem::IsDrawResourceUsageGraph() const {
+    return provider_ && provider_->GetOptions().usage_graph != kUsageGraphNone ? 1 : 0;
+}
+
+/**
+ * @brief 由最近的样本计算资源占用图的值
+ * @param options 当前配置选项
+ * @details 样本来自刷新引擎维护的无锁样本环（每次外网查询或网关探测完成时写入一个），
+ *          取最近kGraphSmoothing个样本的平均耗时按usage_graph_full_ms换算为0~1，
+ *          失败的查询或探测按满格计，连接变慢或中断在任务栏上一眼可见
+ */
+void IpPluginItem::UpdateGraph(const PluginOptions& options) {
+    if (options.usage_graph == kUsageGraphNone || options.usage_graph_full_ms <= 0) {
+        graph_value_ = 0.0f;
         return;
     }
-    
-    // 计算垂直居中的起始位置
-    int totalHeight = totalLines * lineHeight;
-    int startY = y + (h - totalHeight) / 2;
-    int currentY = startY;
-    
-    // 绘制内网IP（如果存在）
-    if (!internal_ip_.empty()) {
-        RECT rect = {x, currentY, x + w, currentY + lineHeight};
-        ::DrawText(dc, internal_ip_.c_str(), -1, &rect, 
-                  DT_CENTER | DT_VCENTER | DT_SINGLELINE | DT_END_ELLIPSIS);
-        currentY += lineHeight;
+
+    std::uint32_t samples[kGraphSmoothing];
+    const unsigned long long total = options.usage_graph == kUsageGraphGatewayRtt
+        ? iputils::GetGatewayRttSamples(samples, kGraphSmoothing)
+        : iputils::GetLookupLatencySamples(samples, kGraphSmoothing);
+    const size_t n = std::min<size_t>(kGraphSmoothing, static_cast<size_t>(total));
+    if (n == 0) {
+        graph_value_ = 0.0f;
+        return;
     }
-    
-    // 绘制外网IP（如果存在）
-    if (!external_ip_.empty()) {
-        RECT rect = {x, currentY, x + w, currentY + lineHeight};
-        ::DrawText(dc, external_ip_.c_str(), -1, &rect, 
-                  DT_CENTER | DT_VCENTER | DT_SINGLELINE | DT_END_ELLIPSIS);
-        currentY += lineHeight;
+
+    const double full = options.usage_graph_full_ms;
+    double sum = 0.0;
+    for (size_t i = 0; i < n; ++i) {
+        sum += samples[i] == iputils::kFailedSample ? full : std::min<double>(samples[i], full);
+    }
+    graph_value_ = static_cast<float>(sum / n / full);
+}
+
+// === IpPluginItem 工具提示 ===
+
+namespace {
+
+/**
+ * @brief 追加一行"标签: 值"（非首行前加换行）
+ */
+void AppendLine(std::wstring& out, const wchar_t* label, const wchar_t* value) {
+    if (!out.empty()) out += L'\n';
+    out += label;
+    out += value;
+}
+
+/**
+ * @brief 追加" (值)"，值为空时不追加
+ */
+void AppendParen(std::wstring& out, const std::wstring& value) {
+    if (value.empty()) return;
+    out += L" (";
+    out += value;
+    out += L')';
+}
+
+/**
+ * @brief 追加数据新旧描述，如"3分钟前"
+ */
+void AppendAge(std::wstring& out, std::chrono::steady_clock::duration age) {
+    const long long seconds = std::chrono::duration_cast<std::chrono::seconds>(age).count();
+    wchar_t buf[32];
+    if (seconds < 60) {
+        swprintf_s(buf, L"%lld秒前", seconds < 0 ? 0 : seconds);
+    } else if (seconds < 3600) {
+        swprintf_s(buf, L"%lld分钟前", seconds / 60);
+    } else {
+        swprintf_s(buf, L"%lld小时前", seconds / 3600);
+    }
+    out += buf;
+}
+
+} // namespace
+
+/**
+ * @brief 由重建时保存的各字段生成工具提示的固定部分
+ * @details 头部依次为：内网IP（及所在接口）、外网IP、供应商和AS号、IPv6地址；
+ *          尾部为各接口的出口IP（明文HTTP探测，与HTTPS查询结果不同时标注未验证）。
+ *          两部分只在重建时生成，查询新旧和统计在Tooltip()中追加
+ */
+void IpPluginItem::ComposeTooltip(const PluginOptions& options) {
+    tooltip_head_.clear();
+    tooltip_tail_.clear();
+
+    if (!options.show_internal && !options.show_external) {
+        tooltip_head_ = L"请在选项中启用IP显示";
+        return;
+    }
+
+    if (options.show_internal) {
+        AppendLine(tooltip_head_, L"内网: ", internal_ipv4_.c_str());
+        AppendParen(tooltip_head_, interface_name_);
+    }
+
+    if (options.show_external) {
+        if (external_result_.IsValid()) {
+            AppendLine(tooltip_head_, L"外网: ", external_result_.ip.c_str());
+            AppendParen(tooltip_head_, external_result_.country);
+            if (!external_result_.as_name.empty()) {
+                AppendLine(tooltip_head_, L"供应商: ", external_result_.GetCompanyName().c_str());
+                AppendParen(tooltip_head_, external_result_.GetAsn());
+            }
+        } else {
+            AppendLine(tooltip_head_, L"外网: ", L"N/A");
+        }
     }
+
+    // 双栈：追加IPv6地址
+    if (!internal_ipv6_.empty()) AppendLine(tooltip_head_, L"内网IPv6: ", internal_ipv6_.c_str());
+    if (!external_ipv6_.empty()) AppendLine(tooltip_head_, L"外网IPv6: ", external_ipv6_.c_str());
+
+    // 多WAN：各接口的出口IP。探测是不经过代理的明文HTTP，应答未经TLS验证，
+    // 与HTTPS查询结果不同时不能当作同等可信的结果显示
+    for (const auto& e : egress_table_) {
+        AppendLine(tooltip_tail_, e.adapter_name.c_str(), L": ");
+        if (e.egress_ip.empty()) {
+            tooltip_tail_ += L"N/A";
+            continue;
+        }
+        tooltip_tail_ += e.egress_ip;
+        if (!external_result_.IsValid() || e.egress_ip != external_result_.ip) tooltip_tail_ += L" (HTTP, 未验证)";
+    }
+}
+
+/**
+ * @brief 生成工具提示
+ * @details 复制重建时生成的头部，追加最近一次外网查询的服务器/延迟/数据新旧和累计统计，
+ *          再追加尾部；随时间变化的部分用栈上缓冲区格式化，缓冲区容量足够时不分配内存
+ */
+const wchar_t* IpPluginItem::Tooltip() {
+    metrics::Global().tooltips.Add();
+    tooltip_.assign(tooltip_head_);  // 保留容量，不重新分配
+    if (!provider_) return tooltip_.c_str();
+    const auto& options = provider_->GetOptions();
+
+    // 最近一次外网查询：服务器、延迟和数据新旧
+    if (options.show_external) {
+        const iputils::ExternalQueryInfo info = iputils::GetExternalQueryInfo();
+        if (info.provider) {
+            AppendLine(tooltip_, L"查询: ", info.provider);
+            wchar_t buf[32];
+            swprintf_s(buf, L", %lld ms, ", (long long)info.latency.count());
+            tooltip_ += buf;
+            AppendAge(tooltip_, std::chrono::steady_clock::now() - info.fetched_at);
+        }
+
+        // 累计统计：查询次数和刷新时的缓存命中率
+        const auto& m = metrics::Global();
+        const unsigned long long hits = m.cache_hits.Value();
+        const unsigned long long total = hits + m.cache_misses.Value();
+        if (total > 0) {
+            wchar_t buf[64];
+            swprintf_s(buf, L"统计: 查询 %llu 次, 缓存命中 %llu%%", m.TotalLookups(), hits * 100 / total);
+            AppendLine(tooltip_, L"", buf);
+        }
+    }
+
+    if (!tooltip_tail_.empty()) {
+        if (!tooltip_.empty()) tooltip_ += L'\n';
+        tooltip_ += tooltip_tail_;
+    }
+    return tooltip_.c_str();
+}
+
+// === RttPluginItem ===
+
+bool RttPluginItem::Update() {
+    if (!provider_) return false;
+    const auto& options = provider_->GetOptions();
+    const unsigned long options_version = provider_->OptionsVersion();
+
+    unsigned long version = 0;
+    if (options.rtt_probe_interval.count() > 0) {
+        version = iputils::PollRttProbe(iputils::ExternalIpOptions(), options.rtt_probe_interval);
+    }
+    if (valid_ && version == probe_version_ && options_version == options_version_) return false;
+    probe_version_ = version;
+    options_version_ = options_version;
+    valid_ = true;
+
+    if (options.rtt_probe_interval.count() <= 0) {
+        report_ = iputils::RttReport();
+        value_ = L"未启用";
+        return true;
+    }
+
+    report_ = iputils::GetRttReport();
+    // 窗口内没有成功样本时显示"-"，全部丢失时显示"超时"
+    auto format = [](const iputils::RttSummary& s) -> std::wstring {
+        if (s.samples > 0) return std::to_wstring(s.avg_ms);
+        return s.lost > 0 ? L"超时" : L"-";
+    };
+    value_ = format(report_.gateway) + L" / " + format(report_.provider) + L" ms";
+    return true;
+}
+
+namespace {
+
+/**
+ * @brief 追加一个探测目标的统计行，如"网关RTT: 192.168.1.1 min 1 / avg 2 / p95 4 ms, 丢失 0/32"
+ */
+void AppendRttLine(std::wstring& out, const wchar_t* label, const iputils::RttSummary& s) {
+    if (s.target.empty()) return;
+    if (!out.empty()) out += L'\n';
+    out += label;
+    out += s.target;
+    wchar_t buf[96];
+    if (s.samples > 0) {
+        swprintf_s(buf, L" min %u / avg %u / p95 %u ms, 丢失 %u/%u", s.min_ms, s.avg_ms, s.p95_ms, s.lost, s.samples + s.lost);
+    } else {
+        swprintf_s(buf, L" 无应答, 丢失 %u/%u", s.lost, s.lost);
+    }
+    out += buf;
+}
+
+} // namespace
+
+void RttPluginItem::AppendTooltip(std::wstring& out) const {
+    if (!valid_ || !provider_ || provider_->GetOptions().rtt_probe_interval.count() <= 0) return;
+    AppendRttLine(out, L"网关RTT: ", report_.gateway);
+    AppendRttLine(out, L"服务器RTT: ", report_.provider);
 }
 
 // === 插件工厂导出函数 ===
@@ -16,6 +16,11 @@
 #include <windows.h>
 #include "PluginInterface.h"  // TrafficMonitor插件接口定义
 #include "ip_item.h"          // IP文本提供器
+#include "ip_service.h"       // IP地址服务
+#include "render_cache.h"     // 自定义绘制排版缓存
+#include "options_store.h"    // 配置文件延迟写入
+#include "config_watcher.h"   // 配置文件变化监视
+#include "metrics.h"          // 运行统计
 
 extern HINSTANCE g_hInst;    // 全局实例句柄
 
@@ -30,7 +35,9 @@ public:
      * @brief 构造函数
      * @param provider IP文本提供器指针
      */
-    explicit IpPluginItem(IpTextProvider* provider) : provider_(provider) {}
+    explicit IpPluginItem(IpTextProvider* provider) : provider_(provider) {
+        tooltip_.reserve(kTooltipReserve);
+    }
 
     // === IPluginItem接口实现 ===
     const wchar_t* GetItemName() const override { return L"内外网IP显示"; }                        ///< 项目名称
@@ -44,78 +51,272 @@ public:
     // === 自定义绘制接口实现 ===
     bool IsCustomDraw() const override { return true; }                                      ///< 启用自定义绘制模式
     int GetItemWidth() const override;                                                       ///< 获取显示区域宽度
+    int GetItemWidthEx(void* hDC) const override;                                            ///< 按实际文本测量显示区域宽度
     void DrawItem(void* hDC, int x, int y, int w, int h, bool dark_mode) override;          ///< 自定义绘制函数
 
+    // === 资源占用图接口实现 ===
+    int IsDrawResourceUsageGraph() const override;                                           ///< 是否显示资源占用图（usage_graph选项）
+    float GetResourceUsageGraphValue() const override { return graph_value_; }               ///< 资源占用图的值（0~1，每次Update时计算）
+
     /**
      * @brief 更新IP地址数据
      * @param force_external_refresh 是否强制刷新外网IP
-     * @details 通过IP文本提供器获取最新的IP地址信息，分别存储内网和外网IP
+     * @return true表示显示数据已重建，false表示各数据源都未变化
+     * @details 先驱动外网IP刷新计划并收集各数据源的版本号（配置选项、网络状态、外网数据），
+     *          与上次重建时的版本号相同则直接返回；否则从缓存取数据重建各显示字符串
      */
-    void Update(bool force_external_refresh) {
+    bool Update(bool force_external_refresh) {
         if (!provider_) { 
             value_.clear();
             internal_ip_.clear();
             external_ip_.clear();
-            return; 
+            internal_ipv4_.clear();
+            external_result_ = iputils::IpWithCountry();
+            interface_name_.clear();
+            egress_table_.clear();
+            tooltip_head_.clear();
+            tooltip_tail_.clear();
+            graph_value_ = 0.0f;
+            ++content_version_;
+            versions_valid_ = false;
+            return true; 
         }
-        
-        // 获取完整文本（备用）
-        value_ = provider_->GetText(force_external_refresh);
-        
-        // 分别获取内网和外网IP用于垂直显示
+
         const auto& options = provider_->GetOptions();
-        
+        UpdateGraph(options);  // 占用图每次刷新都取样，与显示文本是否重建无关
+
+        SourceVersions versions;
+        versions.options = provider_->OptionsVersion();
+        if (options.show_internal || options.show_ipv6) {
+            versions.network = iputils::GetNetworkVersion();
+        }
+        if (options.show_external) {
+            // 外网IPv4和IPv6共用同一个版本计数器，取最后一次的返回值即可
+            const iputils::ExternalIpOptions ext_opt = MakeExternalOptions(options);
+            versions.external = iputils::PollExternalIPv4(ext_opt, force_external_refresh);
+            if (options.show_ipv6) versions.external = iputils::PollExternalIPv6(ext_opt);
+        }
+
+        // 稳态下各数据源都未变化，只做一次版本比较
+        if (versions_valid_ && versions == versions_) return false;
+        versions_ = versions;
+        versions_valid_ = true;
+
+        Rebuild(options);
+        return true;
+    }
+
+    /**
+     * @brief 获取原始IP地址值
+     * @return IP地址字符串的常量引用
+     */
+    const std::wstring& RawValue() const { return value_; }
+
+    /**
+     * @brief 生成工具提示文本
+     * @return 指向内部缓冲区的文本，下一次调用前有效
+     * @details 不随时间变化的部分在重建时生成（见ComposeTooltip），每次请求只追加
+     *          查询延迟、数据新旧和统计；缓冲区预留容量并重复使用
+     */
+    const wchar_t* Tooltip();
+
+    /// 内网IPv6地址（未启用或获取失败时为空）
+    const std::wstring& InternalIPv6() const { return internal_ipv6_; }
+    /// 外网IPv6地址（未启用或获取失败时为空）
+    const std::wstring& ExternalIPv6() const { return external_ipv6_; }
+
+    /// 显示数据重建次数（用于确认只在数据变化时重建）
+    unsigned long long RebuildCount() const { return rebuild_count_; }
+
+    /// 显示内容版本号（内网/外网显示文本变化时加一）
+    unsigned long ContentVersion() const { return content_version_; }
+    /// 自定义绘制的排版缓存
+    const iputils::TextRenderCache& RenderCache() const { return render_cache_; }
+    /// 显示项目宽度缓存
+    const iputils::ItemWidthCache& WidthCache() const { return width_cache_; }
+
+private:
+    /**
+     * @brief 各数据源的版本号
+     * @details 未启用的数据源保持0，不参与变化判断
+     */
+    struct SourceVersions {
+        unsigned long options = 0;   ///< 配置选项版本号
+        unsigned long network = 0;   ///< 网络状态版本号（适配器清单快照）
+        unsigned long external = 0;  ///< 外网数据版本号
+
+        bool operator==(const SourceVersions& o) const {
+            return options == o.options && network == o.network && external == o.external;
+        }
+    };
+
+    /**
+     * @brief 由插件配置生成外网IP获取选项
+     */
+    static iputils::ExternalIpOptions MakeExternalOptions(const PluginOptions& options) {
+        iputils::ExternalIpOptions opt;
+        // 配置智能缓存策略
+        if (options.enable_smart_cache) {
+            opt.strategy = iputils::CacheStrategy::HYBRID;
+            opt.min_refresh = options.external_refresh;
+            opt.fast_refresh = options.fast_refresh;
+            opt.max_refresh = options.max_refresh;
+        } else {
+            opt.strategy = iputils::CacheStrategy::FIXED;
+            opt.min_refresh = options.external_refresh;
+        }
+        opt.prewarm_lead = options.prewarm_lead;
+        opt.probe_interfaces = options.show_interface_egress;
+        return opt;
+    }
+
+    /**
+     * @brief 由最近的样本计算资源占用图的值
+     */
+    void UpdateGraph(const PluginOptions& options);
+
+    /**
+     * @brief 从各数据源的缓存重建显示字符串
+     * @param options 当前配置选项
+     */
+    void Rebuild(const PluginOptions& options) {
+        ++rebuild_count_;
+        metrics::Global().rebuilds.Add();
+
         // 获取外网IP和公司信息（无论是否显示内网都需要获取）
         iputils::IpWithCountry ext_result;
+        std::wstring external_ip;
         if (options.show_external) {
-            iputils::ExternalIpOptions opt;
-            // 配置智能缓存策略
-            if (options.enable_smart_cache) {
-                opt.strategy = iputils::CacheStrategy::HYBRID;
-                opt.min_refresh = options.external_refresh;
-                opt.fast_refresh = options.fast_refresh;
-                opt.max_refresh = options.max_refresh;
+            ext_result = iputils::GetCachedExternalIPv4();
+            if (ext_result.IsValid()) {
+                external_ip = ext_result.GetDisplayString();  // 使用格式化字符串（包含国家代码）
             } else {
-                opt.strategy = iputils::CacheStrategy::FIXED;
-                opt.min_refresh = options.external_refresh;
+                external_ip = L"N/A";
             }
-            
-            ext_result = iputils::GetExternalIPv4WithCountry(opt, force_external_refresh);
         }
-        
+
+        std::wstring internal_ip;
         if (options.show_internal) {
-            // 显示内网IP
-            internal_ip_ = iputils::GetInternalIPv4(options.preferred_adapter);
-            if (internal_ip_.empty()) internal_ip_ = L"N/A";
-        } else if (options.show_external && ext_result.IsValid() && !ext_result.as_name.empty()) {
+            internal_ip = iputils::GetInternalIPv4();  // 首选适配器已在IpTextProvider::SetOptions中解析
+            if (internal_ip.empty()) internal_ip = L"N/A";
+            interface_name_ = iputils::GetInternalInterfaceName();
+        } else {
+            interface_name_.clear();
+        }
+        internal_ipv4_ = internal_ip;
+
+        // 完整文本（备用）
+        value_ = provider_->FormatText(internal_ip, external_ip, ext_result);
+
+        if (!options.show_internal && options.show_external && ext_result.IsValid() && !ext_result.as_name.empty()) {
             // 内网关闭但外网开启时，在内网位置显示公司名称
-            internal_ip_ = ext_result.GetCompanyName();
+            internal_ip = ext_result.GetCompanyName();
+        }
+
+        // 显示内容变化时更新版本号，绘制时据此判断排版缓存是否可用
+        if (internal_ip != internal_ip_ || external_ip != external_ip_) {
+            internal_ip_.swap(internal_ip);
+            external_ip_.swap(external_ip);
+            ++content_version_;
+        }
+
+        // IPv6地址（仅用于工具提示）
+        if (options.show_ipv6) {
+            iputils::Ipv6SelectOptions v6opt;
+            v6opt.skip_temporary = options.ipv6_skip_temporary;
+            v6opt.skip_deprecated = options.ipv6_skip_deprecated;
+            internal_ipv6_ = options.show_internal ? iputils::GetInternalIPv6(v6opt) : std::wstring();
+            external_ipv6_ = options.show_external ? iputils::GetCachedExternalIPv6() : std::wstring();
         } else {
-            internal_ip_.clear();
+            internal_ipv6_.clear();
+            external_ipv6_.clear();
         }
-        
-        if (options.show_external) {
-            if (ext_result.IsValid()) {
-                external_ip_ = ext_result.GetDisplayString();  // 使用格式化字符串（包含国家代码）
-            } else {
-                external_ip_ = L"N/A";
-            }
+
+        // 多WAN：各接口的出口IP（仅用于工具提示）
+        if (options.show_external && options.show_interface_egress) {
+            egress_table_ = iputils::GetInterfaceEgressTable();
         } else {
-            external_ip_.clear();
+            egress_table_.clear();
         }
+        external_result_ = std::move(ext_result);
+        ComposeTooltip(options);
     }
 
     /**
-     * @brief 获取原始IP地址值
-     * @return IP地址字符串的常量引用
+     * @brief 生成工具提示中只随重建变化的头部和尾部
      */
-    const std::wstring& RawValue() const { return value_; }
+    void ComposeTooltip(const PluginOptions& options);
+
+    /// 工具提示缓冲区预留容量（字符）
+    static constexpr size_t kTooltipReserve = 512;
+    /// 资源占用图取平均的样本个数
+    static constexpr size_t kGraphSmoothing = 3;
 
-private:
     IpTextProvider* provider_{};  ///< IP文本提供器指针
     std::wstring value_;          ///< 缓存的IP地址显示文本（备用）
     std::wstring internal_ip_;    ///< 内网IP地址（用于垂直显示）
     std::wstring external_ip_;    ///< 外网IP地址（用于垂直显示）
+    std::wstring internal_ipv6_;  ///< 内网IPv6地址（用于工具提示）
+    std::wstring external_ipv6_;  ///< 外网IPv6地址（用于工具提示）
+    std::wstring internal_ipv4_;  ///< 内网IPv4地址（未启用时为空，获取失败为"N/A"）
+    std::wstring interface_name_; ///< 内网IPv4所在接口名称
+    iputils::IpWithCountry external_result_;            ///< 外网查询结果
+    std::vector<iputils::InterfaceEgress> egress_table_; ///< 各接口的出口IP
+    std::wstring tooltip_;        ///< 工具提示缓冲区（重复使用）
+    std::wstring tooltip_head_;   ///< 工具提示头部（内网、外网、供应商、IPv6，重建时生成）
+    std::wstring tooltip_tail_;   ///< 工具提示尾部（各接口的出口IP，重建时生成）
+    unsigned long content_version_ = 0;     ///< 显示内容版本号
+    SourceVersions versions_;               ///< 上次重建时各数据源的版本号
+    bool versions_valid_ = false;           ///< versions_是否有效（首次更新前为false）
+    unsigned long long rebuild_count_ = 0;  ///< 显示数据重建次数
+    iputils::TextRenderCache render_cache_;  ///< 排版缓存（按内容版本、字体、DPI和区域大小失效）
+    mutable iputils::ItemWidthCache width_cache_;  ///< 宽度缓存（按内容版本、字体和DPI失效，带滞后）
+    float graph_value_ = 0.0f;              ///< 资源占用图的值（0~1）
+};
+
+/**
+ * @brief 往返时延显示项目类
+ * @details 第二个显示项目，显示到默认网关和到查询服务器的往返时延（滚动窗口平均值）。
+ *          探测与IP显示项目共用IP地址服务的适配器快照和工作线程，不另行枚举网络
+ */
+class RttPluginItem : public IPluginItem {
+public:
+    /**
+     * @brief 构造函数
+     * @param provider IP文本提供器指针（用于读取配置选项）
+     */
+    explicit RttPluginItem(IpTextProvider* provider) : provider_(provider) {}
+
+    // === IPluginItem接口实现 ===
+    const wchar_t* GetItemName() const override { return L"网关/服务器延迟"; }                    ///< 项目名称
+    const wchar_t* GetItemId() const override { return L"gateway_provider_rtt"; }            ///< 项目唯一标识符
+    const wchar_t* GetItemLableText() const override { return L"RTT"; }                      ///< 标签文本
+    const wchar_t* GetItemValueText() const override { return value_.c_str(); }              ///< "网关 / 服务器"平均往返时延
+    const wchar_t* GetItemValueSampleText() const override { return L"999 / 999 ms"; }       ///< 示例文本（用于计算宽度）
+
+    /**
+     * @brief 驱动探测计划并在结果变化时重建显示文本
+     * @return true表示显示文本已重建
+     * @details 未开启探测（rtt_probe_seconds为0）时显示"未启用"，不发起任何探测
+     */
+    bool Update();
+
+    /**
+     * @brief 向工具提示追加往返时延统计（最小/平均/p95和丢失次数）
+     * @details 未开启探测时不追加
+     */
+    void AppendTooltip(std::wstring& out) const;
+
+    /// 当前的探测结果
+    const iputils::RttReport& Report() const { return report_; }
+
+private:
+    IpTextProvider* provider_{};        ///< IP文本提供器指针
+    std::wstring value_;                ///< 显示文本
+    iputils::RttReport report_;         ///< 上次重建时的探测结果
+    unsigned long probe_version_ = 0;   ///< 上次重建时的探测数据版本号
+    unsigned long options_version_ = 0; ///< 上次重建时的配置选项版本号
+    bool valid_ = false;                ///< 是否已重建过
 };
 
 /**
@@ -144,7 +345,7 @@ public:
     const wchar_t* GetTooltipInfo() override;                                    ///< 获取工具提示
 
     // === 插件命令接口实现 ===
-    int GetCommandCount() override { return 3; }                                 ///< 命令数量（3个：切换内网、切换外网、强制刷新）
+    int GetCommandCount() override { return 4; }                                 ///< 命令数量（4个：切换内网、切换外网、强制刷新、导出诊断信息）
     const wchar_t* GetCommandName(int command_index) override;                   ///< 获取命令名称
     void OnPluginCommand(int command_index, void* hWnd, void* para) override;    ///< 处理插件命令
     int IsCommandChecked(int command_index) override;                            ///< 命令是否选中状态
@@ -153,14 +354,22 @@ private:
     // === 私有辅助方法 ===
     void LoadOptions();                                                           ///< 从配置文件加载选项
     void SaveOptions();                                                           ///< 保存选项到配置文件
+    void ReloadOptions();                                                         ///< 配置文件被外部修改后重新加载
+    void DumpDiagnostics();                                                       ///< 导出运行统计到诊断文件
 
 private:
     // === 插件状态和组件 ===
+    // IP地址服务必须最先构造、最后析构：其余成员（包括构造函数中设置首选适配器的text_provider_）都通过它获取数据
+    iputils::IpService service_;                      ///< IP地址服务（缓存、后台线程、变化通知）
+    iputils::ScopedIpService service_scope_{ service_ }; ///< 插件存活期间把service_设为当前服务
     ITrafficMonitor* app_{};                          ///< TrafficMonitor应用程序接口指针
     std::wstring config_dir_;                         ///< 配置文件目录路径
     PluginOptions options_{};                         ///< 当前配置选项
+    OptionsStore store_;                              ///< 配置文件存储（延迟批量写入）
+    ConfigWatcher watcher_;                           ///< 配置文件变化监视（热加载）
     IpTextProvider text_provider_{ options_ };       ///< IP文本提供器
     IpPluginItem item_{ &text_provider_ };           ///< 显示项目实例
+    RttPluginItem rtt_item_{ &text_provider_ };      ///< 往返时延显示项目实例
+    std::wstring tooltip_;                            ///< 合并两个显示项目的工具提示缓冲区（重复使用）
     bool force_refresh_next_ = false;                 ///< 下次更新是否强制刷新外网IP
-    std::wstring tooltip_;                            ///< 工具提示文本缓存
 };
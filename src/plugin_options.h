@@ -24,13 +24,28 @@ struct PluginOptions {
     // === 网络设置 ===
     std::wstring preferred_adapter;                     ///< 首选网络适配器（FriendlyName或AdapterName）
     std::chrono::minutes external_refresh{5};          ///< 外网IP标准刷新间隔（分钟）
+    bool show_interface_egress = false;                 ///< 在工具提示中显示各接口的出口IP（多WAN）
+    bool show_ipv6 = false;                             ///< 在工具提示中显示内网/外网IPv6地址
+    bool ipv6_skip_temporary = true;                    ///< 选择内网IPv6时跳过临时（隐私扩展）地址
+    bool ipv6_skip_deprecated = true;                   ///< 选择内网IPv6时跳过已弃用地址
     
     // === 智能缓存设置 ===
     bool enable_smart_cache = true;                     ///< 启用智能缓存（推荐）
     std::chrono::seconds fast_refresh{30};             ///< 网络变化后快速刷新间隔（秒）
     std::chrono::minutes max_refresh{15};              ///< 稳定期最大刷新间隔（分钟）
+    std::chrono::seconds prewarm_lead{0};              ///< 计划刷新前预热连接的提前量（秒，0表示不预热）
+    std::chrono::seconds rtt_probe_interval{0};        ///< 网关/服务器往返时延探测间隔（秒，0表示不探测）
     
     // === 界面配置 ===
     std::wstring separator = L" | ";                   ///< 内外网IP之间的分隔符
+    int usage_graph = 0;                                ///< 任务栏资源占用图的数据（0不显示，1外网查询耗时，2网关往返时延）
+    int usage_graph_full_ms = 1000;                     ///< 资源占用图满格对应的耗时（毫秒）
 };
 
+/// 资源占用图数据：不显示
+constexpr int kUsageGraphNone = 0;
+/// 资源占用图数据：外网查询耗时
+constexpr int kUsageGraphLookupLatency = 1;
+/// 资源占用图数据：网关往返时延（需要开启往返时延探测）
+constexpr int kUsageGraphGatewayRtt = 2;
+
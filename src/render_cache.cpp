@@ -0,0 +1,122 @@
+﻿/**
+ * @file render_cache.cpp
+ * @brief 自定义绘制的排版缓存实现
+ * @author Lynn
+ * @date 2025
+ */
+
+#include "render_cache.h"
+
+#include <algorithm>
+
+namespace iputils {
+
+int MeasureText(HDC dc, const std::wstring& text) {
+    SIZE size{};
+    if (text.empty() || !::GetTextExtentPoint32W(dc, text.c_str(), (int)text.size(), &size)) return 0;
+    return size.cx;
+}
+
+std::wstring EllipsizeToWidth(HDC dc, const std::wstring& text, int max_width, int& width) {
+    width = MeasureText(dc, text);
+    if (width <= max_width) return text;
+
+    // 与DrawText的DT_END_ELLIPSIS一致：保留能放下的前缀，后接"..."
+    static const std::wstring kEllipsis = L"...";
+    const int ellipsis_width = MeasureText(dc, kEllipsis);
+    int fit = 0;
+    SIZE size{};
+    if (max_width > ellipsis_width) {
+        ::GetTextExtentExPointW(dc, text.c_str(), (int)text.size(), max_width - ellipsis_width, &fit, nullptr, &size);
+    }
+    std::wstring result = text.substr(0, (size_t)fit) + kEllipsis;
+    width = MeasureText(dc, result);
+    return result;
+}
+
+RenderKey TextRenderCache::MakeKey(HDC dc, unsigned long content_version, int w, int h) {
+    RenderKey key;
+    key.content_version = content_version;
+    LOGFONTW lf{};
+    HGDIOBJ font = ::GetCurrentObject(dc, OBJ_FONT);
+    if (font && ::GetObjectW(font, sizeof(lf), &lf) == sizeof(lf)) {
+        key.font.height = lf.lfHeight;
+        key.font.weight = lf.lfWeight;
+        key.font.italic = lf.lfItalic;
+        wcsncpy_s(key.font.face, lf.lfFaceName, _TRUNCATE);
+    }
+    key.dpi = ::GetDeviceCaps(dc, LOGPIXELSY);
+    key.width = w;
+    key.height = h;
+    return key;
+}
+
+void TextRenderCache::Build(HDC dc, const RenderKey& key, const std::vector<const std::wstring*>& lines, const wchar_t* placeholder) {
+    runs_.clear();
+    key_ = key;
+    valid_ = true;
+    ++builds_;
+
+    TEXTMETRICW tm{};
+    ::GetTextMetricsW(dc, &tm);
+    const int line_height = tm.tmHeight;
+    const int w = key.width;
+    const int h = key.height;
+
+    auto add_run = [&](const std::wstring& text, int top, int bottom) {
+        Run run;
+        int width = 0;
+        run.text = EllipsizeToWidth(dc, text, w, width);
+        run.dx = std::max(0, (w - width) / 2);
+        run.dy = top + ((bottom - top) - line_height) / 2;
+        run.clip = { 0, top, w, bottom };
+        runs_.push_back(std::move(run));
+    };
+
+    if (lines.empty()) {
+        // 没有可显示的内容，提示文本在整个区域内居中
+        if (placeholder) add_run(placeholder, 0, h);
+        return;
+    }
+
+    // 整体垂直居中
+    const int total_height = (int)lines.size() * line_height;
+    int current_y = (h - total_height) / 2;
+    for (const std::wstring* line : lines) {
+        add_run(*line, current_y, current_y + line_height);
+        current_y += line_height;
+    }
+}
+
+void TextRenderCache::Paint(HDC dc, int x, int y) const {
+    const UINT old_align = ::SetTextAlign(dc, TA_LEFT | TA_TOP | TA_NOUPDATECP);
+    for (const Run& run : runs_) {
+        RECT clip = { run.clip.left + x, run.clip.top + y, run.clip.right + x, run.clip.bottom + y };
+        ::ExtTextOutW(dc, x + run.dx, y + run.dy, ETO_CLIPPED, &clip, run.text.c_str(), (UINT)run.text.size(), nullptr);
+    }
+    if (old_align != GDI_ERROR) ::SetTextAlign(dc, old_align);
+}
+
+int ItemWidthCache::Update(const RenderKey& key, int measured) {
+    const int dpi = key.dpi > 0 ? key.dpi : 96;
+    const int step = ::MulDiv(kStep, dpi, 96);
+    const int shrink = ::MulDiv(kShrinkThreshold, dpi, 96);
+    const int rounded = (measured + step - 1) / step * step;
+
+    // 字体或DPI变化时原来的宽度没有参考意义，直接重置
+    const bool reset = !valid_ || key.font != key_.font || key.dpi != key_.dpi;
+    int reported = reported_;
+    if (reset || measured > reported_ || reported_ - measured > shrink) {
+        reported = rounded;
+    }
+
+    key_ = key;
+    valid_ = true;
+    if (reported != reported_) {
+        reported_ = reported;
+        ++changes_;
+    }
+    return reported_;
+}
+
+} // namespace iputils
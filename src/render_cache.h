@@ -0,0 +1,157 @@
+﻿/**
+ * @file render_cache.h
+ * @brief 自定义绘制的排版缓存
+ * @details 把每行文本的位置和省略号截断后的字符串缓存起来，
+ *          显示内容、字体、DPI和绘制区域大小都未变化时，重绘只需逐行调用ExtTextOut
+ * @author Lynn
+ * @date 2025
+ */
+
+#pragma once
+
+#include <cwchar>
+#include <string>
+#include <vector>
+#include <windows.h>
+
+namespace iputils {
+
+/**
+ * @brief 测量单行文本宽度（像素）
+ */
+int MeasureText(HDC dc, const std::wstring& text);
+
+/**
+ * @brief 按DT_END_ELLIPSIS的规则截断文本
+ * @param dc 已选入字体的设备上下文
+ * @param text 原始文本
+ * @param max_width 可用宽度（像素）
+ * @param width 输出：截断后文本的宽度
+ * @return 能放下时返回原文本，否则返回末尾为"..."的截断文本
+ */
+std::wstring EllipsizeToWidth(HDC dc, const std::wstring& text, int max_width, int& width);
+
+/**
+ * @brief 字体标识
+ * @details 取自GetObject得到的LOGFONT，不使用HFONT句柄：
+ *          句柄可能在字体销毁后被复用于另一种字体，同一种字体也可能每次重新创建
+ */
+struct FontIdentity {
+    LONG height = 0;                    ///< 字体高度（逻辑单位）
+    LONG weight = 0;                    ///< 字重
+    BYTE italic = 0;                    ///< 是否斜体
+    wchar_t face[LF_FACESIZE] = {};     ///< 字体名称
+
+    bool operator==(const FontIdentity& o) const {
+        return height == o.height && weight == o.weight && italic == o.italic && wcscmp(face, o.face) == 0;
+    }
+    bool operator!=(const FontIdentity& o) const { return !(*this == o); }
+};
+
+/**
+ * @brief 排版缓存的键
+ * @details x、y不参与比较：缓存的是相对绘制区域左上角的位置
+ */
+struct RenderKey {
+    unsigned long content_version = 0;  ///< 显示内容版本号
+    FontIdentity font;                  ///< 设备上下文当前字体
+    int dpi = 0;                        ///< 设备上下文的纵向DPI
+    int width = 0;                      ///< 绘制区域宽度
+    int height = 0;                     ///< 绘制区域高度
+
+    bool operator==(const RenderKey& o) const {
+        return content_version == o.content_version && dpi == o.dpi
+            && width == o.width && height == o.height && font == o.font;
+    }
+    bool operator!=(const RenderKey& o) const { return !(*this == o); }
+};
+
+/**
+ * @brief 多行居中文本的排版缓存
+ */
+class TextRenderCache {
+public:
+    /**
+     * @brief 根据设备上下文当前状态生成缓存键
+     */
+    static RenderKey MakeKey(HDC dc, unsigned long content_version, int w, int h);
+
+    /// 缓存是否可用于该键
+    bool IsValid(const RenderKey& key) const { return valid_ && key == key_; }
+
+    /**
+     * @brief 重新排版
+     * @param dc 设备上下文（已选入绘制字体）
+     * @param key 缓存键
+     * @param lines 要显示的行（每行水平居中，整体垂直居中）
+     * @param placeholder 没有任何行时显示的提示文本
+     */
+    void Build(HDC dc, const RenderKey& key, const std::vector<const std::wstring*>& lines, const wchar_t* placeholder);
+
+    /**
+     * @brief 按缓存的排版结果绘制
+     * @details 只调用ExtTextOut，不做测量；使用调用方已设置的文字颜色和背景模式
+     */
+    void Paint(HDC dc, int x, int y) const;
+
+    /// 排版次数（用于确认重绘没有重复排版）
+    unsigned long long BuildCount() const { return builds_; }
+
+    /// 使缓存失效
+    void Invalidate() { valid_ = false; }
+
+private:
+    /**
+     * @brief 一行排版结果（坐标相对绘制区域左上角）
+     */
+    struct Run {
+        std::wstring text;  ///< 截断后的文本
+        int dx = 0;         ///< 文本起点X
+        int dy = 0;         ///< 文本起点Y
+        RECT clip{};        ///< 裁剪矩形
+    };
+
+    RenderKey key_;
+    bool valid_ = false;
+    std::vector<Run> runs_;
+    unsigned long long builds_ = 0;
+};
+
+/**
+ * @brief 显示项目宽度缓存（带滞后）
+ * @details 测量结果按内容版本、字体和DPI缓存；对外报告的宽度按步长向上取整，
+ *          内容变长超过当前宽度时立即加宽，变短时只有空出超过收缩阈值才收窄，
+ *          避免文本的微小变化导致任务栏反复重新布局。字体或DPI变化时直接按新测量值重置
+ */
+class ItemWidthCache {
+public:
+    /// 宽度取整步长（96 DPI下的像素）
+    static constexpr int kStep = 8;
+    /// 收缩阈值（96 DPI下的像素）
+    static constexpr int kShrinkThreshold = 24;
+
+    /// 缓存是否可用于该键（只比较内容版本、字体和DPI）
+    bool IsValid(const RenderKey& key) const { return valid_ && key == key_; }
+
+    /**
+     * @brief 记录新的测量结果
+     * @param key 缓存键
+     * @param measured 实际需要的宽度（像素）
+     * @return 对外报告的宽度（像素）
+     */
+    int Update(const RenderKey& key, int measured);
+
+    /// 当前对外报告的宽度（像素）
+    int Reported() const { return reported_; }
+
+    /// 报告宽度的变化次数（用于确认滞后生效）
+    unsigned long long ReportedChanges() const { return changes_; }
+
+private:
+    RenderKey key_;
+    bool valid_ = false;
+    int reported_ = 0;
+    unsigned long long changes_ = 0;
+};
+
+} // namespace iputils
@@ -0,0 +1,106 @@
+﻿/**
+ * @file route_table.cpp
+ * @brief 默认路由缓存实现
+ * @author Lynn
+ * @date 2025
+ */
+
+#include "route_table.h"
+#include "metrics.h"
+#include "module_state.h"
+
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+
+#include <windows.h>
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <iphlpapi.h>
+#include <netioapi.h>
+
+#pragma comment(lib, "Iphlpapi.lib")
+#pragma comment(lib, "Ws2_32.lib")
+
+namespace iputils {
+
+namespace {
+
+/// 用于查询最佳路由的公网目的地址（8.8.8.8，仅做路由计算，不发送任何数据）
+constexpr uint32_t kProbeDestination = 0x08080808;
+
+VOID NETIOAPI_API_ OnRouteChange(PVOID context, PMIB_IPFORWARD_ROW2, MIB_NOTIFICATION_TYPE) {
+    static_cast<DefaultRouteCache*>(context)->Invalidate();
+}
+
+VOID NETIOAPI_API_ OnAddressChange(PVOID context, PMIB_UNICASTIPADDRESS_ROW, MIB_NOTIFICATION_TYPE) {
+    static_cast<DefaultRouteCache*>(context)->Invalidate();
+}
+
+std::wstring FormatIPv4(const SOCKADDR_INET& addr) {
+    if (addr.si_family != AF_INET) return L"";
+    wchar_t buf[INET_ADDRSTRLEN] = {};
+    if (!InetNtopW(AF_INET, &addr.Ipv4.sin_addr, buf, INET_ADDRSTRLEN)) return L"";
+    return buf;
+}
+
+} // namespace
+
+DefaultRouteCache::DefaultRouteCache() {
+    PinModule();  // 通知回调在系统线程上运行本模块的代码
+    HANDLE h = nullptr;
+    if (NotifyRouteChange2(AF_INET, OnRouteChange, this, FALSE, &h) == NO_ERROR) route_notify_ = h;
+    h = nullptr;
+    if (NotifyUnicastIpAddressChange(AF_INET, OnAddressChange, this, FALSE, &h) == NO_ERROR) address_notify_ = h;
+}
+
+DefaultRouteCache::~DefaultRouteCache() {
+    // 模块卸载时持有加载器锁，CancelMibChangeNotify2会等待回调线程，可能死锁；进程正在退出，不再取消
+    if (IsModuleDetaching()) return;
+    if (route_notify_) CancelMibChangeNotify2(static_cast<HANDLE>(route_notify_));
+    if (address_notify_) CancelMibChangeNotify2(static_cast<HANDLE>(address_notify_));
+}
+
+std::shared_ptr<const DefaultRoute> DefaultRouteCache::Get() {
+    // 注册通知失败时无法得知变化，每次都重新查询
+    const bool notified = route_notify_ && address_notify_;
+    if (notified && generation_.load(std::memory_order_acquire) == cached_generation_.load(std::memory_order_acquire)) {
+        return std::atomic_load(&cached_);
+    }
+
+    std::lock_guard<std::mutex> lk(mtx_);
+    const unsigned long gen = generation_.load(std::memory_order_acquire);
+    if (!notified || gen != cached_generation_.load(std::memory_order_relaxed)) {
+        std::atomic_store(&cached_, std::shared_ptr<const DefaultRoute>(std::make_shared<DefaultRoute>(Query())));
+        // 先发布路由再发布代数，看到新代数的读者一定看到新路由
+        cached_generation_.store(gen, std::memory_order_release);
+    }
+    return std::atomic_load(&cached_);
+}
+
+DefaultRoute DefaultRouteCache::Query() const {
+    metrics::Global().route_queries.Add();
+    DefaultRoute result;
+
+    SOCKADDR_INET dest = {};
+    dest.Ipv4.sin_family = AF_INET;
+    dest.Ipv4.sin_addr.S_un.S_addr = htonl(kProbeDestination);
+
+    MIB_IPFORWARD_ROW2 row = {};
+    SOCKADDR_INET source = {};
+    if (GetBestRoute2(nullptr, 0, nullptr, &dest, 0, &row, &source) != NO_ERROR) return result;
+
+    result.valid = true;
+    result.if_index = row.InterfaceIndex;
+    result.luid = row.InterfaceLuid.Value;
+    result.source_ip = FormatIPv4(source);
+    if (row.NextHop.si_family == AF_INET && row.NextHop.Ipv4.sin_addr.S_un.S_addr != 0) {
+        result.gateway = FormatIPv4(row.NextHop);
+    }
+    return result;
+}
+
+} // namespace iputils
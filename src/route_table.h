@@ -0,0 +1,66 @@
+﻿/**
+ * @file route_table.h
+ * @brief 默认路由缓存
+ * @details 通过路由表确定实际承载外网流量的接口及其源地址，
+ *          结果一直缓存到系统发出路由或地址变化通知为止，因此每次刷新不产生额外系统调用
+ * @author Lynn
+ * @date 2025
+ */
+
+#pragma once
+
+#include <string>
+#include <memory>
+#include <mutex>
+#include <atomic>
+
+namespace iputils {
+
+/**
+ * @brief 默认路由信息
+ */
+struct DefaultRoute {
+    bool valid = false;             ///< 是否存在默认路由
+    unsigned long if_index = 0;     ///< 出接口索引
+    unsigned long long luid = 0;    ///< 出接口LUID
+    std::wstring source_ip;         ///< 访问外网时使用的源地址
+    std::wstring gateway;           ///< 下一跳（网关）地址
+};
+
+/**
+ * @brief 缓存的IPv4默认路由
+ * @details 使用GetBestRoute2查询到公网地址的最佳路由（综合路由跃点数和接口跃点数），
+ *          并注册NotifyRouteChange2和NotifyUnicastIpAddressChange，在路由或地址变化时使缓存失效
+ */
+class DefaultRouteCache {
+public:
+    DefaultRouteCache();
+    ~DefaultRouteCache();
+
+    DefaultRouteCache(const DefaultRouteCache&) = delete;
+    DefaultRouteCache& operator=(const DefaultRouteCache&) = delete;
+
+    /**
+     * @brief 获取当前默认路由（不为空）
+     * @details 缓存有效时只比较一次代数并复制一个shared_ptr，不加锁、不访问系统、不复制字符串；
+     *          代数变化后由第一个调用者在锁内重新查询
+     */
+    std::shared_ptr<const DefaultRoute> Get();
+
+    /**
+     * @brief 使缓存失效（由变化通知回调调用）
+     */
+    void Invalidate() { generation_++; }
+
+private:
+    DefaultRoute Query() const;
+
+    std::atomic<unsigned long> generation_{ 1 };  ///< 每次变化通知加一
+    std::mutex mtx_;                               ///< 只在重新查询时持有
+    std::atomic<unsigned long> cached_generation_{ 0 };  ///< cached_对应的代数
+    std::shared_ptr<const DefaultRoute> cached_;   ///< 用std::atomic_load/atomic_store访问
+    void* route_notify_ = nullptr;                 ///< NotifyRouteChange2句柄
+    void* address_notify_ = nullptr;               ///< NotifyUnicastIpAddressChange句柄
+};
+
+} // namespace iputils
@@ -0,0 +1,176 @@
+﻿/**
+ * @file rtt_probe.cpp
+ * @brief 往返时延探测实现
+ * @author Lynn
+ * @date 2025
+ */
+
+#include "rtt_probe.h"
+
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+
+#include <windows.h>
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <iphlpapi.h>
+#include <icmpapi.h>    // IcmpSendEcho
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+#pragma comment(lib, "Iphlpapi.lib")
+#pragma comment(lib, "Ws2_32.lib")
+
+namespace iputils {
+
+// === RttWindow ===
+
+void RttWindow::Push(std::uint32_t ms) {
+    if (size_ == kCapacity) {
+        const std::uint32_t oldest = ring_[head_];
+        if (oldest != kFailedSample) EraseSorted(oldest);
+        ring_[head_] = ms;
+        head_ = (head_ + 1) % kCapacity;
+    } else {
+        ring_[(head_ + size_) % kCapacity] = ms;
+        ++size_;
+    }
+    if (ms != kFailedSample) InsertSorted(ms);
+}
+
+void RttWindow::Clear() {
+    head_ = 0;
+    size_ = 0;
+    sorted_size_ = 0;
+    sum_ = 0;
+}
+
+void RttWindow::Summarize(RttSummary& out) const {
+    out.samples = static_cast<unsigned>(sorted_size_);
+    out.lost = static_cast<unsigned>(size_ - sorted_size_);
+    if (size_ > 0) {
+        const std::uint32_t last = ring_[(head_ + size_ - 1) % kCapacity];
+        out.last_ok = last != kFailedSample;
+        out.last_ms = out.last_ok ? last : 0;
+    } else {
+        out.last_ok = false;
+        out.last_ms = 0;
+    }
+    if (sorted_size_ == 0) {
+        out.min_ms = out.avg_ms = out.p95_ms = 0;
+        return;
+    }
+    out.min_ms = sorted_[0];
+    out.avg_ms = static_cast<unsigned>((sum_ + sorted_size_ / 2) / sorted_size_);
+    // 最近秩法：第ceil(0.95 * n)个样本
+    const size_t rank = (sorted_size_ * 95 + 99) / 100;
+    out.p95_ms = sorted_[rank - 1];
+}
+
+void RttWindow::InsertSorted(std::uint32_t ms) {
+    std::uint32_t* end = sorted_ + sorted_size_;
+    std::uint32_t* pos = std::upper_bound(sorted_, end, ms);
+    std::memmove(pos + 1, pos, (end - pos) * sizeof(std::uint32_t));
+    *pos = ms;
+    ++sorted_size_;
+    sum_ += ms;
+}
+
+void RttWindow::EraseSorted(std::uint32_t ms) {
+    std::uint32_t* end = sorted_ + sorted_size_;
+    std::uint32_t* pos = std::lower_bound(sorted_, end, ms);
+    if (pos == end || *pos != ms) return;
+    std::memmove(pos, pos + 1, (end - pos - 1) * sizeof(std::uint32_t));
+    --sorted_size_;
+    sum_ -= ms;
+}
+
+// === 探测 ===
+
+std::uint32_t PingIPv4(const unsigned char addr[4], unsigned timeout_ms) {
+    HANDLE icmp = IcmpCreateFile();
+    if (icmp == INVALID_HANDLE_VALUE) return kFailedSample;
+
+    char payload[8] = "tm-rtt";
+    // 应答缓冲区需要容纳一个ICMP_ECHO_REPLY、回显数据和一个ICMP错误报文
+    unsigned char reply[sizeof(ICMP_ECHO_REPLY) + sizeof(payload) + 8];
+    IPAddr dest;
+    std::memcpy(&dest, addr, 4);
+
+    std::uint32_t result = kFailedSample;
+    if (IcmpSendEcho(icmp, dest, payload, sizeof(payload), nullptr, reply, sizeof(reply), timeout_ms) > 0) {
+        const auto* echo = reinterpret_cast<const ICMP_ECHO_REPLY*>(reply);
+        if (echo->Status == IP_SUCCESS) result = echo->RoundTripTime;
+    }
+    IcmpCloseHandle(icmp);
+    return result;
+}
+
+std::uint32_t TcpConnectRtt(const ResolvedAddress& addr, unsigned short port, unsigned timeout_ms) {
+    WSADATA wsa;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) return kFailedSample;
+
+    sockaddr_storage target{};
+    int target_len = 0;
+    if (addr.family == AF_INET) {
+        auto* sin = reinterpret_cast<sockaddr_in*>(&target);
+        sin->sin_family = AF_INET;
+        sin->sin_port = htons(port);
+        std::memcpy(&sin->sin_addr, addr.bytes, 4);
+        target_len = sizeof(sockaddr_in);
+    } else {
+        auto* sin6 = reinterpret_cast<sockaddr_in6*>(&target);
+        sin6->sin6_family = AF_INET6;
+        sin6->sin6_port = htons(port);
+        std::memcpy(&sin6->sin6_addr, addr.bytes, 16);
+        target_len = sizeof(sockaddr_in6);
+    }
+
+    std::uint32_t result = kFailedSample;
+    SOCKET sock = socket(addr.family, SOCK_STREAM, IPPROTO_TCP);
+    if (sock != INVALID_SOCKET) {
+        u_long nonblocking = 1;
+        ioctlsocket(sock, FIONBIO, &nonblocking);
+        const auto start = std::chrono::steady_clock::now();
+        if (connect(sock, reinterpret_cast<const sockaddr*>(&target), target_len) == 0
+            || WSAGetLastError() == WSAEWOULDBLOCK) {
+            fd_set writefds, exceptfds;
+            FD_ZERO(&writefds);
+            FD_ZERO(&exceptfds);
+            FD_SET(sock, &writefds);
+            FD_SET(sock, &exceptfds);
+            timeval tv;
+            tv.tv_sec = static_cast<long>(timeout_ms / 1000);
+            tv.tv_usec = static_cast<long>(timeout_ms % 1000) * 1000;
+            if (select(0, nullptr, &writefds, &exceptfds, &tv) > 0 && FD_ISSET(sock, &writefds)) {
+                const auto elapsed = std::chrono::steady_clock::now() - start;
+                result = static_cast<std::uint32_t>(std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count());
+            }
+        }
+        closesocket(sock);
+    }
+    WSACleanup();
+    return result;
+}
+
+std::wstring FormatAddress(const ResolvedAddress& addr) {
+    wchar_t buf[kIpv6TextSize] = {};
+    if (addr.family == AF_INET) {
+        in_addr a;
+        std::memcpy(&a, addr.bytes, 4);
+        if (!InetNtopW(AF_INET, &a, buf, INET_ADDRSTRLEN)) return std::wstring();
+        return buf;
+    }
+    Ipv6Address a;
+    std::memcpy(a.bytes, addr.bytes, 16);
+    FormatIPv6(a, buf);
+    return buf;
+}
+
+} // namespace iputils
@@ -0,0 +1,80 @@
+﻿/**
+ * @file rtt_probe.h
+ * @brief 往返时延探测
+ * @details 到默认网关的ICMP回显（IcmpSendEcho，不需要管理员权限）和到查询服务器的TCP连接耗时，
+ *          结果放入固定容量的滚动窗口，最小值、平均值和p95在每次写入时增量维护
+ * @author Lynn
+ * @date 2025
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include "ip_utils.h"
+#include "dns_cache.h"
+
+namespace iputils {
+
+/**
+ * @brief 固定容量的往返时延滚动窗口
+ * @details 按到达顺序保存最近kCapacity次探测（失败记为kFailedSample），
+ *          成功的样本同时保存在有序数组中：写入和淘汰各做一次二分查找和移动，
+ *          取最小值、p95为直接下标访问，总和增量加减，不分配内存。不是线程安全的
+ */
+class RttWindow {
+public:
+    static constexpr size_t kCapacity = 32;
+
+    /**
+     * @brief 写入一次探测结果，窗口已满时淘汰最早的一次
+     * @param ms 往返时延（毫秒），失败为kFailedSample
+     */
+    void Push(std::uint32_t ms);
+
+    /**
+     * @brief 清空窗口（探测目标变化时调用）
+     */
+    void Clear();
+
+    /**
+     * @brief 填充统计结果（不修改target）
+     */
+    void Summarize(RttSummary& out) const;
+
+private:
+    void InsertSorted(std::uint32_t ms);
+    void EraseSorted(std::uint32_t ms);
+
+    std::uint32_t ring_[kCapacity] = {};    ///< 按到达顺序的探测结果
+    size_t head_ = 0;                       ///< 最早一次探测的位置
+    size_t size_ = 0;                       ///< 窗口内的探测次数
+    std::uint32_t sorted_[kCapacity] = {};  ///< 成功样本（升序）
+    size_t sorted_size_ = 0;                ///< 成功样本数
+    unsigned long long sum_ = 0;            ///< 成功样本总和
+};
+
+/**
+ * @brief 向IPv4地址发送一次ICMP回显请求
+ * @param addr 网络字节序的IPv4地址
+ * @param timeout_ms 超时时间（毫秒）
+ * @return 往返时延（毫秒），超时或不可达时返回kFailedSample
+ */
+std::uint32_t PingIPv4(const unsigned char addr[4], unsigned timeout_ms);
+
+/**
+ * @brief 测量到指定地址和端口的TCP连接建立耗时
+ * @param addr 目标地址（IPv4或IPv6）
+ * @param port 端口
+ * @param timeout_ms 超时时间（毫秒）
+ * @return 三次握手完成的耗时（毫秒），失败时返回kFailedSample
+ * @details 连接建立后立即关闭，不发送任何数据
+ */
+std::uint32_t TcpConnectRtt(const ResolvedAddress& addr, unsigned short port, unsigned timeout_ms);
+
+/**
+ * @brief 地址的文本形式（用于显示探测目标）
+ */
+std::wstring FormatAddress(const ResolvedAddress& addr);
+
+} // namespace iputils
@@ -0,0 +1,67 @@
+﻿/**
+ * @file sample_ring.h
+ * @brief 固定容量的无锁样本环
+ * @details 保存最近N个32位样本（如查询耗时毫秒数），写入只是一次fetch_add和一次原子存储，
+ *          可在多个线程上写入、在UI线程上读取，不加锁也不分配内存。
+ *          读取与写入并发时可能读到正在被覆盖的旧样本，用于显示统计时可以接受
+ * @author Lynn
+ * @date 2025
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace iputils {
+
+/// 失败（超时或网络不可用）的样本
+constexpr std::uint32_t kFailedSample = 0xFFFFFFFFu;
+
+/**
+ * @brief 固定容量的无锁样本环
+ * @tparam N 容量（保留最近N个样本）
+ */
+template <size_t N>
+class SampleRing {
+public:
+    static_assert(N > 0, "ring must hold at least one sample");
+
+    /**
+     * @brief 写入一个样本，容量已满时覆盖最旧的样本
+     */
+    void Push(std::uint32_t value) {
+        const unsigned long long index = head_.fetch_add(1, std::memory_order_relaxed);
+        slots_[index % N].store(value, std::memory_order_relaxed);
+        published_.fetch_add(1, std::memory_order_release);
+    }
+
+    /**
+     * @brief 已写入的样本总数（只增不减，可用于判断是否有新样本）
+     */
+    unsigned long long Total() const { return published_.load(std::memory_order_acquire); }
+
+    /**
+     * @brief 按从新到旧的顺序复制最近的样本
+     * @param out 输出缓冲区
+     * @param max 最多复制的个数
+     * @return 实际复制的个数
+     */
+    size_t Recent(std::uint32_t* out, size_t max) const {
+        const unsigned long long total = Total();
+        size_t n = 0;
+        while (n < max && n < N && n < total) {
+            out[n] = slots_[(total - 1 - n) % N].load(std::memory_order_relaxed);
+            ++n;
+        }
+        return n;
+    }
+
+private:
+    std::atomic<std::uint32_t> slots_[N] = {};
+    std::atomic<unsigned long long> head_{ 0 };       ///< 下一个写入位置
+    std::atomic<unsigned long long> published_{ 0 };  ///< 已完成写入的样本数
+};
+
+} // namespace iputils
@@ -0,0 +1,83 @@
+﻿/**
+ * @file task_executor.cpp
+ * @brief 单工作线程任务执行器实现
+ * @author Lynn
+ * @date 2025
+ */
+
+#include "task_executor.h"
+#include "module_state.h"
+
+namespace iputils {
+
+TaskExecutor::~TaskExecutor() {
+    Stop();
+}
+
+bool TaskExecutor::Post(Task task) {
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        if (stopping_) return false;
+        queue_.push_back(std::move(task));
+        if (!manual_ && !worker_.joinable()) {
+            PinModule();
+            worker_ = std::thread(&TaskExecutor::Run, this);
+        }
+    }
+    cv_.notify_one();
+    return true;
+}
+
+void TaskExecutor::Stop() {
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        stopping_ = true;
+        queue_.clear();
+    }
+    cv_.notify_all();
+    if (!worker_.joinable()) return;
+    // 模块卸载时持有加载器锁，join会死锁；此时进程正在退出，工作线程已被系统终止
+    if (IsModuleDetaching()) {
+        worker_.detach();
+    } else {
+        worker_.join();
+    }
+}
+
+void TaskExecutor::SetManual(bool manual) {
+    std::lock_guard<std::mutex> lk(mtx_);
+    manual_ = manual;
+}
+
+size_t TaskExecutor::RunPending() {
+    std::deque<Task> tasks;
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        if (!manual_ || stopping_) return 0;
+        tasks.swap(queue_);
+    }
+    // 任务执行期间可能再投递任务，留到下一次RunPending
+    for (auto& task : tasks) task();
+    return tasks.size();
+}
+
+size_t TaskExecutor::PendingCount() {
+    std::lock_guard<std::mutex> lk(mtx_);
+    return queue_.size();
+}
+
+void TaskExecutor::Run() {
+    for (;;) {
+        Task task;
+        {
+            std::unique_lock<std::mutex> lk(mtx_);
+            cv_.wait(lk, [this] { return stopping_ || !queue_.empty(); });
+            if (stopping_) return;
+            task = std::move(queue_.front());
+            queue_.pop_front();
+        }
+        task();
+    }
+}
+
+} // namespace iputils
@@ -0,0 +1,77 @@
+﻿/**
+ * @file task_executor.h
+ * @brief 单工作线程任务执行器
+ * @details 外网IP查询等耗时操作统一投递到一个后台工作线程上顺序执行，
+ *          避免在TrafficMonitor的UI线程（DataRequired）中阻塞网络请求
+ * @author Lynn
+ * @date 2025
+ */
+
+#pragma once
+
+#include <functional>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+
+namespace iputils {
+
+/**
+ * @brief 单线程任务执行器
+ * @details 所有任务在同一个工作线程上按投递顺序执行，
+ *          工作线程在第一次投递任务时才创建
+ */
+class TaskExecutor {
+public:
+    using Task = std::function<void()>;
+
+    TaskExecutor() = default;
+    ~TaskExecutor();
+
+    TaskExecutor(const TaskExecutor&) = delete;
+    TaskExecutor& operator=(const TaskExecutor&) = delete;
+
+    /**
+     * @brief 投递一个任务到工作线程
+     * @param task 要执行的任务
+     * @return true表示已投递，false表示执行器已停止
+     */
+    bool Post(Task task);
+
+    /**
+     * @brief 停止执行器并等待工作线程退出
+     * @details 尚未执行的任务会被丢弃；模块卸载期间（见module_state.h）只分离线程，不等待
+     */
+    void Stop();
+
+    /**
+     * @brief 切换为手动执行模式
+     * @details 手动模式下不创建工作线程，投递的任务只在调用RunPending时在调用线程上执行；
+     *          供回放测试按虚拟时间确定性地完成查询，只能在第一次投递之前调用
+     */
+    void SetManual(bool manual);
+
+    /**
+     * @brief 在调用线程上执行当前排队的所有任务（仅手动模式）
+     * @return 执行的任务数
+     */
+    size_t RunPending();
+
+    /**
+     * @brief 排队中尚未执行的任务数
+     */
+    size_t PendingCount();
+
+private:
+    void Run();
+
+    std::mutex mtx_;
+    std::condition_variable cv_;
+    std::deque<Task> queue_;
+    std::thread worker_;
+    bool stopping_ = false;
+    bool manual_ = false;
+};
+
+} // namespace iputils
@@ -0,0 +1,127 @@
+// 网络指纹测试：构造只差一项的适配器快照（网关、DNS、前缀长度、IPv6接口标识、临时地址、断开的适配器等），
+// 检查ComputeFingerprint对哪些变化敏感、对哪些变化不敏感，不访问系统网络配置
+// 编译：cl /EHsc /std:c++14 /utf-8 /O2 /DUNICODE /D_UNICODE /DNOMINMAX /DWIN32_LEAN_AND_MEAN test_fingerprint.cpp src\adapter_inventory.cpp src\ipv6.cpp src\metrics.cpp src\module_state.cpp
+// 用法：test_fingerprint
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <windows.h>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <utility>
+#include "src/adapter_inventory.h"
+
+namespace {
+
+iputils::AdapterAddress V4(const wchar_t* text, unsigned char prefix = 24) {
+    iputils::AdapterAddress a;
+    a.family = AF_INET;
+    InetPtonW(AF_INET, text, a.bytes);
+    a.prefix_len = prefix;
+    a.text = text;
+    return a;
+}
+
+iputils::AdapterAddress V6(const wchar_t* text, unsigned char prefix = 64, bool temporary = false) {
+    iputils::AdapterAddress a;
+    a.family = AF_INET6;
+    InetPtonW(AF_INET6, text, a.bytes);
+    a.prefix_len = prefix;
+    a.temporary = temporary;
+    a.text = text;
+    return a;
+}
+
+/**
+ * @brief 基准快照：已连接的Wi-Fi（IPv4+IPv6）和一个断开的以太网
+ */
+iputils::AdapterSnapshot Baseline() {
+    iputils::AdapterSnapshot s;
+
+    iputils::AdapterEntry wifi;
+    wifi.luid = 0x47000000010000ULL;
+    wifi.if_index = 12;
+    wifi.if_type = 71;
+    wifi.is_up = true;
+    wifi.friendly_name = L"Wi-Fi";
+    wifi.adapter_name = L"{6B29FC40-CA47-1067-B31D-00DD010662DA}";
+    wifi.addresses.push_back(V4(L"192.168.1.23"));
+    wifi.addresses.push_back(V6(L"2001:db8:1:2:21a:2bff:fe3c:4d5e"));
+    wifi.addresses.push_back(V6(L"2001:db8:1:2:8d4c:1f2a:9e01:7b3c", 64, true));
+    wifi.gateways.push_back(V4(L"192.168.1.1", 0));
+    wifi.dns_servers.push_back(V4(L"192.168.1.1", 0));
+    wifi.dns_servers.push_back(V6(L"2001:db8:1:2::53", 0));
+    s.adapters.push_back(wifi);
+
+    iputils::AdapterEntry ethernet;
+    ethernet.luid = 0x6000000020000ULL;
+    ethernet.if_index = 7;
+    ethernet.if_type = 6;
+    ethernet.is_up = false;
+    ethernet.friendly_name = L"以太网";
+    ethernet.adapter_name = L"{3F2504E0-4F89-11D3-9A0C-0305E82C3301}";
+    ethernet.addresses.push_back(V4(L"10.0.0.5"));
+    s.adapters.push_back(ethernet);
+    return s;
+}
+
+int failures = 0;
+
+/**
+ * @brief 对基准快照做一处修改，检查指纹是否按预期变化
+ */
+void Expect(const char* name, bool should_change, const std::function<void(iputils::AdapterSnapshot&)>& mutate) {
+    const auto base = iputils::ComputeFingerprint(Baseline());
+    auto s = Baseline();
+    mutate(s);
+    const bool changed = iputils::ComputeFingerprint(s) != base;
+    const bool pass = changed == should_change;
+    std::cout << (pass ? "PASS  " : "FAIL  ") << (should_change ? "changes:   " : "unchanged: ") << name << std::endl;
+    if (!pass) ++failures;
+}
+
+} // namespace
+
+int main() {
+    using Snapshot = iputils::AdapterSnapshot;
+
+    // 会改变指纹的变化
+    Expect("gateway address", true, [](Snapshot& s) { s.adapters[0].gateways[0] = V4(L"192.168.1.254", 0); });
+    Expect("gateway added", true, [](Snapshot& s) { s.adapters[0].gateways.push_back(V6(L"fe80::1", 0)); });
+    Expect("DNS server address", true, [](Snapshot& s) { s.adapters[0].dns_servers[0] = V4(L"1.1.1.1", 0); });
+    Expect("DNS server order", true, [](Snapshot& s) { std::swap(s.adapters[0].dns_servers[0], s.adapters[0].dns_servers[1]); });
+    Expect("IPv4 prefix length", true, [](Snapshot& s) { s.adapters[0].addresses[0].prefix_len = 16; });
+    Expect("IPv6 prefix length", true, [](Snapshot& s) { s.adapters[0].addresses[1].prefix_len = 56; });
+    Expect("IPv6 network prefix", true, [](Snapshot& s) { s.adapters[0].addresses[1] = V6(L"2001:db8:1:3:21a:2bff:fe3c:4d5e"); });
+    Expect("IPv6 interface id (stable address)", true, [](Snapshot& s) { s.adapters[0].addresses[1] = V6(L"2001:db8:1:2:21a:2bff:fe3c:ffff"); });
+    Expect("IPv4 address", true, [](Snapshot& s) { s.adapters[0].addresses[0] = V4(L"192.168.1.24"); });
+    Expect("interface LUID (same addresses on another adapter)", true, [](Snapshot& s) { s.adapters[0].luid += 1; });
+    Expect("adapter went down", true, [](Snapshot& s) { s.adapters[0].is_up = false; });
+    Expect("adapter came up", true, [](Snapshot& s) { s.adapters[1].is_up = true; });
+    Expect("gateway moved to DNS list", true, [](Snapshot& s) {
+        s.adapters[0].dns_servers.insert(s.adapters[0].dns_servers.begin(), s.adapters[0].gateways[0]);
+        s.adapters[0].gateways.clear();
+    });
+
+    // 不应改变指纹的变化
+    Expect("rebuilt snapshot", false, [](Snapshot&) {});
+    Expect("temporary IPv6 interface id rotated", false, [](Snapshot& s) {
+        s.adapters[0].addresses[2] = V6(L"2001:db8:1:2:1111:2222:3333:4444", 64, true);
+    });
+    Expect("temporary IPv6 address added", false, [](Snapshot& s) {
+        s.adapters[0].addresses.push_back(V6(L"2001:db8:1:2:aaaa:bbbb:cccc:dddd", 64, true));
+    });
+    Expect("address on a disconnected adapter", false, [](Snapshot& s) { s.adapters[1].addresses[0] = V4(L"10.0.0.6"); });
+    Expect("friendly name and interface index", false, [](Snapshot& s) {
+        s.adapters[0].friendly_name = L"WLAN";
+        s.adapters[0].if_index = 13;
+    });
+    Expect("preferred adapter", false, [](Snapshot& s) {
+        s.preferred_name = L"Wi-Fi";
+        s.preferred_index = 0;
+    });
+    Expect("deprecated flag", false, [](Snapshot& s) { s.adapters[0].addresses[1].deprecated = true; });
+
+    std::cout << (failures ? "FAILED: " : "all passed") << (failures ? std::to_string(failures) : "") << std::endl;
+    return failures ? 1 : 0;
+}
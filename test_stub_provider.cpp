@@ -0,0 +1,545 @@
+// 本机替身服务器：在127.0.0.1上模拟ipinfo.io（/json、/ip）和httpbin（/httpbin）的应答，
+// 按查询参数注入延迟（delay=毫秒）、错误状态（status=500、304等）、截断（fault=truncate）、
+// 逐字节慢速发送（fault=drip&drip_ms=毫秒）、超大响应体（fault=huge）和直接断开（fault=close）。
+// 程序先用真实的查询流水线跑集成测试和解析/连接失败测试（localhost、本机未监听端口、黑洞地址），
+// 用替身解析器和手动时钟检查DNS缓存的TTL限制、过期和预取窗口，
+// 用IpService的刷新逻辑对比每次刷新都请求/json和先请求/ip、IP变化时才请求/json的响应体字节数和解析耗时，
+// 再做多线程负载测试，检查连接复用和失败后的恢复
+// 编译：cl /EHsc /std:c++14 /utf-8 /O2 /DUNICODE /D_UNICODE /DNOMINMAX /DWIN32_LEAN_AND_MEAN test_stub_provider.cpp src\*.cpp /link User32.lib Gdi32.lib
+// 用法：test_stub_provider [--threads N] [--requests N]
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <windows.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "src/lookup_pipeline.h"
+#include "src/ip_service.h"
+
+#pragma comment(lib, "Ws2_32.lib")
+
+namespace {
+
+const char kStubIp[] = "203.0.113.9";
+
+/**
+ * @brief 本机HTTP替身服务器
+ * @details 每个连接一个线程，支持keep-alive，记录接受的连接数和处理的请求数
+ */
+class StubProvider {
+public:
+    ~StubProvider() { Stop(); }
+
+    bool Start() {
+        listen_ = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        if (listen_ == INVALID_SOCKET) return false;
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = 0;  // 由系统分配端口
+        int len = sizeof(addr);
+        if (bind(listen_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0
+            || listen(listen_, SOMAXCONN) != 0
+            || getsockname(listen_, reinterpret_cast<sockaddr*>(&addr), &len) != 0) {
+            closesocket(listen_);
+            listen_ = INVALID_SOCKET;
+            return false;
+        }
+        port_ = ntohs(addr.sin_port);
+        acceptor_ = std::thread(&StubProvider::AcceptLoop, this);
+        return true;
+    }
+
+    void Stop() {
+        if (listen_ != INVALID_SOCKET) {
+            closesocket(listen_);
+            listen_ = INVALID_SOCKET;
+        }
+        if (acceptor_.joinable()) acceptor_.join();
+        {
+            std::lock_guard<std::mutex> lk(mtx_);
+            for (SOCKET s : clients_) shutdown(s, SD_BOTH);
+        }
+        for (auto& t : workers_) {
+            if (t.joinable()) t.join();
+        }
+        workers_.clear();
+    }
+
+    unsigned short Port() const { return port_; }
+    long Connections() const { return connections_; }
+    long Requests() const { return requests_; }
+    void ResetCounters() { connections_ = 0; requests_ = 0; }
+
+private:
+    void AcceptLoop() {
+        for (;;) {
+            SOCKET s = accept(listen_, nullptr, nullptr);
+            if (s == INVALID_SOCKET) return;
+            ++connections_;
+            std::lock_guard<std::mutex> lk(mtx_);
+            clients_.push_back(s);
+            workers_.emplace_back(&StubProvider::Serve, this, s);
+        }
+    }
+
+    static bool SendAll(SOCKET s, const char* data, size_t len) {
+        while (len > 0) {
+            int n = send(s, data, static_cast<int>(std::min<size_t>(len, 64 * 1024)), 0);
+            if (n <= 0) return false;
+            data += n;
+            len -= n;
+        }
+        return true;
+    }
+
+    static std::map<std::string, std::string> ParseQuery(const std::string& query) {
+        std::map<std::string, std::string> params;
+        std::istringstream in(query);
+        std::string pair;
+        while (std::getline(in, pair, '&')) {
+            size_t eq = pair.find('=');
+            if (eq == std::string::npos) params[pair] = "";
+            else params[pair.substr(0, eq)] = pair.substr(eq + 1);
+        }
+        return params;
+    }
+
+    /**
+     * @brief 处理一个请求
+     * @return false表示应关闭连接
+     */
+    bool Respond(SOCKET s, const std::string& method, const std::string& target) {
+        ++requests_;
+        const size_t q = target.find('?');
+        const std::string path = target.substr(0, q);
+        auto params = ParseQuery(q == std::string::npos ? "" : target.substr(q + 1));
+        const std::string fault = params["fault"];
+        const std::string ip = params.count("ip") ? params["ip"] : kStubIp;
+
+        if (params.count("delay")) std::this_thread::sleep_for(std::chrono::milliseconds(std::atoi(params["delay"].c_str())));
+        if (fault == "close") return false;
+
+        int status = params.count("status") ? std::atoi(params["status"].c_str()) : 200;
+        std::string body;
+        if (path == "/json") {
+            body = "{\n  \"ip\": \"" + ip + "\",\n  \"city\": \"Tokyo\",\n  \"country\": \"JP\",\n"
+                   "  \"org\": \"AS64500 Example Networks Inc.\",\n  \"timezone\": \"Asia/Tokyo\"\n}";
+        } else if (path == "/ip") {
+            body = ip + "\n";
+        } else if (path == "/httpbin") {
+            body = "{\n  \"origin\": \"" + ip + "\"\n}";
+        } else {
+            status = 404;
+            body = "not found";
+        }
+        if (fault == "huge") {
+            // 1MB的填充字段放在IP之后，客户端应在响应体上限处停止读取
+            body.insert(body.size() - 1, ",\n  \"padding\": \"" + std::string(1024 * 1024, 'x') + "\"\n");
+        }
+        if (status == 304 || status == 204) body.clear();
+
+        std::string reason = status == 200 ? "OK" : status == 304 ? "Not Modified" : status == 404 ? "Not Found" : "Error";
+        size_t advertised = body.size();
+        if (fault == "truncate") body.resize(body.size() / 2);
+
+        std::string head = "HTTP/1.1 " + std::to_string(status) + " " + reason + "\r\n"
+            "Content-Type: application/json; charset=utf-8\r\n"
+            "Content-Length: " + std::to_string(advertised) + "\r\n"
+            "Connection: keep-alive\r\n\r\n";
+        if (!SendAll(s, head.data(), head.size())) return false;
+        if (method == "HEAD") return true;
+
+        if (fault == "drip") {
+            const int drip_ms = params.count("drip_ms") ? std::atoi(params["drip_ms"].c_str()) : 20;
+            for (char c : body) {
+                if (!SendAll(s, &c, 1)) return false;
+                std::this_thread::sleep_for(std::chrono::milliseconds(drip_ms));
+            }
+        } else if (!SendAll(s, body.data(), body.size())) {
+            return false;
+        }
+        return fault != "truncate";  // 截断后必须关闭连接，否则客户端会一直等待剩余字节
+    }
+
+    void Serve(SOCKET s) {
+        std::string buffer;
+        char chunk[4096];
+        for (;;) {
+            size_t end = buffer.find("\r\n\r\n");
+            if (end == std::string::npos) {
+                int n = recv(s, chunk, sizeof(chunk), 0);
+                if (n <= 0) break;
+                buffer.append(chunk, n);
+                continue;
+            }
+            std::istringstream line(buffer.substr(0, buffer.find("\r\n")));
+            std::string method, target;
+            line >> method >> target;
+            buffer.erase(0, end + 4);
+            if (!Respond(s, method, target)) break;
+        }
+        shutdown(s, SD_BOTH);
+        closesocket(s);
+        std::lock_guard<std::mutex> lk(mtx_);
+        clients_.erase(std::remove(clients_.begin(), clients_.end(), s), clients_.end());
+    }
+
+    SOCKET listen_ = INVALID_SOCKET;
+    unsigned short port_ = 0;
+    std::thread acceptor_;
+    std::mutex mtx_;
+    std::vector<SOCKET> clients_;
+    std::vector<std::thread> workers_;
+    std::atomic<long> connections_{ 0 };
+    std::atomic<long> requests_{ 0 };
+};
+
+/**
+ * @brief 测试上下文：同一个替身服务器、传输和DNS缓存
+ */
+struct Harness {
+    StubProvider server;
+    iputils::HttpTransport transport;
+    iputils::DnsCache dns;
+    int failures = 0;
+
+    iputils::ExternalIpOptions Options(const wchar_t* path) const {
+        iputils::ExternalIpOptions opt;
+        opt.host = L"127.0.0.1";
+        opt.port = server.Port();
+        opt.secure = false;
+        opt.path = path;
+        opt.ip_only_path = path;
+        opt.connect_timeout_ms = 1000;
+        opt.receive_timeout_ms = 1000;
+        return opt;
+    }
+
+    bool Lookup(const wchar_t* path, iputils::LookupContext* out = nullptr, bool ip_only = false) {
+        iputils::LookupContext ctx(Options(path));
+        ctx.ip_only = ip_only;
+        bool ok = iputils::RunLookupPipeline(ctx, transport, dns);
+        if (out) *out = ctx;
+        return ok;
+    }
+
+    void Check(const char* name, bool pass) {
+        std::cout << (pass ? "PASS  " : "FAIL  ") << name << std::endl;
+        if (!pass) ++failures;
+    }
+};
+
+void IntegrationTests(Harness& h) {
+    iputils::LookupContext ctx(h.Options(L"/"));
+
+    bool ok = h.Lookup(L"/json", &ctx);
+    h.Check("ipinfo shape", ok && ctx.result.ip == L"203.0.113.9" && ctx.result.country == L"JP"
+        && ctx.result.GetCompanyName() == L"Example Networks");
+
+    ok = h.Lookup(L"/httpbin", &ctx);
+    h.Check("httpbin shape (origin)", ok && ctx.result.ip == L"203.0.113.9" && ctx.result.country.empty());
+
+    ok = h.Lookup(L"/ip", &ctx, true);
+    h.Check("plain-text ip", ok && ctx.result.ip == L"203.0.113.9");
+
+    // 连接复用：同一传输上连续查询只建立一个连接
+    h.transport.Reset();
+    h.server.ResetCounters();
+    const auto before = h.transport.GetStats();
+    bool all = true;
+    for (int i = 0; i < 5; ++i) all = h.Lookup(L"/json") && all;
+    const auto after = h.transport.GetStats();
+    h.Check("keep-alive reuse (1 connection for 5 requests)",
+            all && h.server.Connections() == 1 && after.reused_connections - before.reused_connections >= 4);
+
+    ok = h.Lookup(L"/json?delay=300", &ctx);
+    h.Check("injected latency shows in ttfb", ok && ctx.ttfb.count() >= 300);
+
+    ok = h.Lookup(L"/json?delay=1500", &ctx);
+    h.Check("receive timeout fails at REQUEST", !ok && ctx.stage == iputils::LookupStage::REQUEST
+        && ctx.elapsed.count() < 1500);
+    h.Check("recovers after timeout", h.Lookup(L"/json"));
+
+    ok = h.Lookup(L"/json?status=500", &ctx);
+    h.Check("HTTP 500 fails at REQUEST", !ok && ctx.stage == iputils::LookupStage::REQUEST && ctx.status_code == 500);
+
+    ok = h.Lookup(L"/json?status=304", &ctx);
+    h.Check("HTTP 304 fails without body", !ok && ctx.status_code == 304 && ctx.body.empty());
+    h.Check("recovers after error status", h.Lookup(L"/json"));
+
+    ok = h.Lookup(L"/json?fault=truncate", &ctx);
+    h.Check("truncated body does not hang", ctx.elapsed.count() < 1500);
+    h.Check("recovers after truncation", h.Lookup(L"/json"));
+
+    ok = h.Lookup(L"/ip?fault=drip&drip_ms=10", &ctx, true);
+    h.Check("slow-drip body completes", ok && ctx.result.ip == L"203.0.113.9" && ctx.elapsed.count() >= 100);
+
+    const auto huge_before = h.transport.GetStats().bytes_received;
+    ok = h.Lookup(L"/json?fault=huge", &ctx);
+    const auto huge_bytes = h.transport.GetStats().bytes_received - huge_before;
+    h.Check("huge body capped at 64 KiB", ok && ctx.result.ip == L"203.0.113.9" && huge_bytes <= 64 * 1024);
+    h.Check("recovers after huge body", h.Lookup(L"/json"));
+
+    ok = h.Lookup(L"/json?fault=close", &ctx);
+    h.Check("connection closed without response fails", !ok);
+    h.Check("recovers after close", h.Lookup(L"/json"));
+}
+
+/**
+ * @brief 取一个当前没有监听的本机端口
+ */
+unsigned short ClosedLoopbackPort() {
+    SOCKET s = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    int len = sizeof(addr);
+    bind(s, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+    getsockname(s, reinterpret_cast<sockaddr*>(&addr), &len);
+    closesocket(s);  // 未调用listen，关闭后端口上没有监听者
+    return ntohs(addr.sin_port);
+}
+
+void ResolveAndConnectTests(Harness& h) {
+    iputils::DnsCache::Entry entry;
+    h.Check("dns: localhost resolves", h.dns.Resolve(L"localhost", entry) && !entry.addresses.empty());
+
+    // 主机名查询：解析阶段记录地址数，连接由WinHTTP自行解析同一名称
+    iputils::LookupContext ctx(h.Options(L"/json"));
+    ctx.opt.host = L"localhost";
+    bool ok = iputils::RunLookupPipeline(ctx, h.transport, h.dns);
+    h.Check("dns: lookup by host name", ok && ctx.address_count > 0 && ctx.result.ip == L"203.0.113.9");
+
+    // 本机未监听的端口：连接被拒绝，在连接超时内失败
+    iputils::HttpTransport refused_transport;
+    iputils::LookupContext refused(h.Options(L"/json"));
+    refused.opt.port = ClosedLoopbackPort();
+    ok = iputils::RunLookupPipeline(refused, refused_transport, h.dns);
+    h.Check("loopback: closed port fails at REQUEST", !ok && refused.stage == iputils::LookupStage::REQUEST
+        && refused.elapsed.count() < refused.opt.connect_timeout_ms + 500);
+
+    // 黑洞地址（TEST-NET-1，不会应答SYN）：受连接超时限制，不会挂住工作线程
+    iputils::HttpTransport blackhole_transport;
+    iputils::LookupContext blackhole(h.Options(L"/json"));
+    blackhole.opt.host = L"192.0.2.1";
+    blackhole.opt.port = 80;
+    ok = iputils::RunLookupPipeline(blackhole, blackhole_transport, h.dns);
+    h.Check("blackhole: bounded by connect timeout", !ok && blackhole.stage == iputils::LookupStage::REQUEST
+        && blackhole.elapsed.count() < blackhole.opt.connect_timeout_ms + 1000);
+}
+
+/**
+ * @brief 本机替身解析器：按主机名返回固定的地址和TTL，记录查询次数
+ */
+struct StubResolver {
+    std::map<std::wstring, long long> ttl_seconds;  ///< 主机名 -> 应答的TTL
+    int queries = 0;
+
+    bool operator()(const std::wstring& host, std::vector<iputils::ResolvedAddress>& out, std::chrono::seconds& ttl) {
+        ++queries;
+        auto it = ttl_seconds.find(host);
+        if (it == ttl_seconds.end()) return false;
+        iputils::ResolvedAddress v6, v4;
+        v6.family = AF_INET6;
+        v6.bytes[15] = 1;                   // ::1
+        v4.family = AF_INET;
+        v4.bytes[0] = 127;
+        v4.bytes[3] = 1;                    // 127.0.0.1
+        out.push_back(v6);
+        out.push_back(v4);
+        ttl = std::chrono::seconds(it->second);
+        return true;
+    }
+};
+
+void DnsCacheTests(Harness& h) {
+    using Clock = iputils::DnsCache::Clock;
+    StubResolver resolver;
+    resolver.ttl_seconds[L"short.test"] = 5;
+    resolver.ttl_seconds[L"normal.test"] = 300;
+    resolver.ttl_seconds[L"long.test"] = 86400;
+    resolver.ttl_seconds[L"prefetch.test"] = 100;
+    resolver.ttl_seconds[L"idle.test"] = 100;
+    resolver.ttl_seconds[L"localhost"] = 300;
+
+    Clock::time_point now = Clock::now();
+    iputils::DnsCache cache;
+    cache.SetResolver(std::ref(resolver));
+    cache.SetClock([&] { return now; });
+    auto lifetime = [](const iputils::DnsCache::Entry& e) {
+        return std::chrono::duration_cast<std::chrono::seconds>(e.expires - e.resolved).count();
+    };
+
+    // TTL限制在[min_ttl, max_ttl]
+    iputils::DnsCache::Entry entry;
+    h.Check("dns cache: TTL below min_ttl clamped up", cache.Resolve(L"short.test", entry)
+        && lifetime(entry) == cache.min_ttl.count());
+    h.Check("dns cache: TTL above max_ttl clamped down", cache.Resolve(L"long.test", entry)
+        && lifetime(entry) == cache.max_ttl.count());
+    h.Check("dns cache: TTL within range kept", cache.Resolve(L"normal.test", entry) && lifetime(entry) == 300);
+    h.Check("dns cache: unknown host fails", !cache.Resolve(L"missing.test", entry));
+
+    // 过期前使用缓存，过期后重新解析
+    int before = resolver.queries;
+    now += std::chrono::seconds(299);
+    h.Check("dns cache: served from cache before expiry", cache.Resolve(L"normal.test", entry)
+        && resolver.queries == before && entry.addresses.size() == 2);
+    now += std::chrono::seconds(1);
+    h.Check("dns cache: resolved again at expiry", cache.Resolve(L"normal.test", entry) && resolver.queries == before + 1);
+
+    // 预取窗口为剩余TTL的最后10%，每个窗口只预取一次
+    const Clock::time_point start = now;
+    cache.Resolve(L"prefetch.test", entry);
+    now = start + std::chrono::seconds(89);
+    h.Check("dns cache: no prefetch before the window", !cache.NeedsPrefetch(L"prefetch.test"));
+    now = start + std::chrono::seconds(91);
+    h.Check("dns cache: prefetch inside the window", cache.NeedsPrefetch(L"prefetch.test"));
+    h.Check("dns cache: one prefetch per window", !cache.NeedsPrefetch(L"prefetch.test"));
+    before = resolver.queries;
+    h.Check("dns cache: prefetch re-resolves", cache.Prefetch(L"prefetch.test") && resolver.queries == before + 1);
+    now = start + std::chrono::seconds(100);
+    h.Check("dns cache: prefetched entry still valid at old expiry", cache.Resolve(L"prefetch.test", entry)
+        && resolver.queries == before + 1 && entry.resolved == start + std::chrono::seconds(91));
+    now = start + std::chrono::seconds(182);
+    h.Check("dns cache: used again, prefetch in the next window", cache.NeedsPrefetch(L"prefetch.test"));
+
+    // 解析后未被使用的条目不预取
+    cache.Resolve(L"idle.test", entry);
+    now += std::chrono::seconds(50);
+    cache.Prefetch(L"idle.test");
+    now += std::chrono::seconds(95);
+    h.Check("dns cache: unused entry not prefetched", !cache.NeedsPrefetch(L"idle.test"));
+    cache.Resolve(L"idle.test", entry);
+    now += std::chrono::seconds(10);
+    h.Check("dns cache: expired entry not prefetched", !cache.NeedsPrefetch(L"idle.test"));
+
+    // 查询流水线的解析阶段使用注入的解析器
+    iputils::HttpTransport transport;
+    iputils::LookupContext ctx(h.Options(L"/json"));
+    ctx.opt.host = L"localhost";
+    before = resolver.queries;
+    const bool ok = iputils::RunLookupPipeline(ctx, transport, cache);
+    h.Check("dns cache: pipeline uses the stub resolver", ok && ctx.address_count == 2 && resolver.queries == before + 1);
+    transport.Reset();
+}
+
+/**
+ * @brief 按IpService的刷新逻辑跑一组刷新，返回传输层统计
+ * @param ip_only_path 纯文本IP路径，nullptr表示每次刷新都请求完整JSON
+ * @details 使用固定刷新间隔和手动时钟，每次刷新前把时钟推过刷新间隔；
+ *          第change_at次刷新起替身服务器返回另一个IP
+ */
+iputils::TransportStats RunRefreshes(Harness& h, const wchar_t* ip_only_path, int refreshes, int change_at) {
+    iputils::IpService service;
+    auto now = std::chrono::steady_clock::now();
+    service.SetClock([&] { return now; });
+
+    const wchar_t* json[] = { L"/json?ip=203.0.113.9", L"/json?ip=203.0.113.10" };
+    const wchar_t* ip[] = { L"/ip?ip=203.0.113.9", L"/ip?ip=203.0.113.10" };
+    for (int i = 0; i < refreshes; ++i) {
+        const int n = i < change_at ? 0 : 1;
+        iputils::ExternalIpOptions opt = h.Options(json[n]);
+        opt.ip_only_path = ip_only_path ? ip[n] : nullptr;
+        opt.host_v6 = nullptr;
+        opt.strategy = iputils::CacheStrategy::FIXED;
+        service.GetExternalIPv4WithCountry(opt, false);
+        now += opt.min_refresh + std::chrono::seconds(1);
+    }
+    const iputils::TransportStats stats = service.GetTransportStats();
+    service.Shutdown();
+    return stats;
+}
+
+void PayloadTest(Harness& h) {
+    const int refreshes = 20, change_at = 10;
+    const iputils::TransportStats full = RunRefreshes(h, nullptr, refreshes, change_at);
+    const iputils::TransportStats probe = RunRefreshes(h, L"/ip", refreshes, change_at);
+
+    auto report = [&](const char* name, const iputils::TransportStats& t) {
+        std::cout << "payload: " << name << ": " << t.full_requests << " json + " << t.ip_only_requests << " ip-only requests, "
+            << (double)t.bytes_received / refreshes << " bytes/refresh, "
+            << (double)t.parse_us / refreshes << " us parse/refresh" << std::endl;
+    };
+    report("/json every refresh     ", full);
+    report("/ip + /json on change   ", probe);
+    h.Check("payload: /json on every refresh", full.full_requests == refreshes && full.ip_only_requests == 0);
+    h.Check("payload: /json only at start and on change", probe.full_requests == 2
+        && probe.ip_only_requests == refreshes - 1);
+    h.Check("payload: fewer bytes per refresh", probe.bytes_received < full.bytes_received);
+}
+
+void LoadTest(Harness& h, int threads, int requests) {
+    h.server.ResetCounters();
+    std::vector<std::vector<double>> latencies(threads);
+    std::atomic<int> failed{ 0 };
+    std::vector<std::thread> workers;
+    const auto start = std::chrono::steady_clock::now();
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t] {
+            iputils::HttpTransport transport;  // 每个线程一个传输，各自保持一个连接
+            for (int i = 0; i < requests; ++i) {
+                iputils::LookupContext ctx(h.Options(L"/json"));
+                const auto s = std::chrono::steady_clock::now();
+                if (!iputils::RunLookupPipeline(ctx, transport, h.dns)) ++failed;
+                latencies[t].push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - s).count());
+            }
+        });
+    }
+    for (auto& w : workers) w.join();
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::vector<double> all;
+    for (const auto& v : latencies) all.insert(all.end(), v.begin(), v.end());
+    std::sort(all.begin(), all.end());
+    auto pct = [&](double p) { return all.empty() ? 0.0 : all[static_cast<size_t>(p * (all.size() - 1))]; };
+
+    std::cout << "load: " << threads << " threads x " << requests << " requests in " << seconds << " s ("
+        << all.size() / seconds << " req/s), p50 " << pct(0.5) << " us, p99 " << pct(0.99) << " us, max "
+        << (all.empty() ? 0.0 : all.back()) << " us" << std::endl;
+    h.Check("load: no failures", failed == 0);
+    h.Check("load: one connection per client", h.server.Connections() == threads);
+    h.Check("load: server saw every request", h.server.Requests() == threads * requests);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    int threads = 8, requests = 200;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (std::string(argv[i]) == "--threads") threads = std::atoi(argv[i + 1]);
+        else if (std::string(argv[i]) == "--requests") requests = std::atoi(argv[i + 1]);
+    }
+
+    WSADATA wsa;
+    WSAStartup(MAKEWORD(2, 2), &wsa);
+
+    int failures = 0;
+    {
+        Harness h;
+        if (!h.server.Start()) {
+            std::cout << "cannot start stub server" << std::endl;
+            return 1;
+        }
+        std::cout << "stub provider on 127.0.0.1:" << h.server.Port() << std::endl;
+        IntegrationTests(h);
+        ResolveAndConnectTests(h);
+        DnsCacheTests(h);
+        PayloadTest(h);
+        LoadTest(h, threads, requests);
+        h.transport.Reset();
+        failures = h.failures;
+    }
+
+    WSACleanup();
+    std::cout << (failures ? "FAILED: " : "all passed") << (failures ? std::to_string(failures) : "") << std::endl;
+    return failures ? 1 : 0;
+}